@@ -66,6 +66,7 @@ set_default_opt( FALCON_STATIC_FEATHERS  "Perform a static compilation of the ma
 set_default_opt( FALCON_STATIC_MODULES  "Perform a static compilation of the non-feathers canonical modules" OFF )
 set_default_opt( FALCON_WITH_INTERNAL_PCRE "Uses pre-configured PCRE library sources in Feathers" ON )
 set_default_opt( FALCON_WITH_INTERNAL_ZLIB "Uses pre-configured ZLIB library sources in Feathers" OFF )
+set_default_opt( FALCON_NAN_BOXED_ITEMS "Use the compact 8 bytes NaN-boxed item layout in the engine" OFF )
 
 
 Message("Debug options: ")
@@ -78,6 +79,8 @@ else()
    set( FALCON_TRACE_GC_VALUE 0 )
 endif()
 
+set_default_opt( FALCON_PROFILE_LOCKS "Record the contention of the engine locks (see falcon/lockprofile.h)" OFF )
+
 
 #################################################################
 # Setting the default for control variables
@@ -15,9 +15,41 @@
 
 #include <falcon/futex.h>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace falcon {
-std::atomic<unsigned int> RFutex::s_count{0};
-thread_local unsigned int RFutex::s_thread_id{0};
+std::atomic<unsigned int> ThreadOrdinal::s_count{0};
+thread_local unsigned int ThreadOrdinal::s_ordinal{0};
+
+static_assert(sizeof(std::atomic<int>) == sizeof(int), "futex words must be plain integers");
+
+void futexWait(std::atomic<int>& word, int expected) noexcept
+{
+#ifdef __linux__
+	// returns at once if word doesn't hold expected anymore.
+	syscall(SYS_futex, reinterpret_cast<int*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+	if(word.load(std::memory_order_relaxed) == expected) {
+		std::this_thread::yield();
+	}
+#endif
+}
+
+
+void futexWake(std::atomic<int>& word, int count) noexcept
+{
+#ifdef __linux__
+	syscall(SYS_futex, reinterpret_cast<int*>(&word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+	(void) word;
+	(void) count;
+#endif
+}
+
 }
 
 /* end of futex.cpp */
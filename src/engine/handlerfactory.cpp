@@ -14,6 +14,7 @@
 ******************************************************************************/
 
 #include <falcon/engine/handlerfactory.h>
+#include <falcon/engine/item.h>
 
 namespace falcon {
 
@@ -22,7 +23,16 @@ BoolHandler HandlerFactory::boolHandler;
 IntHandler HandlerFactory::intHandler;
 FloatHandler HandlerFactory::floatHandler;
 StringHandler HandlerFactory::stringHandler;
+ShortStringHandler HandlerFactory::shortStringHandler;
+AtomHandler HandlerFactory::atomHandler;
 BigNumHandler HandlerFactory::bigNumHandler;
+FixedIntHandler<128> HandlerFactory::int128Handler;
+FixedIntHandler<256> HandlerFactory::int256Handler;
+TypedArrayHandler<int64> HandlerFactory::intArrayHandler;
+TypedArrayHandler<numeric> HandlerFactory::floatArrayHandler;
+TypedArrayHandler<byte> HandlerFactory::byteArrayHandler;
+DictHandler<PairItem> HandlerFactory::pairDictHandler;
+DictHandler<BoxedItem> HandlerFactory::boxedDictHandler;
 
 }
 
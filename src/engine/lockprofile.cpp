@@ -0,0 +1,214 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: lockprofile.cpp
+
+  Contention profiling policies of the futexes
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/lockprofile.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace falcon {
+
+namespace {
+
+// Never destroyed: locks living in static objects can go after it.
+struct Registry {
+	std::mutex m_mtx;
+	lock_profile* m_head{nullptr};
+};
+
+Registry& registry()
+{
+	static Registry* instance = new Registry;
+	return *instance;
+}
+
+std::string labelsOf(const LockStats& stats)
+{
+	std::ostringstream labels;
+	labels << "lock=\"";
+	if(stats.m_name != nullptr) {
+		labels << stats.m_name;
+	}
+	else {
+		labels << stats.m_lock;
+	}
+	labels << "\",site=\"";
+	if(stats.m_file != nullptr) {
+		labels << stats.m_file << ":" << stats.m_line;
+	}
+	labels << "\"";
+	return labels.str();
+}
+
+void writeCounter(std::ostream& out, const char* metric, uint64_t LockStats::* field,
+		const std::vector<LockStats>& stats, const std::vector<std::string>& labels)
+{
+	out << "# TYPE falcon_lock_" << metric << " counter\n";
+	for(size_t i = 0; i < stats.size(); ++i) {
+		out << "falcon_lock_" << metric << "{" << labels[i] << "} " << stats[i].*field << "\n";
+	}
+}
+
+void writeWaits(std::ostream& out, const std::vector<LockStats>& stats, const std::vector<std::string>& labels)
+{
+	out << "# TYPE falcon_lock_wait_seconds histogram\n";
+	for(size_t i = 0; i < stats.size(); ++i) {
+		const std::string& lbl = labels[i];
+		uint64_t count = 0;
+		for(int bucket = 0; bucket < LockStats::BUCKETS; ++bucket) {
+			count += stats[i].m_waits[bucket];
+			out << "falcon_lock_wait_seconds_bucket{" << lbl << ",le=\"";
+			if(bucket < LockStats::BUCKETS - 1) {
+				out << static_cast<double>(uint64_t(1) << (bucket + 7)) / 1e9;
+			}
+			else {
+				out << "+Inf";
+			}
+			out << "\"} " << count << "\n";
+		}
+		out << "falcon_lock_wait_seconds_sum{" << lbl << "} " << static_cast<double>(stats[i].m_waitNanos) / 1e9 << "\n";
+		out << "falcon_lock_wait_seconds_count{" << lbl << "} " << count << "\n";
+	}
+}
+
+// Locks with the same name and site, as the shards of a ShardedFutex or the
+// same member of many objects, are a single lock in the dump.
+bool sameLock(const LockStats& first, const LockStats& second)
+{
+	return first.m_name != nullptr && second.m_name != nullptr
+			&& std::strcmp(first.m_name, second.m_name) == 0
+			&& first.m_line == second.m_line
+			&& (first.m_file == second.m_file
+				|| (first.m_file != nullptr && second.m_file != nullptr && std::strcmp(first.m_file, second.m_file) == 0));
+}
+
+void addTo(LockStats& total, const LockStats& stats)
+{
+	total.m_acquisitions += stats.m_acquisitions;
+	total.m_contended += stats.m_contended;
+	total.m_spins += stats.m_spins;
+	total.m_sleeps += stats.m_sleeps;
+	total.m_waitNanos += stats.m_waitNanos;
+	for(int bucket = 0; bucket < LockStats::BUCKETS; ++bucket) {
+		total.m_waits[bucket] += stats.m_waits[bucket];
+	}
+}
+
+// Prometheus wants the samples of a family together, after its TYPE line.
+void writeFamilies(std::ostream& out, const std::vector<LockStats>& stats)
+{
+	std::vector<std::string> labels;
+	labels.reserve(stats.size());
+	for(const LockStats& lock: stats) {
+		labels.push_back(labelsOf(lock));
+	}
+
+	writeCounter(out, "acquisitions_total", &LockStats::m_acquisitions, stats, labels);
+	writeCounter(out, "contended_total", &LockStats::m_contended, stats, labels);
+	writeCounter(out, "spins_total", &LockStats::m_spins, stats, labels);
+	writeCounter(out, "sleeps_total", &LockStats::m_sleeps, stats, labels);
+	writeWaits(out, stats, labels);
+}
+
+}
+
+lock_profile::lock_profile()
+{
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> guard(reg.m_mtx);
+	m_next = reg.m_head;
+	if(m_next != nullptr) {
+		m_next->m_prev = this;
+	}
+	reg.m_head = this;
+}
+
+
+lock_profile::~lock_profile()
+{
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> guard(reg.m_mtx);
+	if(m_prev != nullptr) {
+		m_prev->m_next = m_next;
+	}
+	else {
+		reg.m_head = m_next;
+	}
+	if(m_next != nullptr) {
+		m_next->m_prev = m_prev;
+	}
+}
+
+
+void lock_profile::fill(LockStats& stats) const noexcept
+{
+	stats.m_name = m_name.load(std::memory_order_relaxed);
+	stats.m_file = m_file.load(std::memory_order_relaxed);
+	stats.m_line = m_line.load(std::memory_order_relaxed);
+	stats.m_lock = this;
+	stats.m_acquisitions = m_acquisitions.load(std::memory_order_relaxed);
+	stats.m_contended = m_contended.load(std::memory_order_relaxed);
+	stats.m_spins = m_spins.load(std::memory_order_relaxed);
+	stats.m_sleeps = m_sleeps.load(std::memory_order_relaxed);
+	stats.m_waitNanos = m_waitNanos.load(std::memory_order_relaxed);
+	for(int bucket = 0; bucket < LockStats::BUCKETS; ++bucket) {
+		stats.m_waits[bucket] = m_waits[bucket].load(std::memory_order_relaxed);
+	}
+}
+
+
+unsigned int LockStats::bucketOf(uint64_t nanos) noexcept
+{
+	unsigned int bucket = 0;
+	for(nanos >>= 7; nanos != 0 && bucket < BUCKETS - 1; nanos >>= 1) {
+		++bucket;
+	}
+	return bucket;
+}
+
+
+void LockStats::write(std::ostream& out) const
+{
+	writeFamilies(out, std::vector<LockStats>(1, *this));
+}
+
+
+void LockStats::writeAll(std::ostream& out)
+{
+	std::vector<LockStats> stats;
+	{
+		Registry& reg = registry();
+		std::lock_guard<std::mutex> guard(reg.m_mtx);
+		for(const lock_profile* profile = reg.m_head; profile != nullptr; profile = profile->m_next) {
+			LockStats lock;
+			profile->fill(lock);
+			auto same = std::find_if(stats.begin(), stats.end(),
+					[&lock](const LockStats& other) { return sameLock(other, lock); });
+			if(same != stats.end()) {
+				addTo(*same, lock);
+			}
+			else {
+				stats.push_back(lock);
+			}
+		}
+	}
+	writeFamilies(out, stats);
+}
+
+}
+
+/* end of lockprofile.cpp */
@@ -15,16 +15,22 @@
 
 #include <falcon/logsystem.h>
 #include <algorithm>
+#include <thread>
 
 namespace falcon {
 
 LogSystem::LogSystem(bool startNow):
 		m_logThread(0),
 		m_level(LEVEL::TRACE),
-		m_unpooled(0),
-		m_destroyed(0),
+		m_unpooled("falcon_log_messages_created_total", "Log messages allocated outside the pool"),
+		m_destroyed("falcon_log_messages_discarded_total", "Log messages deleted, as the pool was full"),
 		m_maxMsgQueueSize(0),
-		m_msgReceived(0)
+		m_msgReceived("falcon_log_messages_received_total", "Log messages sent to the listeners"),
+		m_queueFull("falcon_log_queue_full_total", "Times a log message found the queue full"),
+		m_dropped("falcon_log_messages_dropped_total", "Log messages dropped, as the queue was full and not emptied"),
+		m_messages(MESSAGE_QUEUE_SIZE),
+		m_isTerminated(false),
+		m_isRunning(false)
 {
 	// prepare the pool
 	for (int i = 0; i < MESSAGE_POOL_THRESHOLD; ++i) {
@@ -42,7 +48,8 @@ LogSystem::~LogSystem()
 	stop();
 
 	// delete the pending messages
-	for(auto* message: m_messages){
+	Message* message;
+	while(m_messages.pop(message)) {
 		delete message;
 	}
 
@@ -56,6 +63,8 @@ LogSystem::~LogSystem()
 void LogSystem::start() {
 	std::lock_guard<std::mutex> guard(m_mtxThread);
 	if(m_logThread == 0) {
+		m_isTerminated = false;
+		m_isRunning = true;
 		m_logThread = new std::thread(&LogSystem::loggingThread, this);
 	}
 }
@@ -63,10 +72,9 @@ void LogSystem::start() {
 
 void LogSystem::stop() noexcept {
 	// send a killer message
-	m_mtxMessage.lock();
+	m_isRunning = false;
 	m_isTerminated = true;
-	m_mtxMessage.unlock();
-	m_cvLogs.notify_all();
+	m_doorbell.ring();
 
 	// now
 	std::thread* the_thread = 0;
@@ -85,7 +93,7 @@ void LogSystem::stop() noexcept {
 void LogSystem::log( const std::string& file, int line, LEVEL level, const std::string& cat, const std::string& message )
 {
 	// Ignore anything above our current log level.
-	if (level > m_level) {
+	if (level > atomicFetch(m_level, std::memory_order_relaxed)) {
 		return;
 	}
 
@@ -96,12 +104,27 @@ void LogSystem::log( const std::string& file, int line, LEVEL level, const std::
 
 void LogSystem::log( LogSystem::Message* msg ) noexcept
 {
-	std::lock_guard<std::mutex> guard(m_mtxMessage);
-	m_messages.push_back(msg);
-	if(m_messages.size() > m_maxMsgQueueSize) {
-		m_maxMsgQueueSize = m_messages.size();
+	size_t depth = m_messages.push(msg);
+	if(depth == 0) {
+		m_queueFull.inc();
+		while((depth = m_messages.push(msg)) == 0) {
+			if(!m_isRunning) {
+				// Nobody is emptying the queue: waiting would be forever.
+				m_dropped.inc();
+				disposeMsgs(&msg, 1);
+				return;
+			}
+			// Full: the log thread is surely awake, let it run.
+			m_doorbell.ring();
+			std::this_thread::yield();
+		}
+	}
+
+	if(depth > m_maxMsgQueueSize.load(std::memory_order_relaxed)) {
+		// Racing producers might lose a peak, but this is just a diagnostic.
+		m_maxMsgQueueSize.store(depth, std::memory_order_relaxed);
 	}
-	m_cvLogs.notify_all();
+	m_doorbell.ring();
 }
 
 /**
@@ -146,33 +169,39 @@ void LogSystem::addListener(std::shared_ptr<LogSystem::Listener> l)
 
 void LogSystem::loggingThread() noexcept
 {
+	Message* batch[MESSAGE_BATCH];
 	while(true) {
-		std::unique_lock<std::mutex> msgl(m_mtxMessage);
-		m_cvLogs.wait(msgl, [=](){
-			return (!m_messages.empty()) || m_isTerminated;
-			}
-		);
+		if(m_messages.empty() && !m_isTerminated) {
+			m_doorbell.wait([this](){
+				return (!m_messages.empty()) || m_isTerminated;
+				}
+			);
+		}
 
 		// check for termination
 		if (m_isTerminated) {
 			return;
 		}
 
-		Message* msg = m_messages.front();
-		m_messages.pop_front();
-		msgl.unlock();
+		size_t count = m_messages.pop(batch, MESSAGE_BATCH);
+		if(count == 0) {
+			continue;
+		}
 
-		// Do we need to add new listeners?
+		// Do we need to add new listeners...
 		processNewListeners();
 
-		// Now send the message
-		sendMessageToListeners(msg);
-
-		// ... or remove the dead ones?
+		// ... or remove the dead ones? Do it before sending, so that
+		// messages logged after a detach() don't reach the listener.
 		cleanupTerminatedListeners();
 
+		// Now send the messages
+		for(size_t i = 0; i < count; ++i) {
+			sendMessageToListeners(batch[i]);
+		}
+
 		// give back to the pool
-		disposeMsg(msg);
+		disposeMsgs(batch, count);
 	}
 }
 
@@ -187,7 +216,7 @@ void LogSystem::processNewListeners() noexcept
 
 void LogSystem::sendMessageToListeners(Message* msg) noexcept
 {
-	m_msgReceived++;
+	m_msgReceived.inc();
 	for(auto listener: m_activeListeners) {
 		if(listener->isEnabled()
 				&& listener->level() >= msg->m_level
@@ -201,7 +230,7 @@ void LogSystem::sendMessageToListeners(Message* msg) noexcept
 bool LogSystem::Listener::checkCategory(const std::string& cat) const noexcept
 {
 	  if(cat == "") return true;
-	  std::lock_guard<std::mutex> guard(m_mtxCategory);
+	  std::shared_lock<RWFutex> guard(m_mtxCategory);
 	  if(m_category == "") {
 		  return true;
 	  }
@@ -221,22 +250,24 @@ LogSystem::Message* LogSystem::allocateMsg()
 			return msg;
 		}
 	}
-	m_unpooled++;
+	m_unpooled.inc();
 	return new Message;
 }
 
 
-void LogSystem::disposeMsg(Message* msg) noexcept
+void LogSystem::disposeMsgs(Message** msgs, size_t count) noexcept
 {
+	size_t pooled = 0;
 	{
 		std::lock_guard<std::mutex> guard(m_mtxPool);
-		if(m_pool.size() < MESSAGE_POOL_THRESHOLD) {
-			m_pool.push_back(msg);
-			return;
+		while(pooled < count && m_pool.size() < MESSAGE_POOL_THRESHOLD) {
+			m_pool.push_back(msgs[pooled++]);
 		}
 	}
-	m_destroyed++;
-	delete msg;
+	for(size_t i = pooled; i < count; ++i) {
+		m_destroyed.inc();
+		delete msgs[i];
+	}
 }
 
 
@@ -252,17 +283,15 @@ void LogSystem::cleanupTerminatedListeners()
 
 void LogSystem::getDiags(LogSystem::Diags& diags) noexcept
 {
-	diags.m_msgsCreated = m_unpooled;
-	diags.m_msgsDiscarded = m_destroyed;
+	diags.m_msgsCreated = m_unpooled.value();
+	diags.m_msgsDiscarded = m_destroyed.value();
+	diags.m_msgsDropped = m_dropped.value();
 	diags.m_activeListeners = m_activeListeners.size();
 	diags.m_enabledListeners = std::count_if(m_activeListeners.begin(), m_activeListeners.end(),
 				[](const auto& l){return l->isEnabled();});
-	diags.m_msgReceived = m_msgReceived;
+	diags.m_msgReceived = m_msgReceived.value();
 
-	{
-		std::lock_guard<std::mutex> guard(m_mtxMessage);
-		diags.m_maxMsgQueueSize = m_maxMsgQueueSize;
-	}
+	diags.m_maxMsgQueueSize = m_maxMsgQueueSize.load(std::memory_order_relaxed);
 	{
 		std::lock_guard<std::mutex> guard(m_mtxPool);
 		diags.m_poolSize = m_pool.size();
@@ -0,0 +1,207 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: mappedallocator.cpp
+
+  Page allocator backed by a reserved virtual memory range
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/engine/mappedallocator.h>
+#include <cstdint>
+#include <new>
+
+#ifdef FALCON_SYSTEM_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace falcon {
+
+#ifdef FALCON_SYSTEM_UNIX
+
+namespace {
+
+void* mapAccessible(size_t size)
+{
+	void* block = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(block == MAP_FAILED) {
+		throw std::bad_alloc();
+	}
+	return block;
+}
+
+}
+
+MappedArena::MappedArena(size_t reserve, bool hugePages):
+	m_hugePages(hugePages)
+{
+	size_t align = hugePages ? HUGE_PAGE_SIZE : pageSize();
+	m_reserve = (reserve + align - 1) / align * align;
+
+	// Address space only: no access, and nothing accounted until committed.
+	size_t mapped = hugePages ? m_reserve + HUGE_PAGE_SIZE : m_reserve;
+	void* range = mmap(nullptr, mapped, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(range == MAP_FAILED) {
+		throw std::bad_alloc();
+	}
+	m_base = static_cast<char*>(range);
+
+	if(hugePages) {
+		// trim the range to the huge page boundaries.
+		char* aligned = reinterpret_cast<char*>(
+				(reinterpret_cast<uintptr_t>(m_base) + HUGE_PAGE_SIZE - 1) & ~uintptr_t(HUGE_PAGE_SIZE - 1));
+		if(aligned > m_base) {
+			munmap(m_base, aligned - m_base);
+		}
+		char* end = aligned + m_reserve;
+		char* mappedEnd = m_base + mapped;
+		if(mappedEnd > end) {
+			munmap(end, mappedEnd - end);
+		}
+		m_base = aligned;
+#ifdef MADV_HUGEPAGE
+		madvise(m_base, m_reserve, MADV_HUGEPAGE);
+#endif
+	}
+}
+
+
+MappedArena::~MappedArena()
+{
+	munmap(m_base, m_reserve);
+}
+
+
+void* MappedArena::allocate(size_t size)
+{
+	size = roundSize(size);
+	std::lock_guard<std::mutex> guard(m_mtx);
+
+	char* block = nullptr;
+	for(auto iter = m_free.begin(); iter != m_free.end(); ++iter) {
+		if(iter->second == size) {
+			block = iter->first;
+			m_free.erase(iter);
+			break;
+		}
+	}
+
+	if(block == nullptr) {
+		if(m_reserve - m_top < size) {
+			void* outside = mapAccessible(size);
+			m_allocated += size;
+			return outside;
+		}
+		block = m_base + m_top;
+		m_top += size;
+	}
+
+	// Pages are backed by physical memory when first touched.
+	if(mprotect(block, size, PROT_READ | PROT_WRITE) != 0) {
+		m_free.emplace_back(block, size);
+		throw std::bad_alloc();
+	}
+	m_allocated += size;
+	return block;
+}
+
+
+void MappedArena::deallocate(void* data, size_t size) noexcept
+{
+	char* block = static_cast<char*>(data);
+	size = roundSize(size);
+	std::lock_guard<std::mutex> guard(m_mtx);
+	m_allocated -= size;
+
+	if(!inRange(block)) {
+		munmap(block, size);
+		return;
+	}
+
+	madvise(block, size, MADV_DONTNEED);
+	mprotect(block, size, PROT_NONE);
+	m_free.emplace_back(block, size);
+
+	// Give the blocks on top of the used part back to the unused range.
+	bool lowered = true;
+	while(lowered) {
+		lowered = false;
+		for(auto iter = m_free.begin(); iter != m_free.end(); ++iter) {
+			if(iter->first + iter->second == m_base + m_top) {
+				m_top -= iter->second;
+				m_free.erase(iter);
+				lowered = true;
+				break;
+			}
+		}
+	}
+}
+
+
+size_t MappedArena::pageSize() noexcept
+{
+	static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	return size;
+}
+
+#else
+
+MappedArena::MappedArena(size_t reserve, bool hugePages):
+	m_reserve(reserve),
+	m_hugePages(hugePages)
+{}
+
+
+MappedArena::~MappedArena()
+{}
+
+
+void* MappedArena::allocate(size_t size)
+{
+	size = roundSize(size);
+	void* block = ::operator new(size);
+	std::lock_guard<std::mutex> guard(m_mtx);
+	m_allocated += size;
+	return block;
+}
+
+
+void MappedArena::deallocate(void* block, size_t size) noexcept
+{
+	::operator delete(block);
+	std::lock_guard<std::mutex> guard(m_mtx);
+	m_allocated -= roundSize(size);
+}
+
+
+size_t MappedArena::pageSize() noexcept
+{
+	return 4096;
+}
+
+#endif
+
+
+size_t MappedArena::allocatedBytes() const noexcept
+{
+	std::lock_guard<std::mutex> guard(m_mtx);
+	return m_allocated;
+}
+
+
+size_t MappedArena::roundSize(size_t size) const noexcept
+{
+	size_t page = pageSize();
+	return (size + page - 1) / page * page;
+}
+
+}
+
+/* end of mappedallocator.cpp */
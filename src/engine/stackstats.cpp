@@ -0,0 +1,112 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: stackstats.cpp
+
+  Instrumentation policies of PagedStack
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/engine/stackstats.h>
+#include <vector>
+
+namespace falcon {
+
+namespace {
+
+// Prometheus wants the samples of a family together, after its TYPE line.
+template<typename _T>
+void writeFamily(std::ostream& out, const char* metric, const char* type, _T StackStats::* field,
+		const std::vector<std::pair<std::string, StackStats>>& stacks)
+{
+	out << "# TYPE falcon_stack_" << metric << " " << type << "\n";
+	for(const auto& stack: stacks) {
+		out << "falcon_stack_" << metric << "{stack=\"" << stack.first << "\"} " << stack.second.*field << "\n";
+	}
+}
+
+// Never destroyed, as the stacks using them.
+const stack_statistics::Counters* createCounters()
+{
+	stack_statistics::Counters* counters = new stack_statistics::Counters;
+	for(int op = 0; op < StackStats::OP_COUNT; ++op) {
+		counters->m_ops[op] = new Counter("falcon_stacks_ops_total", "Operations on the stacks",
+				std::string("op=\"") + StackStats::opName(static_cast<StackStats::Op>(op)) + "\"");
+	}
+	counters->m_grows = new Counter("falcon_stacks_grows_total", "Times the stacks grew their directory");
+	counters->m_growNanos = new Counter("falcon_stacks_grow_nanoseconds_total", "Time spent growing the stacks");
+	counters->m_shrinks = new Counter("falcon_stacks_shrinks_total", "Times the stacks were shrunk");
+	counters->m_shrunkPages = new Counter("falcon_stacks_shrunk_pages_total", "Pages given back by the stacks");
+	counters->m_allocatedPages = new Counter("falcon_stacks_allocated_pages_total", "Pages obtained from the allocators");
+	counters->m_reusedPages = new Counter("falcon_stacks_reused_pages_total", "Pages taken back from the quarantines");
+	counters->m_copiedPages = new Counter("falcon_stacks_copied_pages_total", "Pages shared by forked stacks and copied");
+	return counters;
+}
+
+}
+
+stack_statistics::stack_statistics()
+{
+	static const Counters* counters = createCounters();
+	m_counters = counters;
+}
+
+
+const char* StackStats::opName(Op op) noexcept
+{
+	switch(op) {
+	case PUSH: return "push";
+	case POP: return "pop";
+	case DISCARD: return "discard";
+	case PEEK: return "peek";
+	case SET_TOP: return "set_top";
+	case PUSH_RANGE: return "push_range";
+	case POP_RANGE: return "pop_range";
+	case FORK: return "fork";
+	case SHRINK: return "shrink";
+	case RECLAIM: return "reclaim";
+	default: return "unknown";
+	}
+}
+
+
+void StackStats::write(std::ostream& out, const std::string& name) const
+{
+	writeAll(out, {{name, *this}});
+}
+
+
+void StackStats::writeAll(std::ostream& out, const std::vector<std::pair<std::string, StackStats>>& stacks)
+{
+	writeFamily(out, "page_size", "gauge", &StackStats::m_pageSize, stacks);
+	writeFamily(out, "prealloc_pages", "gauge", &StackStats::m_prealloc, stacks);
+	writeFamily(out, "pages", "gauge", &StackStats::m_pages, stacks);
+	writeFamily(out, "depth", "gauge", &StackStats::m_depth, stacks);
+	writeFamily(out, "high_water", "gauge", &StackStats::m_highWater, stacks);
+	writeFamily(out, "peak_pages", "gauge", &StackStats::m_peakPages, stacks);
+	writeFamily(out, "grows_total", "counter", &StackStats::m_grows, stacks);
+	writeFamily(out, "grow_nanoseconds_total", "counter", &StackStats::m_growNanos, stacks);
+	writeFamily(out, "shrinks_total", "counter", &StackStats::m_shrinks, stacks);
+	writeFamily(out, "shrunk_pages_total", "counter", &StackStats::m_shrunkPages, stacks);
+	writeFamily(out, "allocated_pages_total", "counter", &StackStats::m_allocatedPages, stacks);
+	writeFamily(out, "reused_pages_total", "counter", &StackStats::m_reusedPages, stacks);
+	writeFamily(out, "copied_pages_total", "counter", &StackStats::m_copiedPages, stacks);
+
+	out << "# TYPE falcon_stack_ops_total counter\n";
+	for(const auto& stack: stacks) {
+		for(int op = 0; op < OP_COUNT; ++op) {
+			out << "falcon_stack_ops_total{stack=\"" << stack.first << "\",op=\"" << opName(static_cast<Op>(op)) << "\"} "
+				<< stack.second.m_ops[op] << "\n";
+		}
+	}
+}
+
+}
+
+/* end of stackstats.cpp */
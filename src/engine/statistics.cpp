@@ -0,0 +1,239 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: statistics.cpp
+
+  Per-thread counters and gauges of the engine
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/statistics.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace falcon {
+
+class ThreadCountersBlock;
+
+thread_local std::atomic<uint64>* ThreadCounters::s_slots{nullptr};
+
+namespace {
+
+// Never destroyed: counters living in static objects can go after it.
+struct Registry {
+	std::mutex m_mtx;
+	Counter* m_counters[ThreadCounters::MAX_COUNTERS]{};
+	std::vector<unsigned int> m_freeIndexes;
+	unsigned int m_nextIndex{0};
+	std::vector<ThreadCountersBlock*> m_blocks;
+	std::vector<Gauge*> m_gauges;
+};
+
+Registry& registry()
+{
+	static Registry* instance = new Registry;
+	return *instance;
+}
+
+// Where the threads add after their block is gone, while their last
+// thread-local objects are destroyed; never read.
+std::atomic<uint64> s_sink[ThreadCounters::MAX_COUNTERS];
+
+}
+
+
+class ThreadCountersBlock {
+public:
+	std::atomic<uint64> m_slots[ThreadCounters::MAX_COUNTERS]{};
+
+	ThreadCountersBlock()
+	{
+		Registry& reg = registry();
+		std::lock_guard<std::mutex> guard(reg.m_mtx);
+		reg.m_blocks.push_back(this);
+	}
+
+	~ThreadCountersBlock()
+	{
+		Registry& reg = registry();
+		std::lock_guard<std::mutex> guard(reg.m_mtx);
+		for(unsigned int index = 0; index < reg.m_nextIndex; ++index) {
+			if(reg.m_counters[index] != nullptr) {
+				reg.m_counters[index]->m_retired += m_slots[index].load(std::memory_order_relaxed);
+			}
+		}
+		reg.m_blocks.erase(std::find(reg.m_blocks.begin(), reg.m_blocks.end(), this));
+		ThreadCounters::s_slots = s_sink;
+	}
+};
+
+
+std::atomic<uint64>* ThreadCounters::attach() noexcept
+{
+	thread_local ThreadCountersBlock block;
+	return block.m_slots;
+}
+
+
+Counter::Counter(const std::string& name, const std::string& help, const std::string& labels):
+		m_name(name),
+		m_help(help),
+		m_labels(labels)
+{
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> guard(reg.m_mtx);
+	if(!reg.m_freeIndexes.empty()) {
+		m_index = reg.m_freeIndexes.back();
+		reg.m_freeIndexes.pop_back();
+	}
+	else if(reg.m_nextIndex < ThreadCounters::MAX_COUNTERS) {
+		m_index = reg.m_nextIndex++;
+	}
+	else {
+		throw std::length_error("Too many statistics counters");
+	}
+
+	// The slots might hold what a previous counter left.
+	for(ThreadCountersBlock* block: reg.m_blocks) {
+		block->m_slots[m_index].store(0, std::memory_order_relaxed);
+	}
+	reg.m_counters[m_index] = this;
+}
+
+
+Counter::~Counter()
+{
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> guard(reg.m_mtx);
+	reg.m_counters[m_index] = nullptr;
+	reg.m_freeIndexes.push_back(m_index);
+}
+
+
+uint64 Counter::total() const noexcept
+{
+	uint64 sum = m_retired;
+	for(const ThreadCountersBlock* block: registry().m_blocks) {
+		sum += block->m_slots[m_index].load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+
+
+uint64 Counter::value() const noexcept
+{
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> guard(reg.m_mtx);
+	return total();
+}
+
+
+Gauge::Gauge(const std::string& name, const std::string& help, const std::string& labels):
+		Gauge(name, help, probe_type(), labels)
+{
+}
+
+
+Gauge::Gauge(const std::string& name, const std::string& help, probe_type probe, const std::string& labels):
+		m_name(name),
+		m_help(help),
+		m_labels(labels),
+		m_probe(std::move(probe))
+{
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> guard(reg.m_mtx);
+	reg.m_gauges.push_back(this);
+}
+
+
+Gauge::~Gauge()
+{
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> guard(reg.m_mtx);
+	reg.m_gauges.erase(std::find(reg.m_gauges.begin(), reg.m_gauges.end(), this));
+}
+
+
+int64 Gauge::value() const
+{
+	if(m_probe) {
+		return m_probe();
+	}
+	return atomicFetch(m_value, std::memory_order_relaxed);
+}
+
+
+void Statistics::write(std::ostream& out)
+{
+	struct Metric {
+		const char* m_type;
+		std::string m_help;
+		std::map<std::string, int64> m_samples;
+	};
+	std::map<std::string, Metric> metrics;
+
+	{
+		Registry& reg = registry();
+		std::lock_guard<std::mutex> guard(reg.m_mtx);
+		for(unsigned int index = 0; index < reg.m_nextIndex; ++index) {
+			const Counter* counter = reg.m_counters[index];
+			if(counter != nullptr) {
+				Metric& metric = metrics.emplace(counter->name(), Metric{"counter", counter->help(), {}}).first->second;
+				metric.m_samples[counter->labels()] += static_cast<int64>(counter->total());
+			}
+		}
+		for(const Gauge* gauge: reg.m_gauges) {
+			Metric& metric = metrics.emplace(gauge->name(), Metric{"gauge", gauge->help(), {}}).first->second;
+			metric.m_samples[gauge->labels()] += gauge->value();
+		}
+	}
+
+	for(const auto& metric: metrics) {
+		const std::string& name = metric.first;
+		out << "# HELP " << name << " " << metric.second.m_help << "\n"
+			<< "# TYPE " << name << " " << metric.second.m_type << "\n";
+		for(const auto& sample: metric.second.m_samples) {
+			out << name;
+			if(!sample.first.empty()) {
+				out << "{" << sample.first << "}";
+			}
+			out << " " << sample.second << "\n";
+		}
+	}
+}
+
+
+bool Statistics::find(const std::string& name, int64& value, const std::string& labels)
+{
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> guard(reg.m_mtx);
+	bool found = false;
+	value = 0;
+	for(unsigned int index = 0; index < reg.m_nextIndex; ++index) {
+		const Counter* counter = reg.m_counters[index];
+		if(counter != nullptr && counter->name() == name && counter->labels() == labels) {
+			value += static_cast<int64>(counter->total());
+			found = true;
+		}
+	}
+	for(const Gauge* gauge: reg.m_gauges) {
+		if(gauge->name() == name && gauge->labels() == labels) {
+			value += gauge->value();
+			found = true;
+		}
+	}
+	return found;
+}
+
+}
+
+/* end of statistics.cpp */
@@ -0,0 +1,104 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: stringpool.cpp
+
+  Global pool of interned immutable strings
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/engine/stringpool.h>
+#include <cstring>
+
+namespace falcon {
+
+StringPool::~StringPool()
+{
+	for(auto& shard: m_shards) {
+		for(auto& entry: shard.m_atoms) {
+			delete entry.second;
+		}
+	}
+}
+
+
+// Never destroyed: atoms held by static items, or by threads still
+// running at exit, can be released after it.
+StringPool& StringPool::global()
+{
+	static StringPool* pool = new StringPool;
+	return *pool;
+}
+
+
+Atom* StringPool::intern(const char* str, size_t len)
+{
+	size_t h = hash(str, len);
+	Shard& sh = shard(h);
+
+	std::lock_guard<std::mutex> guard(sh.m_mtx);
+	auto range = sh.m_atoms.equal_range(h);
+	for(auto iter = range.first; iter != range.second; ++iter) {
+		Atom* atom = iter->second;
+		if(atom->m_value.size() == len && std::memcmp(atom->m_value.data(), str, len) == 0) {
+			// The last reference is dropped under this lock, so the atom is alive.
+			atom->incref();
+			return atom;
+		}
+	}
+
+	Atom* atom = new Atom(str, len, h);
+	sh.m_atoms.emplace(h, atom);
+	return atom;
+}
+
+
+void StringPool::release(Atom* atom) noexcept
+{
+	// Fast path: we're not the last owner, and no one can make us the last
+	// one without holding a reference on its own.
+	uint32 count = atom->m_refCount.load(std::memory_order_relaxed);
+	while(count > 1) {
+		if(atom->m_refCount.compare_exchange_weak(count, count - 1,
+				std::memory_order_release, std::memory_order_relaxed)) {
+			return;
+		}
+	}
+
+	// Slow path: intern() might resurrect the atom, so decide under the lock.
+	Shard& sh = shard(atom->m_hash);
+	std::lock_guard<std::mutex> guard(sh.m_mtx);
+	if(atom->m_refCount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+		return;
+	}
+
+	auto range = sh.m_atoms.equal_range(atom->m_hash);
+	for(auto iter = range.first; iter != range.second; ++iter) {
+		if(iter->second == atom) {
+			sh.m_atoms.erase(iter);
+			break;
+		}
+	}
+	delete atom;
+}
+
+
+size_t StringPool::size() const noexcept
+{
+	size_t count = 0;
+	for(auto& shard: m_shards) {
+		std::lock_guard<std::mutex> guard(shard.m_mtx);
+		count += shard.m_atoms.size();
+	}
+	return count;
+}
+
+}
+
+/* end of stringpool.cpp */
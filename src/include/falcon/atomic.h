@@ -17,13 +17,137 @@
 #define _FALCON_ATOMIC_H_
 
 #include <falcon/setup.h>
+#include <atomic>
+#include <cstddef>
 
-#if defined(FALCON_SYSTEM_WIN) && !defined(__MINGW32__)
-#include <falcon/atomic_vc.h>
-#else
-// TODO: atomic on other platforms
-#include <falcon/atomic_gcc.h>
-#endif
+namespace falcon {
+
+/** Size of the cache lines, to keep data written by different threads apart. */
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+/**  An alias to the atomic integer type.
+ */
+typedef std::atomic<int32> atomic_int;
+typedef int32 atomic_int_base;
+
+/** Atomic 64 bit counters. */
+typedef std::atomic<int64> atomic_int64;
+typedef std::atomic<uint64> atomic_uint64;
+
+/*
+ * The operations take the memory order as their last parameter. The
+ * read-modify-write ones default to a full barrier, as they always did;
+ * atomicFetch() defaults to an acquire load, and atomicSet() to a release
+ * store. Counters read only for statistics can use memory_order_relaxed
+ * throughout.
+ */
+
+/** Performs an atomic thread safe increment, returning the new value. */
+template<typename _T>
+inline _T atomicInc( std::atomic<_T>& atomic, std::memory_order order = std::memory_order_seq_cst ) noexcept
+{
+   return atomic.fetch_add( 1, order ) + 1;
+}
+
+/** Performs an atomic thread safe decrement, returning the new value. */
+template<typename _T>
+inline _T atomicDec( std::atomic<_T>& atomic, std::memory_order order = std::memory_order_seq_cst ) noexcept
+{
+   return atomic.fetch_sub( 1, order ) - 1;
+}
+
+/** Performs an atomic thread safe addition, returning the new value. */
+template<typename _T>
+inline _T atomicAdd( std::atomic<_T>& atomic, typename std::atomic<_T>::value_type value,
+         std::memory_order order = std::memory_order_seq_cst ) noexcept
+{
+   return atomic.fetch_add( value, order ) + value;
+}
+
+/**
+ * Adds to a counter written by one thread at a time.
+ *
+ * A plain load and store, without a locked instruction: other threads can
+ * read the counter at any time, but increments from two threads at once
+ * would be lost.
+ */
+template<typename _T>
+inline void atomicAddOwned( std::atomic<_T>& atomic, typename std::atomic<_T>::value_type value ) noexcept
+{
+   atomic.store( atomic.load(std::memory_order_relaxed) + value, std::memory_order_relaxed );
+}
+
+/** Perform a threadsafe fetch */
+template<typename _T>
+inline _T atomicFetch( const std::atomic<_T>& atomic, std::memory_order order = std::memory_order_acquire ) noexcept
+{
+   return atomic.load( order );
+}
+
+/** Perform a threadsafe set.*/
+template<typename _T>
+inline void atomicSet( std::atomic<_T>& atomic, typename std::atomic<_T>::value_type value,
+         std::memory_order order = std::memory_order_release ) noexcept
+{
+   atomic.store( value, order );
+}
+
+/** Sets the given value in atomic, and returns the previous value. */
+template<typename _T>
+inline _T atomicExchange( std::atomic<_T>& atomic, typename std::atomic<_T>::value_type value,
+         std::memory_order order = std::memory_order_seq_cst ) noexcept
+{
+   return atomic.exchange( value, order );
+}
+
+/** Sets newVal in target if it holds compareTo; the failed comparison is ordered as a load. */
+template<typename _T>
+inline bool atomicCAS( std::atomic<_T>& target, typename std::atomic<_T>::value_type compareTo,
+         typename std::atomic<_T>::value_type newVal, std::memory_order order = std::memory_order_seq_cst ) noexcept
+{
+   return target.compare_exchange_strong( compareTo, newVal, order );
+}
+
+template<typename _T>
+inline _T atomicXor( std::atomic<_T>& target, typename std::atomic<_T>::value_type value,
+         std::memory_order order = std::memory_order_seq_cst ) noexcept
+{
+   return target.fetch_xor( value, order );
+}
+
+template<typename _T>
+inline _T atomicAnd( std::atomic<_T>& target, typename std::atomic<_T>::value_type value,
+         std::memory_order order = std::memory_order_seq_cst ) noexcept
+{
+   return target.fetch_and( value, order );
+}
+
+template<typename _T>
+inline _T atomicOr( std::atomic<_T>& target, typename std::atomic<_T>::value_type value,
+         std::memory_order order = std::memory_order_seq_cst ) noexcept
+{
+   return target.fetch_or( value, order );
+}
+
+
+/**
+ * Atomic value taking a whole cache line.
+ *
+ * Counters updated by different threads, kept in arrays or next to each
+ * other, would otherwise share a cache line: every write by one thread
+ * takes the line away from all the others (false sharing). It's a
+ * std::atomic, and works with all the functions above.
+ */
+template<typename _T>
+class alignas(CACHE_LINE_SIZE) PaddedAtomic: public std::atomic<_T> {
+public:
+   constexpr PaddedAtomic( _T value = _T() ) noexcept: std::atomic<_T>( value ) {}
+   PaddedAtomic( const PaddedAtomic& ) = delete;
+
+   using std::atomic<_T>::operator=;
+};
+
+}
 
 #endif /* _FALCON_ATOMIC_H_ */
 
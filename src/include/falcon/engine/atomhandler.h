@@ -0,0 +1,71 @@
+/*****************************************************************************
+  FALCON - The Falcon Programming Language
+  FILE: atomhandler.h
+
+  Handler for interned string items.
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin : 
+  Touch : 
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+#ifndef _FALCON_ATOMHANDLER_H_
+#define _FALCON_ATOMHANDLER_H_
+
+#include "falcon/engine/handler.h"
+#include "falcon/engine/stringpool.h"
+
+namespace falcon {
+
+/**
+ * Handler for immutable strings shared through the global StringPool.
+ *
+ * The item data holds a reference to an Atom; equal strings share the same
+ * atom, and their hash is precomputed.
+ */
+struct AtomHandler final: public Handler {
+    virtual ~AtomHandler() {}
+
+    ItemData allocate() const override {
+        ItemData data(0LL);
+        data.ptrValue = StringPool::global().intern("", 0);
+        return data;
+    }
+    ItemData copy(ItemData data) const noexcept override { atom(data)->incref(); return data; }
+    void destroy(ItemData data) const noexcept override { StringPool::global().release(atom(data)); }
+
+    bool isFlat() const noexcept override { return false; }
+    bool isCopyFlat() const noexcept override { return true; }
+
+    static Atom* atom(ItemData data) noexcept { return reinterpret_cast<Atom *>(data.ptrValue); }
+
+    String typeName() const noexcept override {return "String";}
+    String toString(ItemData data) const noexcept override { return atom(data)->value(); }
+    void toString(ItemData data, String& out) const noexcept override { out += atom(data)->value(); }
+
+    bool toBool(ItemData data) const noexcept override { return !atom(data)->value().empty(); }
+    int64 toInt(ItemData data) const noexcept override { return std::stoll(atom(data)->value()); }
+
+    bool stringView(const ItemData& data, std::string_view& view) const noexcept override {
+        view = atom(data)->value();
+        return true;
+    }
+    // The hash is precomputed, and equal atoms are the same atom.
+    size_t hash(ItemData data) const noexcept override { return atom(data)->hash(); }
+    bool equals(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+        if (other == this) {
+            return data.ptrValue == otherData.ptrValue;
+        }
+        return equalsString(atom(data)->value(), other, otherData);
+    }
+    int compare(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+        return compareString(atom(data)->value(), other, otherData);
+    }
+};
+
+}
+
+#endif
@@ -16,26 +16,32 @@
 #define _FALCON_BIGNUMHANDLER_H_
 
 #include <boost/multiprecision/cpp_dec_float.hpp>
-#include <sstream>
 #include "falcon/engine/deepflatcopyhandler.h"
+#include "falcon/engine/slaballocator.h"
 
 
 namespace falcon {
 
 using BigNum = boost::multiprecision::cpp_dec_float_50;
 
-struct BigNumHandler: public DeepFlatCopyHandler<BigNum> {
+struct BigNumHandler: public DeepFlatCopyHandler<BigNum, SlabAllocator> {
   virtual ~BigNumHandler() {}
 
   String typeName() const noexcept override {return "BigNum";}
-  String toString(ItemData data) const noexcept override { 
-    std::ostringstream ss;
-    ss << *reinterpret_cast<BigNum *>(data.ptrValue);
-    return ss.str();
-  }
+  // Same output of operator<< on a default stream, without building the stream.
+  String toString(ItemData data) const noexcept override { return payload(data).str(6); }
+  void toString(ItemData data, String& out) const noexcept override { out += payload(data).str(6); }
+
+  bool toBool(ItemData data) const noexcept override { return ! payload(data).is_zero(); }
+  int64 toInt(ItemData data) const noexcept override { return payload(data).convert_to<int64>(); }
 
-  bool toBool(ItemData data) const noexcept override { return ! static_cast<BigNum *>(data.ptrValue)->is_zero(); }
-  int64 toInt(ItemData data) const noexcept override { return reinterpret_cast<BigNum *>(data.ptrValue)->convert_to<int64>(); }
+  size_t hash(ItemData data) const noexcept override { return hashString(payload(data).str()); }
+  bool equals(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+    return other == this && payload(data) == payload(otherData);
+  }
+  int compare(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+    return other == this ? compareValues(payload(data), payload(otherData)) : compareTypes(other);
+  }
 };
 
 }
@@ -19,15 +19,24 @@
 
 namespace falcon {
 
-struct BoolHandler: public FlatHandler {
+struct BoolHandler final: public FlatHandler {
     virtual ~BoolHandler() {}
 
     virtual ItemData allocate() const {return false;}
 
     String typeName() const noexcept {return "Bool";}
     String toString(ItemData data) const noexcept override {return data.boolValue ? "true" : "false";}
+    void toString(ItemData data, String& out) const noexcept override {out += data.boolValue ? "true" : "false";}
     bool toBool(ItemData data) const noexcept override {return data.boolValue;}
     int64 toInt(ItemData data) const noexcept override {return data.boolValue ? 1LL : 0LL;}
+
+    size_t hash(ItemData data) const noexcept override {return data.boolValue ? 1 : 0;}
+    bool equals(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+      return other == this && data.boolValue == otherData.boolValue;
+    }
+    int compare(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+      return other == this ? compareValues(data.boolValue, otherData.boolValue) : compareTypes(other);
+    }
 };
 
 }
@@ -0,0 +1,417 @@
+/*****************************************************************************
+  FALCON - The Falcon Programming Language
+  FILE: boxeditem.h
+
+  Compact item layout, NaN-boxed in a single machine word.
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_BOXEDITEM_H_
+#define _FALCON_BOXEDITEM_H_
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "falcon/setup.h"
+#include "falcon/engine/handlerfactory.h"
+
+namespace falcon {
+
+/**
+ * Item layout packing value and type in a single 64 bit word.
+ *
+ * Floating point values are stored as they are. All the other types
+ * are encoded in the space of the negative quiet NaNs, which a double
+ * never occupies once NaNs are canonicalised:
+ *
+ * @code
+ *   63  62..52    51   50..48  47..0
+ *   1   1...1     1    tag     payload (48 bits)
+ * @endcode
+ *
+ * The handler is recovered from the tag, and the ItemData expected by the
+ * handler is rebuilt from the payload, so the handlers work unchanged on
+ * both this and the PairItem layout.
+ *
+ * Integers are stored inline when they fit in 48 bits. Wider integers,
+ * and the types without a tag of their own, are moved in a separately
+ * allocated cell holding handler and data, as in a PairItem. Strings up to six bytes are stored
+ * in the payload (on little endian hosts). Pointers must fit in 48 bits,
+ * which is the case for user-space addresses on all the supported 64 bit
+ * platforms.
+ */
+class BoxedItem {
+public:
+    enum Tag: uint64 {
+        TAG_NIL = 0,
+        TAG_BOOL = 1,
+        TAG_INT = 2,
+        TAG_EXTENDED = 3,
+        TAG_STRING = 4,
+        TAG_BIGNUM = 5,
+        TAG_SHORTSTRING = 6,
+        TAG_ATOM = 7,
+        TAG_FLOAT = 8
+    };
+
+    BoxedItem() noexcept : m_word(box(TAG_NIL, 0)) {}
+
+    template<typename T>
+    BoxedItem(T value) : m_word(box(TAG_NIL, 0)) {
+        if constexpr (std::is_same_v<T, bool>) {
+            m_word = box(TAG_BOOL, value ? 1 : 0);
+        } else if constexpr (std::is_same_v<T, char>) {
+            m_word = boxInt(static_cast<int64>(static_cast<uint64>(value)));
+        } else if constexpr (std::is_same_v<T, byte>) {
+            m_word = boxInt(static_cast<int64>(value));
+        } else if constexpr (std::is_same_v<T, int32>) {
+            m_word = boxInt(static_cast<int64>(value));
+        } else if constexpr (std::is_same_v<T, uint32>) {
+            m_word = boxInt(static_cast<int64>(value));
+        } else if constexpr (std::is_same_v<T, int64>) {
+            m_word = boxInt(value);
+        } else if constexpr (std::is_same_v<T, uint64>) {
+            m_word = boxInt(static_cast<int64>(value));
+        } else if constexpr (std::is_same_v<T, numeric>) {
+            m_word = boxFloat(value);
+        } else if constexpr (std::is_same_v<T, ccstring>) {
+            m_word = boxString(value, std::strlen(value));
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            m_word = boxString(value.data(), value.size());
+        }
+        else if constexpr (std::is_same_v<T, Atom*>) {
+            m_word = boxPtr(TAG_ATOM, value);
+        }
+        else if constexpr (std::is_same_v<T, BigNum>) {
+            m_word = boxPtr(TAG_BIGNUM, BigNumHandler::create(value).ptrValue);
+        }
+        else if constexpr (std::is_same_v<T, Int128>) {
+            m_word = boxExtended(&HandlerFactory::int128Handler, FixedIntHandler<128>::create(value));
+        }
+        else if constexpr (std::is_same_v<T, Int256>) {
+            m_word = boxExtended(&HandlerFactory::int256Handler, FixedIntHandler<256>::create(value));
+        }
+        else if constexpr (is_typed_array<T>::value) {
+            m_word = boxExtended(HandlerFactory::typedArrayHandler<typename T::value_type>(),
+                     TypedArrayHandler<typename T::value_type>::create(std::move(value)));
+        }
+        else if constexpr (std::is_same_v<T, Dict<BoxedItem>>) {
+            m_word = boxExtended(&HandlerFactory::boxedDictHandler, DictHandler<BoxedItem>::create(std::move(value)));
+        } else {
+            throw std::invalid_argument("Not a valid item type");
+        }
+    }
+
+    /** Copies share deep payloads, and only duplicate the extended cell. */
+    BoxedItem(const BoxedItem& other): m_word(clone(other.m_word)) {}
+    BoxedItem(BoxedItem&& other) noexcept : m_word(other.m_word) { other.m_word = box(TAG_NIL, 0); }
+
+    BoxedItem& operator=(const BoxedItem& other) {
+        if (this != &other) {
+            uint64 word = clone(other.m_word);
+            release(m_word);
+            m_word = word;
+        }
+        return *this;
+    }
+
+    BoxedItem& operator=(BoxedItem&& other) noexcept {
+        if (this != &other) {
+            release(m_word);
+            m_word = other.m_word;
+            other.m_word = box(TAG_NIL, 0);
+        }
+        return *this;
+    }
+
+    ~BoxedItem() {
+        release(m_word);
+    }
+
+    /**
+     * Write access to the deep payload of type T held by this item.
+     *
+     * If the payload is a value shared with other items, this item receives
+     * a private copy first. Strings stored inline or interned are promoted
+     * to a heap string.
+     *
+     * @throw std::invalid_argument if the item doesn't hold a T.
+     */
+    template<typename T>
+    T& modify() {
+        if constexpr (std::is_same_v<T, String>) {
+            if (tag() != TAG_STRING) {
+                uint64 word = boxPtr(TAG_STRING, StringHandler::create(toString()).ptrValue);
+                release(m_word);
+                m_word = word;
+            }
+        }
+        if (handler() != HandlerFactory::deepHandler<T>()) {
+            throw std::invalid_argument("Item doesn't hold the requested type");
+        }
+        Tag current = tag();
+        if (current == TAG_EXTENDED) {
+            Extended* cell = extended(m_word);
+            return static_cast<const DeepHandlerBase<T>*>(cell->handler)->writable(cell->data);
+        }
+        ItemData data = this->data();
+        T& value = static_cast<const DeepHandlerBase<T>*>(handler())->writable(data);
+        m_word = boxPtr(current, data.ptrValue);
+        return value;
+    }
+
+    /** Type tag of this item; TAG_FLOAT for non-boxed floating point values. */
+    Tag tag() const noexcept { return isFloat(m_word) ? TAG_FLOAT : static_cast<Tag>((m_word & TAG_MASK) >> TAG_SHIFT); }
+
+    /** Handler of this item. */
+    Handler* handler() const noexcept {
+        Tag current = tag();
+        return current == TAG_EXTENDED ? extended(m_word)->handler : handlerFor(current);
+    }
+
+    /** Handler associated with a tag; extended items have their handler in the cell. */
+    static Handler* handlerFor(Tag tag) noexcept {
+        switch(tag) {
+        case TAG_NIL: return &HandlerFactory::nilHandler;
+        case TAG_BOOL: return &HandlerFactory::boolHandler;
+        case TAG_INT: return &HandlerFactory::intHandler;
+        case TAG_EXTENDED: return nullptr;
+        case TAG_STRING: return &HandlerFactory::stringHandler;
+        case TAG_SHORTSTRING: return &HandlerFactory::shortStringHandler;
+        case TAG_ATOM: return &HandlerFactory::atomHandler;
+        case TAG_BIGNUM: return &HandlerFactory::bigNumHandler;
+        default: return &HandlerFactory::floatHandler;
+        }
+    }
+
+    /** Rebuilds the data as it would be stored in a PairItem. */
+    ItemData data() const noexcept {
+        ItemData data(0LL);
+        switch(tag()) {
+        case TAG_NIL: break;
+        case TAG_BOOL: data.boolValue = payload() != 0; break;
+        case TAG_INT: data.int64Value = intPayload(); break;
+        case TAG_EXTENDED: data = extended(m_word)->data; break;
+        case TAG_STRING: case TAG_BIGNUM: case TAG_ATOM: data.ptrValue = ptrPayload(); break;
+        case TAG_SHORTSTRING: data = ShortStringHandler::store(reinterpret_cast<const char*>(&m_word), SHORTSTRING_CAPACITY); break;
+        default: data.numericValue = floatPayload(); break;
+        }
+        return data;
+    }
+
+    /** The raw boxed word. */
+    uint64 word() const noexcept { return m_word; }
+
+    /**
+     * Replaces a heap string with its atom in the global StringPool.
+     *
+     * Equal interned strings share a single copy, and compare by pointer.
+     * The other items, short strings included, are left as they are.
+     */
+    void intern() {
+        if (tag() == TAG_STRING) {
+            uint64 word = boxPtr(TAG_ATOM, StringPool::global().intern(StringHandler::payload(data())));
+            release(m_word);
+            m_word = word;
+        }
+    }
+
+    template<typename T>
+    T get() const {
+        if constexpr (std::is_same_v<T, bool>) {
+            return data().boolValue;
+        } else if constexpr (std::is_same_v<T, int64>) {
+            return data().int64Value;
+        } else if constexpr (std::is_same_v<T, uint64>) {
+           return data().uint64Value;
+        } else if constexpr (std::is_same_v<T, numeric>) {
+            return data().numericValue;
+        } else if constexpr (std::is_same_v<T, String>) {
+           if (tag() == TAG_SHORTSTRING) {
+              return HandlerFactory::shortStringHandler.toString(data());
+           }
+           if (tag() == TAG_ATOM) {
+              return reinterpret_cast<Atom *>(ptrPayload())->value();
+           }
+           return StringHandler::payload(data());
+        }
+        else if constexpr (std::is_same_v<T, BigNum>) {
+           return BigNumHandler::payload(data());
+        }
+        else if constexpr (std::is_same_v<T, Int128> || std::is_same_v<T, Int256>) {
+           return FixedIntHandler<T::BITS>::payload(data());
+        }
+        else if constexpr (is_typed_array<T>::value) {
+           return TypedArrayHandler<typename T::value_type>::payload(data());
+        }
+        else if constexpr (std::is_same_v<T, Dict<BoxedItem>>) {
+           return DictHandler<BoxedItem>::payload(data());
+        } else {
+            throw std::invalid_argument("Not a valid item type");
+        }
+    }
+
+    /**
+     * Invokes func on the concrete handler and the data of this item.
+     *
+     * Flat types are decoded straight from the tag, and their (final) handlers
+     * are called without virtual dispatch.
+     */
+    template<typename _Func>
+    decltype(auto) dispatch(_Func&& func) const {
+        switch(tag()) {
+        case TAG_INT: return func(HandlerFactory::intHandler, ItemData(intPayload()));
+        case TAG_FLOAT: return func(HandlerFactory::floatHandler, ItemData(floatPayload()));
+        case TAG_BOOL: return func(HandlerFactory::boolHandler, ItemData(payload() != 0));
+        case TAG_NIL: return func(HandlerFactory::nilHandler, ItemData(0LL));
+        case TAG_SHORTSTRING: return func(HandlerFactory::shortStringHandler, data());
+        default: return func(*handler(), data());
+        }
+    }
+
+    String toString() const noexcept {return dispatch([](const auto& h, ItemData d) {return h.toString(d);});}
+    void toString(String& out) const noexcept {dispatch([&](const auto& h, ItemData d) {h.toString(d, out);});}
+    int64 toInt() const noexcept {return dispatch([](const auto& h, ItemData d) {return h.toInt(d);});}
+    bool toBool() const noexcept {return dispatch([](const auto& h, ItemData d) {return h.toBool(d);});}
+
+    size_t hash() const noexcept {return dispatch([](const auto& h, ItemData d) {return h.hash(d);});}
+    bool equals(const BoxedItem& other) const noexcept {
+        // Same word, same value; except for floats, as NaN is not equal to itself.
+        if (m_word == other.m_word && !isFloat(m_word)) {
+            return true;
+        }
+        return dispatch([&](const auto& h, ItemData d) {return h.equals(d, other.handler(), other.data());});
+    }
+    int compare(const BoxedItem& other) const noexcept {
+        return dispatch([&](const auto& h, ItemData d) {return h.compare(d, other.handler(), other.data());});
+    }
+
+private:
+    static constexpr uint64 BOX_MASK = 0xFFF8000000000000ULL;
+    static constexpr uint64 TAG_MASK = 0x0007000000000000ULL;
+    static constexpr uint64 PAYLOAD_MASK = 0x0000FFFFFFFFFFFFULL;
+    static constexpr uint64 CANONICAL_NAN = 0x7FF8000000000000ULL;
+    static constexpr unsigned TAG_SHIFT = 48;
+    // The short string is stored in the lower bytes of the word.
+    static constexpr size_t SHORTSTRING_CAPACITY = FALCON_LITTLE_ENDIAN ? 6 : 0;
+
+    uint64 m_word;
+
+    /** Out of line storage for the items that don't fit the boxed word. */
+    struct Extended {
+        Handler* handler;
+        ItemData data;
+    };
+    using ExtendedAllocator = SlabAllocator<Extended>;
+
+    static constexpr uint64 box(Tag tag, uint64 payload) noexcept {
+        return BOX_MASK | (static_cast<uint64>(tag) << TAG_SHIFT) | (payload & PAYLOAD_MASK);
+    }
+
+    static bool isFloat(uint64 word) noexcept { return (word & BOX_MASK) != BOX_MASK; }
+
+    static uint64 boxFloat(numeric value) noexcept {
+        if (std::isnan(value)) {
+            return CANONICAL_NAN;
+        }
+        uint64 word;
+        std::memcpy(&word, &value, sizeof(word));
+        return word;
+    }
+
+    static uint64 boxInt(int64 value) {
+        // fits if sign-extending the lower 48 bits gives back the same value.
+        if ((static_cast<int64>(static_cast<uint64>(value) << 16) >> 16) == value) {
+            return box(TAG_INT, static_cast<uint64>(value));
+        }
+        return boxExtended(&HandlerFactory::intHandler, ItemData(value));
+    }
+
+    static uint64 boxExtended(Handler* handler, ItemData data) {
+        Extended* cell = ExtendedAllocator().allocate(1);
+        new (cell) Extended{handler, data};
+        return boxPtr(TAG_EXTENDED, cell);
+    }
+
+    static Extended* extended(uint64 word) noexcept { return reinterpret_cast<Extended*>(word & PAYLOAD_MASK); }
+
+    static uint64 boxString(const char* str, size_t len) {
+        if (ShortStringHandler::fits(str, len, SHORTSTRING_CAPACITY)) {
+            uint64 word = box(TAG_SHORTSTRING, 0);
+            std::memcpy(&word, str, len);
+            return word;
+        }
+        return boxPtr(TAG_STRING, StringHandler::create(str, len).ptrValue);
+    }
+
+    static uint64 boxPtr(Tag tag, void* ptr) noexcept {
+        assert((reinterpret_cast<uint64>(ptr) & ~PAYLOAD_MASK) == 0);
+        return box(tag, reinterpret_cast<uint64>(ptr));
+    }
+
+    uint64 payload() const noexcept { return m_word & PAYLOAD_MASK; }
+    int64 intPayload() const noexcept { return static_cast<int64>(m_word << 16) >> 16; }
+    void* ptrPayload() const noexcept { return reinterpret_cast<void*>(payload()); }
+    numeric floatPayload() const noexcept {
+        numeric value;
+        std::memcpy(&value, &m_word, sizeof(value));
+        return value;
+    }
+
+    static ItemData ptrData(void* ptr) noexcept {
+        ItemData data(0LL);
+        data.ptrValue = ptr;
+        return data;
+    }
+
+    // Extended items have a private cell; the other payloads are shared by their handler.
+    static uint64 clone(uint64 word) {
+        if (isFloat(word)) {
+            return word;
+        }
+        void* ptr = reinterpret_cast<void*>(word & PAYLOAD_MASK);
+        Tag tag = static_cast<Tag>((word & TAG_MASK) >> TAG_SHIFT);
+        switch(tag) {
+        case TAG_EXTENDED: {
+            Extended* cell = extended(word);
+            return boxExtended(cell->handler, cell->handler->copy(cell->data));
+        }
+        case TAG_STRING: case TAG_BIGNUM: case TAG_ATOM: handlerFor(tag)->copy(ptrData(ptr)); return word;
+        default: return word;
+        }
+    }
+
+    static void release(uint64 word) noexcept {
+        if (isFloat(word)) {
+            return;
+        }
+        void* ptr = reinterpret_cast<void*>(word & PAYLOAD_MASK);
+        Tag tag = static_cast<Tag>((word & TAG_MASK) >> TAG_SHIFT);
+        switch(tag) {
+        case TAG_EXTENDED: {
+            Extended* cell = extended(word);
+            cell->handler->destroy(cell->data);
+            ExtendedAllocator().deallocate(cell, 1);
+            break;
+        }
+        case TAG_STRING: case TAG_BIGNUM: case TAG_ATOM: handlerFor(tag)->destroy(ptrData(ptr)); break;
+        default: break;
+        }
+    }
+};
+
+static_assert(sizeof(BoxedItem) == 8, "BoxedItem must fit in a single machine word");
+
+}
+
+#endif
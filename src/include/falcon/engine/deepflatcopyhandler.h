@@ -20,8 +20,25 @@
 
 namespace falcon {
 
-template<typename T>
-struct DeepFlatCopyHandler: public DeepHandler<T> {
+/**
+ * Deep items behaving as values.
+ *
+ * Copies share the payload as long as it's just read; the first write
+ * on a shared payload detaches a private clone (copy-on-write).
+ */
+template<typename T, template<typename> typename _Allocator=std::allocator>
+struct DeepFlatCopyHandler: public DeepHandler<T, _Allocator> {
+    using Base = DeepHandler<T, _Allocator>;
+
+    T& writable(ItemData& data) const override {
+        if (Base::refCount(data) > 1) {
+            ItemData clone = Base::create(Base::payload(data));
+            this->destroy(data);
+            data = clone;
+        }
+        return Base::payload(data);
+    }
+
     bool isCopyFlat() const noexcept override { return true; }
 };
 
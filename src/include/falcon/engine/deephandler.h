@@ -16,21 +16,99 @@
 #ifndef _FALCON_DEEPHANDLER_H_
 #define _FALCON_DEEPHANDLER_H_
 
+#include <atomic>
+#include <memory>
+#include <utility>
 #include "falcon/engine/handler.h"
 
 namespace falcon {
 
+/**
+ * Common part of the handlers of deep items with a payload of type T.
+ *
+ * The payload is stored in a Cell together with an intrusive reference
+ * count: copying an item just shares the cell, and the payload is deleted
+ * when the last item referencing it is destroyed.
+ *
+ * Deep items have reference semantics: writing through a copy is visible
+ * to all the others.
+ */
 template<typename T>
-struct DeepHandler: public Handler {
-    virtual ~DeepHandler() {}
+struct DeepHandlerBase: public Handler {
+    struct Cell {
+        template<typename... _Args>
+        Cell(_Args&&... args): value(std::forward<_Args>(args)...) {}
+
+        std::atomic<uint32> refCount{1};
+        T value;
+    };
+
+    virtual ~DeepHandlerBase() {}
+
+    static Cell* cell(ItemData data) noexcept { return reinterpret_cast<Cell *>(data.ptrValue); }
+    static T& payload(ItemData data) noexcept { return cell(data)->value; }
+    static uint32 refCount(ItemData data) noexcept { return cell(data)->refCount.load(std::memory_order_acquire); }
 
-    ItemData allocate() const override {return new T;}
-    void destroy(ItemData data) const noexcept override { delete reinterpret_cast<T *>(data.ptrValue);}
+    ItemData copy(ItemData data) const noexcept override {
+        cell(data)->refCount.fetch_add(1, std::memory_order_relaxed);
+        return data;
+    }
+
+    /**
+     * Gives write access to the payload.
+     *
+     * The data might be changed by the handler, in which case the
+     * item must store the new data.
+     */
+    virtual T& writable(ItemData& data) const { return payload(data); }
 
     bool isFlat() const noexcept override { return false; }
     bool isCopyFlat() const noexcept override { return false; }
 };
 
+/**
+ * Root handler for the deep items.
+ *
+ * The cells are obtained from the _Allocator template parameter,
+ * as done by PagedStack. The allocator must be stateless.
+ */
+template<typename T, template<typename> typename _Allocator=std::allocator>
+struct DeepHandler: public DeepHandlerBase<T> {
+    using Cell = typename DeepHandlerBase<T>::Cell;
+    using allocator_type = _Allocator<Cell>;
+
+    virtual ~DeepHandler() {}
+
+    /** Creates a new cell (with one reference) built with the given arguments. */
+    template<typename... _Args>
+    static ItemData create(_Args&&... args) {
+        allocator_type allocator;
+        Cell* cell = std::allocator_traits<allocator_type>::allocate(allocator, 1);
+        try {
+            std::allocator_traits<allocator_type>::construct(allocator, cell, std::forward<_Args>(args)...);
+        }
+        catch(...) {
+            std::allocator_traits<allocator_type>::deallocate(allocator, cell, 1);
+            throw;
+        }
+
+        ItemData data(0LL);
+        data.ptrValue = cell;
+        return data;
+    }
+
+    ItemData allocate() const override {return create();}
+
+    void destroy(ItemData data) const noexcept override {
+        Cell* cell = DeepHandlerBase<T>::cell(data);
+        if (cell->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            allocator_type allocator;
+            std::allocator_traits<allocator_type>::destroy(allocator, cell);
+            std::allocator_traits<allocator_type>::deallocate(allocator, cell, 1);
+        }
+    }
+};
+
 }
 
 #endif
@@ -0,0 +1,411 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: dict.h
+
+  Dictionary of items, with open addressing
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_DICT_H_
+#define _FALCON_DICT_H_
+
+#include <algorithm>
+#include <initializer_list>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "falcon/types.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FALCON_DICT_SSE2
+#endif
+
+namespace falcon {
+
+/**
+ * Dictionary mapping items to items.
+ *
+ * The hash table uses open addressing, in the style of the "Swiss tables":
+ * each slot has a control byte holding 7 bits of the key hash, and lookups
+ * scan the control bytes a group at a time (with SSE2, where available)
+ * before touching any key. Hashing and equality are provided by the handlers
+ * of the keys.
+ *
+ * The key/value pairs are kept in a separate vector, in insertion order, and
+ * the slots just refer to them. Iteration follows the insertion order, or the
+ * order of the keys when the dictionary is set in Order::SORTED mode.
+ *
+ * With setInternKeys(true), string keys are interned in the global
+ * StringPool when they are added (see Item::intern()): equal keys of
+ * different dictionaries share a single copy, and lookups with interned
+ * keys compare them by pointer, but each new key takes a lock of the pool.
+ *
+ * The template parameter is the item layout; the dictionary doesn't depend
+ * on the handlers of the engine.
+ */
+template<typename _Item>
+class Dict
+{
+public:
+   enum class Order {
+      INSERTION,
+      SORTED
+   };
+
+   using item_type = _Item;
+
+   Dict() = default;
+
+   Dict(std::initializer_list<std::pair<_Item, _Item>> values) {
+      reserve(values.size());
+      for (auto& value: values) {
+         set(value.first, value.second);
+      }
+   }
+
+   size_t size() const noexcept { return m_size; }
+   bool empty() const noexcept { return m_size == 0; }
+   /** Number of slots in the hash table. */
+   size_t capacity() const noexcept { return m_ctrl.size(); }
+
+   Order order() const noexcept { return m_order; }
+   void setOrder(Order order) noexcept { m_order = order; }
+
+   /** True if the string keys added from now on are interned; off by default. */
+   bool internKeys() const noexcept { return m_internKeys; }
+   void setInternKeys(bool mode) noexcept { m_internKeys = mode; }
+
+   /** The value associated with key, or nullptr if key is not in the dictionary. */
+   _Item* find(const _Item& key) noexcept {
+      size_t slot = findSlot(key, mix(key.hash()));
+      return slot == NPOS ? nullptr : &m_nodes[m_slots[slot]].value;
+   }
+
+   const _Item* find(const _Item& key) const noexcept { return const_cast<Dict*>(this)->find(key); }
+
+   bool contains(const _Item& key) const noexcept { return find(key) != nullptr; }
+
+   /** Associates value to key; returns true if the key was not in the dictionary. */
+   bool set(const _Item& key, const _Item& value) {
+      auto pos = emplace(key);
+      m_nodes[pos.first].value = value;
+      return pos.second;
+   }
+
+   /** The value associated with key, which is added with a nil value if necessary. */
+   _Item& operator[](const _Item& key) { return m_nodes[emplace(key).first].value; }
+
+   /** Removes key; returns false if it was not in the dictionary. */
+   bool erase(const _Item& key) noexcept {
+      size_t slot = findSlot(key, mix(key.hash()));
+      if (slot == NPOS) {
+         return false;
+      }
+
+      // The node stays in place (as a hole) until the next rehash.
+      Node& node = m_nodes[m_slots[slot]];
+      node.key = _Item();
+      node.value = _Item();
+      node.live = false;
+      m_ctrl[slot] = DELETED;
+      ++m_tombstones;
+      --m_size;
+      m_sortedValid = false;
+      return true;
+   }
+
+   /** Adds all the pairs of other, overwriting the values of the keys already present. */
+   void merge(const Dict& other) {
+      if (&other == this) {
+         return;
+      }
+      reserve(m_size + other.m_size);
+      for (const Node& node: other.m_nodes) {
+         if (node.live) {
+            m_nodes[emplace(node.key, node.hash).first].value = node.value;
+         }
+      }
+   }
+
+   void clear() noexcept {
+      m_ctrl.clear();
+      m_slots.clear();
+      m_nodes.clear();
+      m_sorted.clear();
+      m_size = 0;
+      m_tombstones = 0;
+      m_sortedValid = false;
+   }
+
+   /** Makes room for count pairs without rehashing. */
+   void reserve(size_t count) {
+      if (count <= m_size) {
+         return;
+      }
+      size_t capacity = std::max<size_t>(m_ctrl.size(), Group::SIZE);
+      while (count > maxLoad(capacity)) {
+         capacity *= 2;
+      }
+      if (capacity != m_ctrl.size()) {
+         rehash(capacity);
+      }
+      m_nodes.reserve(count);
+   }
+
+   /** Invokes func(key, value) on each pair, in the order set for this dictionary. */
+   template<typename _Func>
+   void forEach(_Func&& func) const {
+      if (m_order == Order::SORTED) {
+         for (uint32 pos: sortedNodes()) {
+            func(m_nodes[pos].key, m_nodes[pos].value);
+         }
+      }
+      else {
+         for (const Node& node: m_nodes) {
+            if (node.live) {
+               func(node.key, node.value);
+            }
+         }
+      }
+   }
+
+   /** Appends the pairs to out, as "[key => value, ...]". */
+   void toString(String& out) const {
+      out += '[';
+      bool first = true;
+      forEach([&](const _Item& key, const _Item& value) {
+         if (!first) {
+            out += ", ";
+         }
+         first = false;
+         key.toString(out);
+         out += " => ";
+         value.toString(out);
+      });
+      out += ']';
+   }
+
+private:
+   using ctrl_t = signed char;
+
+   // Control bytes of the free slots; the full ones hold 7 bits of hash.
+   static constexpr ctrl_t EMPTY = -128;
+   static constexpr ctrl_t DELETED = -2;
+   static constexpr size_t NPOS = std::numeric_limits<size_t>::max();
+
+   /** Operations on a group of control bytes, scanned together. */
+   struct Group {
+      enum { SIZE = 16 };
+
+#ifdef FALCON_DICT_SSE2
+      static uint32 match(const ctrl_t* ctrl, ctrl_t h2) noexcept {
+         __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+         return static_cast<uint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), group)));
+      }
+
+      static uint32 matchEmpty(const ctrl_t* ctrl) noexcept { return match(ctrl, EMPTY); }
+
+      // Free slots are the only ones with a negative control byte.
+      static uint32 matchFree(const ctrl_t* ctrl) noexcept {
+         __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+         return static_cast<uint32>(_mm_movemask_epi8(group));
+      }
+#else
+      static uint32 match(const ctrl_t* ctrl, ctrl_t h2) noexcept {
+         uint32 mask = 0;
+         for (unsigned i = 0; i < SIZE; ++i) {
+            mask |= static_cast<uint32>(ctrl[i] == h2) << i;
+         }
+         return mask;
+      }
+
+      static uint32 matchEmpty(const ctrl_t* ctrl) noexcept { return match(ctrl, EMPTY); }
+
+      static uint32 matchFree(const ctrl_t* ctrl) noexcept {
+         uint32 mask = 0;
+         for (unsigned i = 0; i < SIZE; ++i) {
+            mask |= static_cast<uint32>(ctrl[i] < 0) << i;
+         }
+         return mask;
+      }
+#endif
+
+      static unsigned lowest(uint32 mask) noexcept {
+#if defined(__GNUC__)
+         return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+         unsigned pos = 0;
+         while ((mask & 1) == 0) {
+            mask >>= 1;
+            ++pos;
+         }
+         return pos;
+#endif
+      }
+   };
+
+   struct Node {
+      _Item key;
+      _Item value;
+      size_t hash;
+      bool live;
+   };
+
+   std::vector<ctrl_t> m_ctrl;
+   std::vector<uint32> m_slots;
+   std::vector<Node> m_nodes;
+   size_t m_size{0};
+   size_t m_tombstones{0};
+   Order m_order{Order::INSERTION};
+   bool m_internKeys{false};
+   mutable std::vector<uint32> m_sorted;
+   mutable bool m_sortedValid{false};
+
+   // Handlers are free to return weak hashes (i.e. integers as they are).
+   static size_t mix(size_t hash) noexcept {
+      uint64 value = static_cast<uint64>(hash);
+      value ^= value >> 33;
+      value *= 0xff51afd7ed558ccdULL;
+      value ^= value >> 33;
+      value *= 0xc4ceb9fe1a85ec53ULL;
+      value ^= value >> 33;
+      return static_cast<size_t>(value);
+   }
+
+   static ctrl_t h2(size_t hash) noexcept { return static_cast<ctrl_t>(hash & 0x7F); }
+
+   // Keep at least 1/8 of the slots empty, so that probing always ends.
+   static size_t maxLoad(size_t capacity) noexcept { return capacity - capacity / 8; }
+
+   /** Slot of the key, or NPOS; groups are probed quadratically. */
+   size_t findSlot(const _Item& key, size_t hash) const noexcept {
+      if (m_ctrl.empty()) {
+         return NPOS;
+      }
+      const size_t groupMask = m_ctrl.size() / Group::SIZE - 1;
+      size_t group = (hash >> 7) & groupMask;
+      for (size_t step = 1; ; ++step) {
+         const ctrl_t* ctrl = m_ctrl.data() + group * Group::SIZE;
+         for (uint32 mask = Group::match(ctrl, h2(hash)); mask != 0; mask &= mask - 1) {
+            size_t slot = group * Group::SIZE + Group::lowest(mask);
+            const Node& node = m_nodes[m_slots[slot]];
+            if (node.hash == hash && node.key.equals(key)) {
+               return slot;
+            }
+         }
+         if (Group::matchEmpty(ctrl) != 0) {
+            return NPOS;
+         }
+         group = (group + step) & groupMask;
+      }
+   }
+
+   /** First free slot on the probe sequence of hash; the table must have one. */
+   size_t findFree(size_t hash) const noexcept {
+      const size_t groupMask = m_ctrl.size() / Group::SIZE - 1;
+      size_t group = (hash >> 7) & groupMask;
+      for (size_t step = 1; ; ++step) {
+         uint32 mask = Group::matchFree(m_ctrl.data() + group * Group::SIZE);
+         if (mask != 0) {
+            return group * Group::SIZE + Group::lowest(mask);
+         }
+         group = (group + step) & groupMask;
+      }
+   }
+
+   std::pair<size_t, bool> emplace(const _Item& key) { return emplace(key, mix(key.hash())); }
+
+   /** Position of the node of key, and true if it was just added. */
+   std::pair<size_t, bool> emplace(const _Item& key, size_t hash) {
+      size_t slot = findSlot(key, hash);
+      if (slot != NPOS) {
+         return {m_slots[slot], false};
+      }
+
+      // Grow when the table is full, but just clean up if it's full of tombstones
+      // or if too many nodes are holes left by erase().
+      if (m_size + m_tombstones + 1 > maxLoad(m_ctrl.size()) || m_nodes.size() >= 2 * m_size + Group::SIZE) {
+         size_t capacity = std::max<size_t>(m_ctrl.size(), Group::SIZE);
+         while (m_size + 1 > maxLoad(capacity) / 2) {
+            capacity *= 2;
+         }
+         rehash(capacity);
+      }
+
+      slot = findFree(hash);
+      if (m_ctrl[slot] == DELETED) {
+         --m_tombstones;
+      }
+      size_t pos = m_nodes.size();
+      m_nodes.push_back(Node{key, _Item(), hash, true});
+      if (m_internKeys) {
+         m_nodes.back().key.intern();
+      }
+      m_ctrl[slot] = h2(hash);
+      m_slots[slot] = static_cast<uint32>(pos);
+      ++m_size;
+      m_sortedValid = false;
+      return {pos, true};
+   }
+
+   /** Rebuilds the table with the given number of slots, dropping the holes in the nodes. */
+   void rehash(size_t capacity) {
+      if (m_nodes.size() != m_size) {
+         std::vector<Node> nodes;
+         nodes.reserve(std::max(m_nodes.capacity(), m_size + 1));
+         for (Node& node: m_nodes) {
+            if (node.live) {
+               nodes.push_back(std::move(node));
+            }
+         }
+         m_nodes.swap(nodes);
+      }
+
+      m_ctrl.assign(capacity, EMPTY);
+      m_slots.assign(capacity, 0);
+      m_tombstones = 0;
+      m_sortedValid = false;
+      for (size_t pos = 0; pos < m_nodes.size(); ++pos) {
+         size_t slot = findFree(m_nodes[pos].hash);
+         m_ctrl[slot] = h2(m_nodes[pos].hash);
+         m_slots[slot] = static_cast<uint32>(pos);
+      }
+   }
+
+   const std::vector<uint32>& sortedNodes() const {
+      if (!m_sortedValid) {
+         m_sorted.clear();
+         m_sorted.reserve(m_size);
+         for (size_t pos = 0; pos < m_nodes.size(); ++pos) {
+            if (m_nodes[pos].live) {
+               m_sorted.push_back(static_cast<uint32>(pos));
+            }
+         }
+         std::sort(m_sorted.begin(), m_sorted.end(), [this](uint32 first, uint32 second) {
+            return m_nodes[first].key.compare(m_nodes[second].key) < 0;
+         });
+         m_sortedValid = true;
+      }
+      return m_sorted;
+   }
+};
+
+template<typename _T>
+struct is_dict: std::false_type {};
+template<typename _Item>
+struct is_dict<Dict<_Item>>: std::true_type {};
+
+}
+
+#endif /* _FALCON_DICT_H_ */
+
+/* end of dict.h */
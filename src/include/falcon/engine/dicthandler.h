@@ -0,0 +1,50 @@
+/*****************************************************************************
+  FALCON - The Falcon Programming Language
+  FILE: dicthandler.h
+
+  Handler for dictionary items.
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin : 
+  Touch : 
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+#ifndef _FALCON_DICTHANDLER_H_
+#define _FALCON_DICTHANDLER_H_
+
+#include "falcon/engine/dict.h"
+#include "falcon/engine/deephandler.h"
+
+namespace falcon {
+
+/**
+ * Handler for Dict items.
+ *
+ * Dictionaries are deep: copies of the item refer to the same dictionary.
+ * There is an handler for each item layout.
+ */
+template<typename _Item>
+struct DictHandler final: public DeepHandler<Dict<_Item>> {
+  using Base = DeepHandler<Dict<_Item>>;
+
+  virtual ~DictHandler() {}
+
+  String typeName() const noexcept override {return "Dictionary";}
+
+  String toString(ItemData data) const noexcept override {
+    String out;
+    Base::payload(data).toString(out);
+    return out;
+  }
+  void toString(ItemData data, String& out) const noexcept override { Base::payload(data).toString(out); }
+
+  bool toBool(ItemData data) const noexcept override { return ! Base::payload(data).empty(); }
+  int64 toInt(ItemData data) const noexcept override { return static_cast<int64>(Base::payload(data).size()); }
+};
+
+}
+
+#endif
@@ -0,0 +1,365 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: fixedint.h
+
+  Fixed width big integers
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_FIXEDINT_H_
+#define _FALCON_FIXEDINT_H_
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "falcon/types.h"
+
+namespace falcon {
+
+/**
+ * Signed integer of _Bits bits, in two's complement.
+ *
+ * The value is stored inline as an array of 64 bit limbs, least significant
+ * first, so it never allocates memory. Arithmetic wraps around modulo 2^_Bits,
+ * as for the native unsigned integers.
+ *
+ * Exact decimal quantities can be represented as integers scaled by a fixed
+ * power of ten (i.e. cents, or millionths).
+ */
+template<unsigned _Bits>
+class FixedInt {
+public:
+   static_assert(_Bits >= 128 && _Bits % 64 == 0, "FixedInt width must be a multiple of 64 bits");
+
+   enum {
+      BITS = _Bits,
+      LIMBS = _Bits / 64
+   };
+
+   constexpr FixedInt() noexcept : m_limbs{} {}
+
+   constexpr FixedInt(int64 value) noexcept : m_limbs{} {
+      uint64 extension = value < 0 ? ~uint64(0) : 0;
+      m_limbs[0] = static_cast<uint64>(value);
+      for (unsigned i = 1; i < LIMBS; ++i) {
+         m_limbs[i] = extension;
+      }
+   }
+
+   /**
+    * Parses a decimal number, with an optional sign.
+    *
+    * @throw std::invalid_argument if the string is not a decimal integer.
+    * @throw std::out_of_range if the number is outside [min(), max()].
+    */
+   static FixedInt parse(const char* str, size_t len) {
+      size_t pos = 0;
+      bool negative = false;
+      if (len > 0 && (str[0] == '-' || str[0] == '+')) {
+         negative = str[0] == '-';
+         ++pos;
+      }
+      if (pos == len) {
+         throw std::invalid_argument("Not a valid integer");
+      }
+
+      // The magnitude is accumulated unsigned, and checked against the sign at the end.
+      FixedInt value;
+      bool overflow = false;
+      while (pos < len) {
+         // Consume up to 9 digits at a time, so that they fit a limb multiplier.
+         size_t end = std::min(len, pos + 9);
+         uint32 chunk = 0;
+         uint32 scale = 1;
+         for (; pos < end; ++pos) {
+            if (str[pos] < '0' || str[pos] > '9') {
+               throw std::invalid_argument("Not a valid integer");
+            }
+            chunk = chunk * 10 + static_cast<uint32>(str[pos] - '0');
+            scale *= 10;
+         }
+         overflow |= value.mulSmall(scale) != 0;
+         overflow |= value.addSmall(chunk) != 0;
+      }
+      // Only min() has the sign bit set in its magnitude.
+      if (overflow || (value.isNegative() && !(negative && value == min()))) {
+         throw std::out_of_range("Integer literal out of range");
+      }
+      return negative ? -value : value;
+   }
+
+   static FixedInt parse(const String& str) { return parse(str.data(), str.size()); }
+
+   static constexpr FixedInt max() noexcept {
+      FixedInt value;
+      for (unsigned i = 0; i < LIMBS - 1; ++i) {
+         value.m_limbs[i] = ~uint64(0);
+      }
+      value.m_limbs[LIMBS - 1] = ~uint64(0) >> 1;
+      return value;
+   }
+
+   static constexpr FixedInt min() noexcept {
+      FixedInt value;
+      value.m_limbs[LIMBS - 1] = uint64(1) << 63;
+      return value;
+   }
+
+   uint64 limb(unsigned pos) const noexcept { return m_limbs[pos]; }
+
+   bool isNegative() const noexcept { return static_cast<int64>(m_limbs[LIMBS - 1]) < 0; }
+
+   bool isZero() const noexcept {
+      uint64 bits = 0;
+      for (unsigned i = 0; i < LIMBS; ++i) {
+         bits |= m_limbs[i];
+      }
+      return bits == 0;
+   }
+
+   /** True if the value can be represented as an int64. */
+   bool fitsInt64() const noexcept {
+      uint64 extension = static_cast<int64>(m_limbs[0]) < 0 ? ~uint64(0) : 0;
+      for (unsigned i = 1; i < LIMBS; ++i) {
+         if (m_limbs[i] != extension) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   /** Converts to int64, saturating values out of range. */
+   int64 toInt64() const noexcept {
+      if (fitsInt64()) {
+         return static_cast<int64>(m_limbs[0]);
+      }
+      return isNegative() ? std::numeric_limits<int64>::min() : std::numeric_limits<int64>::max();
+   }
+
+   String toString() const {
+      String out;
+      toString(out);
+      return out;
+   }
+
+   /** Appends the decimal representation of this value to out. */
+   void toString(String& out) const {
+      FixedInt value = isNegative() ? -*this : *this;
+      // -min() is min() again, but read as unsigned it's the right magnitude.
+      char buffer[_Bits / 3 + 3];
+      char* end = buffer + sizeof(buffer);
+      char* cur = end;
+      do {
+         uint32 chunk = value.divSmall(1000000000);
+         bool last = value.isZero();
+         for (int i = 0; i < 9 && (!last || chunk != 0 || i == 0); ++i) {
+            *--cur = static_cast<char>('0' + chunk % 10);
+            chunk /= 10;
+         }
+      } while (!value.isZero());
+      if (isNegative()) {
+         *--cur = '-';
+      }
+      out.append(cur, end);
+   }
+
+   FixedInt operator-() const noexcept {
+      FixedInt result;
+      uint64 carry = 1;
+      for (unsigned i = 0; i < LIMBS; ++i) {
+         result.m_limbs[i] = addCarry(~m_limbs[i], 0, carry);
+      }
+      return result;
+   }
+
+   FixedInt& operator+=(const FixedInt& other) noexcept {
+      uint64 carry = 0;
+      for (unsigned i = 0; i < LIMBS; ++i) {
+         m_limbs[i] = addCarry(m_limbs[i], other.m_limbs[i], carry);
+      }
+      return *this;
+   }
+
+   FixedInt& operator-=(const FixedInt& other) noexcept {
+      uint64 carry = 1;
+      for (unsigned i = 0; i < LIMBS; ++i) {
+         m_limbs[i] = addCarry(m_limbs[i], ~other.m_limbs[i], carry);
+      }
+      return *this;
+   }
+
+   FixedInt& operator*=(const FixedInt& other) noexcept {
+      *this = *this * other;
+      return *this;
+   }
+
+   friend FixedInt operator+(FixedInt a, const FixedInt& b) noexcept { return a += b; }
+   friend FixedInt operator-(FixedInt a, const FixedInt& b) noexcept { return a -= b; }
+
+   /** Product truncated to _Bits; in two's complement the sign needs no special care. */
+   friend FixedInt operator*(const FixedInt& a, const FixedInt& b) noexcept {
+      FixedInt result;
+      for (unsigned i = 0; i < LIMBS; ++i) {
+         uint64 carry = 0;
+         for (unsigned j = 0; j + i < LIMBS; ++j) {
+            uint64 high;
+            uint64 low = mulWide(a.m_limbs[i], b.m_limbs[j], high);
+            uint64 sumCarry = 0;
+            low = addCarry(low, result.m_limbs[i + j], sumCarry);
+            high += sumCarry;
+            sumCarry = 0;
+            result.m_limbs[i + j] = addCarry(low, carry, sumCarry);
+            carry = high + sumCarry;
+         }
+      }
+      return result;
+   }
+
+   /** Returns -1, 0 or 1 as a is less than, equal to or greater than b. */
+   friend int compare(const FixedInt& a, const FixedInt& b) noexcept {
+      if (a.isNegative() != b.isNegative()) {
+         return a.isNegative() ? -1 : 1;
+      }
+      for (unsigned i = LIMBS; i-- > 0;) {
+         if (a.m_limbs[i] != b.m_limbs[i]) {
+            return a.m_limbs[i] < b.m_limbs[i] ? -1 : 1;
+         }
+      }
+      return 0;
+   }
+
+   friend bool operator==(const FixedInt& a, const FixedInt& b) noexcept {
+      uint64 diff = 0;
+      for (unsigned i = 0; i < LIMBS; ++i) {
+         diff |= a.m_limbs[i] ^ b.m_limbs[i];
+      }
+      return diff == 0;
+   }
+
+   friend bool operator!=(const FixedInt& a, const FixedInt& b) noexcept { return !(a == b); }
+   friend bool operator<(const FixedInt& a, const FixedInt& b) noexcept { return compare(a, b) < 0; }
+   friend bool operator<=(const FixedInt& a, const FixedInt& b) noexcept { return compare(a, b) <= 0; }
+   friend bool operator>(const FixedInt& a, const FixedInt& b) noexcept { return compare(a, b) > 0; }
+   friend bool operator>=(const FixedInt& a, const FixedInt& b) noexcept { return compare(a, b) >= 0; }
+
+private:
+   uint64 m_limbs[LIMBS];
+
+   static uint64 addCarry(uint64 a, uint64 b, uint64& carry) noexcept {
+      uint64 sum = a + b;
+      uint64 out = sum < a;
+      uint64 result = sum + carry;
+      out |= result < sum;
+      carry = out;
+      return result;
+   }
+
+   static uint64 mulWide(uint64 a, uint64 b, uint64& high) noexcept {
+#ifdef __SIZEOF_INT128__
+      unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+      high = static_cast<uint64>(product >> 64);
+      return static_cast<uint64>(product);
+#else
+      uint64 aLow = a & 0xFFFFFFFF, aHigh = a >> 32;
+      uint64 bLow = b & 0xFFFFFFFF, bHigh = b >> 32;
+      uint64 ll = aLow * bLow;
+      uint64 lh = aLow * bHigh;
+      uint64 hl = aHigh * bLow;
+      uint64 hh = aHigh * bHigh;
+      uint64 mid = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+      high = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+      return (mid << 32) | (ll & 0xFFFFFFFF);
+#endif
+   }
+
+   /** Unsigned multiplication by a 32 bit factor, in place; returns the carry out. */
+   uint64 mulSmall(uint32 factor) noexcept {
+      uint64 carry = 0;
+      for (unsigned i = 0; i < LIMBS; ++i) {
+         uint64 high;
+         uint64 low = mulWide(m_limbs[i], factor, high);
+         uint64 sumCarry = 0;
+         m_limbs[i] = addCarry(low, carry, sumCarry);
+         carry = high + sumCarry;
+      }
+      return carry;
+   }
+
+   /** Unsigned addition of a 64 bit value, in place; returns the carry out. */
+   uint64 addSmall(uint64 value) noexcept {
+      uint64 carry = 0;
+      m_limbs[0] = addCarry(m_limbs[0], value, carry);
+      for (unsigned i = 1; i < LIMBS; ++i) {
+         m_limbs[i] = addCarry(m_limbs[i], 0, carry);
+      }
+      return carry;
+   }
+
+   /** Unsigned division by a 32 bit divisor, in place; returns the remainder. */
+   uint32 divSmall(uint32 divisor) noexcept {
+      uint64 rem = 0;
+      for (unsigned i = LIMBS; i-- > 0;) {
+         uint64 high = (rem << 32) | (m_limbs[i] >> 32);
+         uint64 qHigh = high / divisor;
+         rem = high % divisor;
+         uint64 low = (rem << 32) | (m_limbs[i] & 0xFFFFFFFF);
+         uint64 qLow = low / divisor;
+         rem = low % divisor;
+         m_limbs[i] = (qHigh << 32) | qLow;
+      }
+      return static_cast<uint32>(rem);
+   }
+};
+
+using Int128 = FixedInt<128>;
+using Int256 = FixedInt<256>;
+
+/**
+ * Batch kernels on arrays of fixed integers.
+ *
+ * Loops have no data-dependent branches, and the limb loops have a
+ * compile time trip count, so the compiler can unroll and vectorize them.
+ */
+template<unsigned _Bits>
+void add(const FixedInt<_Bits>* a, const FixedInt<_Bits>* b, FixedInt<_Bits>* result, size_t count) noexcept {
+   for (size_t i = 0; i < count; ++i) {
+      result[i] = a[i] + b[i];
+   }
+}
+
+template<unsigned _Bits>
+void mul(const FixedInt<_Bits>* a, const FixedInt<_Bits>* b, FixedInt<_Bits>* result, size_t count) noexcept {
+   for (size_t i = 0; i < count; ++i) {
+      result[i] = a[i] * b[i];
+   }
+}
+
+/** Stores in result[i] the outcome of compare(a[i], b[i]). */
+template<unsigned _Bits>
+void compare(const FixedInt<_Bits>* a, const FixedInt<_Bits>* b, int8* result, size_t count) noexcept {
+   for (size_t i = 0; i < count; ++i) {
+      result[i] = static_cast<int8>(compare(a[i], b[i]));
+   }
+}
+
+template<unsigned _Bits>
+FixedInt<_Bits> sum(const FixedInt<_Bits>* values, size_t count) noexcept {
+   FixedInt<_Bits> total;
+   for (size_t i = 0; i < count; ++i) {
+      total += values[i];
+   }
+   return total;
+}
+
+}
+
+#endif /* _FALCON_FIXEDINT_H_ */
+
+/* end of fixedint.h */
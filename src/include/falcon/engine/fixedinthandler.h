@@ -0,0 +1,61 @@
+/*****************************************************************************
+  FALCON - The Falcon Programming Language
+  FILE: fixedinthandler.h
+
+  Handler for fixed width big integer items.
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin : 
+  Touch : 
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+#ifndef _FALCON_FIXEDINTHANDLER_H_
+#define _FALCON_FIXEDINTHANDLER_H_
+
+#include "falcon/engine/fixedint.h"
+#include "falcon/engine/deepflatcopyhandler.h"
+#include "falcon/engine/slaballocator.h"
+
+namespace falcon {
+
+/**
+ * Handler for FixedInt values.
+ *
+ * The value is stored inline in a cell taken from the slab allocator;
+ * unlike BigNum, it never allocates memory on its own.
+ */
+template<unsigned _Bits>
+struct FixedIntHandler final: public DeepFlatCopyHandler<FixedInt<_Bits>, SlabAllocator> {
+  using Base = DeepFlatCopyHandler<FixedInt<_Bits>, SlabAllocator>;
+
+  virtual ~FixedIntHandler() {}
+
+  String typeName() const noexcept override {return "Int" + std::to_string(_Bits);}
+  String toString(ItemData data) const noexcept override { return Base::payload(data).toString(); }
+  void toString(ItemData data, String& out) const noexcept override { Base::payload(data).toString(out); }
+
+  bool toBool(ItemData data) const noexcept override { return ! Base::payload(data).isZero(); }
+  int64 toInt(ItemData data) const noexcept override { return Base::payload(data).toInt64(); }
+
+  size_t hash(ItemData data) const noexcept override {
+    const FixedInt<_Bits>& value = Base::payload(data);
+    size_t result = 0;
+    for (unsigned i = 0; i < FixedInt<_Bits>::LIMBS; ++i) {
+      result = result * 31 + static_cast<size_t>(value.limb(i));
+    }
+    return result;
+  }
+  bool equals(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+    return other == this && Base::payload(data) == Base::payload(otherData);
+  }
+  int compare(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+    return other == this ? Base::compareValues(Base::payload(data), Base::payload(otherData)) : this->compareTypes(other);
+  }
+};
+
+}
+
+#endif
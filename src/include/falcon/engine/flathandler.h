@@ -23,6 +23,7 @@ struct FlatHandler: public Handler {
     virtual ~FlatHandler() {}
 
     ItemData allocate() const override { return ItemData(false); }
+    ItemData copy(ItemData data) const noexcept override { return data; }
     void destroy(ItemData) const noexcept override {}
     
     bool isFlat() const noexcept override{ return true; }
@@ -16,24 +16,33 @@
 #define _FALCON_FLOATHANDLER_H_
 
 #include "falcon/engine/flathandler.h"
-#include <sstream>
+#include "falcon/engine/numformat.h"
 
 namespace falcon {
 
-struct FloatHandler: public FlatHandler {
+struct FloatHandler final: public FlatHandler {
     virtual ~FloatHandler() {}
 
     virtual ItemData allocate() const {return 0.0;}
 
     String typeName() const noexcept override {return "Float";}
     String toString(ItemData data) const noexcept override {
-      std::ostringstream ss;
-      ss << data.numericValue;
-      return ss.str();
+      char buffer[NUMFORMAT_BUFFER_SIZE];
+      return String(buffer, formatFloat(data.numericValue, buffer, buffer + sizeof(buffer)));
     }
+    void toString(ItemData data, String& out) const noexcept override {appendFloat(out, data.numericValue);}
 
     bool toBool(ItemData data) const noexcept override {return data.numericValue != 0.0;}
     int64 toInt(ItemData data) const noexcept override {return static_cast<int64>(data.numericValue);}
+
+    // 0.0 and -0.0 are equal, so they must have the same hash.
+    size_t hash(ItemData data) const noexcept override {return data.numericValue == 0.0 ? 0 : std::hash<numeric>()(data.numericValue);}
+    bool equals(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+      return other == this && data.numericValue == otherData.numericValue;
+    }
+    int compare(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+      return other == this ? compareValues(data.numericValue, otherData.numericValue) : compareTypes(other);
+    }
 };
 
 }
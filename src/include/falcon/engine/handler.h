@@ -16,13 +16,14 @@
 #ifndef _FALCON_HANDLER_H_
 #define _FALCON_HANDLER_H_
 
+#include <functional>
+#include <string_view>
+#include <type_traits>
 #include "falcon/types.h"
 #include "falcon/engine/itemdata.h"
 
 namespace falcon {
 
-class Item;
-
 struct Handler {
     virtual ~Handler() {}
     
@@ -30,12 +31,94 @@ struct Handler {
     virtual bool isCopyFlat() const noexcept = 0;
 
     virtual ItemData allocate() const =0;
+    /**
+     * Returns the data for a copy of an item.
+     *
+     * Flat handlers return the data as is; deep handlers share the payload,
+     * which stays alive until destroy() is called on all the copies.
+     */
+    virtual ItemData copy(ItemData data) const noexcept =0;
     virtual void destroy(ItemData data) const noexcept =0;
 
     virtual String typeName() const noexcept = 0;
     virtual String toString(ItemData data) const noexcept = 0;
+    /**
+     * Appends the representation of the data to out.
+     *
+     * Loops building strings can reuse the same buffer; handlers override
+     * this to format their data without creating temporary strings.
+     */
+    virtual void toString(ItemData data, String& out) const noexcept { out += toString(data); }
     virtual bool toBool(ItemData data) const noexcept = 0;
     virtual int64 toInt(ItemData data) const noexcept = 0;
+
+    /**
+     * Hash of the data, consistent with equals().
+     *
+     * The default implementations of hash(), equals() and compare() treat
+     * the data as a reference: items are equal only if they hold the same
+     * payload. Value types override all of them.
+     */
+    virtual size_t hash(ItemData data) const noexcept { return std::hash<void*>()(data.ptrValue); }
+    /** True if the data of this handler is equal to otherData, held by the other handler. */
+    virtual bool equals(ItemData data, const Handler* other, ItemData otherData) const noexcept {
+        return other == this && data.ptrValue == otherData.ptrValue;
+    }
+    /**
+     * Orders the data of this handler with otherData, held by the other handler.
+     *
+     * Returns a value less than, equal to or greater than zero. Values of the
+     * same type are ordered by value, values of different types by type name.
+     */
+    virtual int compare(ItemData data, const Handler* other, ItemData otherData) const noexcept {
+        if (other != this) {
+            return compareTypes(other);
+        }
+        return std::less<void*>()(data.ptrValue, otherData.ptrValue) ? -1 : (data.ptrValue == otherData.ptrValue ? 0 : 1);
+    }
+    /**
+     * Sets view to the characters of data, if this handles a string type.
+     *
+     * All the string representations are equal when they hold the same
+     * characters. The view is valid as long as data is.
+     */
+    virtual bool stringView(const ItemData&, std::string_view&) const noexcept { return false; }
+
+protected:
+    int compareTypes(const Handler* other) const noexcept {
+        int result = typeName().compare(other->typeName());
+        if (result == 0) {
+            return std::less<const Handler*>()(this, other) ? -1 : 1;
+        }
+        return result;
+    }
+
+    // A total order, as sorting needs: NaN goes after all the numbers, and equals NaN.
+    template<typename _Value>
+    static int compareValues(const _Value& first, const _Value& second) noexcept {
+        if constexpr (std::is_floating_point_v<_Value>) {
+            if (first != first || second != second) {
+                return (first != first) - (second != second);
+            }
+        }
+        return first < second ? -1 : (second < first ? 1 : 0);
+    }
+
+    // Helpers for the handlers of strings.
+    static size_t hashString(std::string_view view) noexcept { return std::hash<std::string_view>()(view); }
+
+    static bool equalsString(std::string_view view, const Handler* other, const ItemData& otherData) noexcept {
+        std::string_view otherView;
+        return other->stringView(otherData, otherView) && view == otherView;
+    }
+
+    int compareString(std::string_view view, const Handler* other, const ItemData& otherData) const noexcept {
+        std::string_view otherView;
+        if (!other->stringView(otherData, otherView)) {
+            return compareTypes(other);
+        }
+        return view.compare(otherView);
+    }
 };
 
 }
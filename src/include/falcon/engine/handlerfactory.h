@@ -21,10 +21,18 @@
 #include "falcon/engine/inthandler.h"
 #include "falcon/engine/floathandler.h"
 #include "falcon/engine/stringhandler.h"
+#include "falcon/engine/shortstringhandler.h"
+#include "falcon/engine/atomhandler.h"
 #include "falcon/engine/bignumhandler.h"
+#include "falcon/engine/fixedinthandler.h"
+#include "falcon/engine/typedarrayhandler.h"
+#include "falcon/engine/dicthandler.h"
 
 namespace falcon {
 
+class PairItem;
+class BoxedItem;
+
 class HandlerFactory {
 public:
     static NilHandler nilHandler;
@@ -32,7 +40,82 @@ public:
     static IntHandler intHandler;
     static FloatHandler floatHandler;
     static StringHandler stringHandler;
+    static ShortStringHandler shortStringHandler;
+    static AtomHandler atomHandler;
     static BigNumHandler bigNumHandler;
+    static FixedIntHandler<128> int128Handler;
+    static FixedIntHandler<256> int256Handler;
+    static TypedArrayHandler<int64> intArrayHandler;
+    static TypedArrayHandler<numeric> floatArrayHandler;
+    static TypedArrayHandler<byte> byteArrayHandler;
+    // Dictionaries hold items, so there is one handler per item layout.
+    static DictHandler<PairItem> pairDictHandler;
+    static DictHandler<BoxedItem> boxedDictHandler;
+
+    /** The handler of TypedArray<_T> items. */
+    template<typename _T>
+    static TypedArrayHandler<_T>* typedArrayHandler() noexcept {
+        if constexpr (std::is_same_v<_T, int64>) {
+            return &intArrayHandler;
+        } else if constexpr (std::is_same_v<_T, numeric>) {
+            return &floatArrayHandler;
+        } else {
+            return &byteArrayHandler;
+        }
+    }
+
+    /** The handler of the deep items with a payload of type _T; null if there is none. */
+    template<typename _T>
+    static const Handler* deepHandler() noexcept {
+        if constexpr (std::is_same_v<_T, String>) {
+            return &stringHandler;
+        } else if constexpr (std::is_same_v<_T, BigNum>) {
+            return &bigNumHandler;
+        } else if constexpr (std::is_same_v<_T, Int128>) {
+            return &int128Handler;
+        } else if constexpr (std::is_same_v<_T, Int256>) {
+            return &int256Handler;
+        } else if constexpr (is_typed_array<_T>::value) {
+            return typedArrayHandler<typename _T::value_type>();
+        } else if constexpr (std::is_same_v<_T, Dict<PairItem>>) {
+            return &pairDictHandler;
+        } else if constexpr (std::is_same_v<_T, Dict<BoxedItem>>) {
+            return &boxedDictHandler;
+        } else {
+            return nullptr;
+        }
+    }
+
+    /**
+     * Invokes func on the concrete handler, bypassing virtual calls for flat types.
+     *
+     * The handler is compared against the flat singletons (most frequent first);
+     * as their classes are final, calls performed by func on them are resolved
+     * statically. Other handlers are passed to func as generic Handler instances.
+     *
+     * @code
+     *   int64 value = HandlerFactory::dispatch(handler, [&](const auto& h) {return h.toInt(data);});
+     * @endcode
+     */
+    template<typename _Func>
+    static decltype(auto) dispatch(const Handler* handler, _Func&& func) {
+        if (handler == &intHandler) {
+            return func(intHandler);
+        }
+        if (handler == &floatHandler) {
+            return func(floatHandler);
+        }
+        if (handler == &shortStringHandler) {
+            return func(shortStringHandler);
+        }
+        if (handler == &boolHandler) {
+            return func(boolHandler);
+        }
+        if (handler == &nilHandler) {
+            return func(nilHandler);
+        }
+        return func(*handler);
+    }
 };
 
 }
@@ -16,24 +16,32 @@
 #define _FALCON_INTHANDLER_H_
 
 #include "falcon/engine/flathandler.h"
-#include <sstream>
+#include "falcon/engine/numformat.h"
 
 namespace falcon {
 
-struct IntHandler: public FlatHandler {
+struct IntHandler final: public FlatHandler {
     virtual ~IntHandler() {}
 
     virtual ItemData allocate() const {return 0LL;}
 
     String typeName() const noexcept override {return "Int";}
     String toString(ItemData data) const noexcept override {
-      std::ostringstream ss;
-      ss << data.int64Value;
-      return ss.str();
+      char buffer[NUMFORMAT_BUFFER_SIZE];
+      return String(buffer, formatInt(data.int64Value, buffer, buffer + sizeof(buffer)));
     }
+    void toString(ItemData data, String& out) const noexcept override {appendInt(out, data.int64Value);}
 
     bool toBool(ItemData data) const noexcept override {return data.int64Value != 0;}
     int64 toInt(ItemData data) const noexcept override {return data.int64Value;}
+
+    size_t hash(ItemData data) const noexcept override {return static_cast<size_t>(data.uint64Value);}
+    bool equals(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+      return other == this && data.int64Value == otherData.int64Value;
+    }
+    int compare(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+      return other == this ? compareValues(data.int64Value, otherData.int64Value) : compareTypes(other);
+    }
 };
 
 }
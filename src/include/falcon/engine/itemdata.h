@@ -26,6 +26,7 @@ union ItemData {
     uint64 uint64Value;
     numeric numericValue;
     void* ptrValue;
+    char shortString[sizeof(uint64)];
 
     template<typename T>
     ItemData(const T& value) {
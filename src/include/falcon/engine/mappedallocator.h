@@ -0,0 +1,149 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: mappedallocator.h
+
+  Page allocator backed by a reserved virtual memory range
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_MAPPEDALLOCATOR_H_
+#define _FALCON_MAPPEDALLOCATOR_H_
+
+#include <falcon/setup.h>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace falcon {
+
+/**
+ * Range of virtual memory reserved up front, and handed out in blocks.
+ *
+ * The whole range is reserved when the arena is created, but the blocks
+ * are made accessible only when allocated, and the system backs them with
+ * physical memory only when they are first written. Released blocks are
+ * given back to the system (MADV_DONTNEED), and their addresses are reused
+ * for the next allocations of the same size.
+ *
+ * With huge pages, the range is aligned to HUGE_PAGE_SIZE and marked for
+ * transparent huge pages (MADV_HUGEPAGE), reducing the TLB misses when
+ * walking large structures.
+ *
+ * When the range is exhausted, blocks are mapped separately from the
+ * system. On systems without mmap, the arena uses the global heap.
+ *
+ * The arena is thread safe.
+ */
+class FALCON_API_ MappedArena
+{
+public:
+   static constexpr size_t HUGE_PAGE_SIZE = size_t(2) * 1024 * 1024;
+   static constexpr size_t DEFAULT_RESERVE = size_t(1) << 30;
+
+   /**
+    * Creates the arena, reserving reserve bytes of address space.
+    *
+    * @throw std::bad_alloc if the range can't be reserved.
+    */
+   explicit MappedArena(size_t reserve = DEFAULT_RESERVE, bool hugePages = false);
+   MappedArena(const MappedArena&) = delete;
+   MappedArena& operator=(const MappedArena&) = delete;
+   ~MappedArena();
+
+   /** Returns a block of at least size bytes, aligned to the system page. */
+   void* allocate(size_t size);
+   void deallocate(void* block, size_t size) noexcept;
+
+   /** Bytes of the reserved range. */
+   size_t reservedBytes() const noexcept { return m_reserve; }
+   /** Bytes currently allocated, including those mapped outside the range. */
+   size_t allocatedBytes() const noexcept;
+   bool hugePages() const noexcept { return m_hugePages; }
+
+   /** Size of the pages of the system. */
+   static size_t pageSize() noexcept;
+
+private:
+   mutable std::mutex m_mtx;
+   char* m_base{nullptr};
+   size_t m_reserve{0};
+   // Unused part of the range starts here.
+   size_t m_top{0};
+   size_t m_allocated{0};
+   bool m_hugePages{false};
+   // Released blocks below m_top.
+   std::vector<std::pair<char*, size_t>> m_free;
+
+   size_t roundSize(size_t size) const noexcept;
+   bool inRange(const char* block) const noexcept { return block >= m_base && block < m_base + m_reserve; }
+};
+
+
+/**
+ * Allocator taking the blocks of at least a system page from a MappedArena.
+ *
+ * Meant as the _Allocator parameter of PagedStack, for very deep stacks:
+ * the pages of the stack are taken from the arena, while smaller requests
+ * (as the page directory of small stacks) go to std::allocator.
+ *
+ * Copies of the allocator, and its rebinds, share the same arena. A default
+ * constructed allocator creates a new arena with the default reserve.
+ */
+template<typename _T>
+class MappedAllocator
+{
+public:
+   using value_type = _T;
+   using size_type = std::size_t;
+   using propagate_on_container_copy_assignment = std::true_type;
+   using propagate_on_container_move_assignment = std::true_type;
+   using propagate_on_container_swap = std::true_type;
+
+   template <class U> struct rebind { typedef MappedAllocator<U> other; };
+
+   MappedAllocator(): m_arena(std::make_shared<MappedArena>()) {}
+   explicit MappedAllocator(std::shared_ptr<MappedArena> arena) noexcept: m_arena(std::move(arena)) {}
+   template <typename U>
+   MappedAllocator(const MappedAllocator<U>& other) noexcept: m_arena(other.arena()) {}
+
+   _T* allocate(std::size_t size)
+   {
+      if(size * sizeof(_T) < MappedArena::pageSize()) {
+         return std::allocator<_T>().allocate(size);
+      }
+      return static_cast<_T*>(m_arena->allocate(size * sizeof(_T)));
+   }
+
+   void deallocate(_T* data, std::size_t size) noexcept
+   {
+      if(size * sizeof(_T) < MappedArena::pageSize()) {
+         std::allocator<_T>().deallocate(data, size);
+         return;
+      }
+      m_arena->deallocate(data, size * sizeof(_T));
+   }
+
+   const std::shared_ptr<MappedArena>& arena() const noexcept { return m_arena; }
+
+   template<typename U>
+   bool operator==(const MappedAllocator<U>& other) const noexcept { return m_arena == other.arena(); }
+   template<typename U>
+   bool operator!=(const MappedAllocator<U>& other) const noexcept { return m_arena != other.arena(); }
+
+private:
+   std::shared_ptr<MappedArena> m_arena;
+};
+
+}
+
+#endif /* _FALCON_MAPPEDALLOCATOR_H_ */
+
+/* end of mappedallocator.h */
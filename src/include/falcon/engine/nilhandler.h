@@ -19,15 +19,20 @@
 
 namespace falcon {
 
-struct NilHandler: public FlatHandler {
+struct NilHandler final: public FlatHandler {
     virtual ~NilHandler() {}
 
     virtual ItemData allocate() const {return 0;}
 
     String typeName() const noexcept override {return "Nil";}
     String toString(ItemData) const noexcept override {return "nil";}
+    void toString(ItemData, String& out) const noexcept override {out += "nil";}
     bool toBool(ItemData) const noexcept override {return false;}
     int64 toInt(ItemData data) const noexcept override {return 0;}
+
+    size_t hash(ItemData) const noexcept override {return 0;}
+    bool equals(ItemData, const Handler* other, ItemData) const noexcept override {return other == this;}
+    int compare(ItemData, const Handler* other, ItemData) const noexcept override {return other == this ? 0 : compareTypes(other);}
 };
 
 }
@@ -0,0 +1,63 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: numformat.h
+
+  Locale independent, allocation free formatting of numbers
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_NUMFORMAT_H_
+#define _FALCON_NUMFORMAT_H_
+
+#include <charconv>
+#include "falcon/types.h"
+
+namespace falcon {
+
+enum {
+   /** Size of a buffer large enough for any number formatted here. */
+   NUMFORMAT_BUFFER_SIZE = 32
+};
+
+/**
+ * Writes the decimal representation of value in [first, last).
+ *
+ * Returns the end of the written characters; the buffer must be at
+ * least NUMFORMAT_BUFFER_SIZE bytes long. No terminating zero is added.
+ */
+inline char* formatInt(int64 value, char* first, char* last) noexcept {
+   return std::to_chars(first, last, value).ptr;
+}
+
+/**
+ * Writes the shortest representation of value that reads back to the same double.
+ *
+ * Returns the end of the written characters; the buffer must be at
+ * least NUMFORMAT_BUFFER_SIZE bytes long. No terminating zero is added.
+ */
+inline char* formatFloat(numeric value, char* first, char* last) noexcept {
+   return std::to_chars(first, last, value).ptr;
+}
+
+inline void appendInt(String& out, int64 value) {
+   char buffer[NUMFORMAT_BUFFER_SIZE];
+   out.append(buffer, formatInt(value, buffer, buffer + sizeof(buffer)));
+}
+
+inline void appendFloat(String& out, numeric value) {
+   char buffer[NUMFORMAT_BUFFER_SIZE];
+   out.append(buffer, formatFloat(value, buffer, buffer + sizeof(buffer)));
+}
+
+}
+
+#endif /* _FALCON_NUMFORMAT_H_ */
+
+/* end of numformat.h */
@@ -13,11 +13,19 @@
   Released under Apache 2.0 License.
  ******************************************************************************/
 #include <vector>
-#include <list>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <memory>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
 #include <falcon/engine/distribute.h>
+#include <falcon/engine/stackgrowth.h>
+#include <falcon/engine/stackstats.h>
 #include <mutex>
 
 #ifndef _FALCON_PAGEDSTACK_H_
@@ -27,6 +35,16 @@ namespace falcon {
 /**
  * Stack-like structure indefinitely growable.
  *
+ * The whole structure is protected by _Mutex. With spsc_mutex, the stack
+ * is used by a single thread, and another thread can read it without
+ * locking through observe() and snapshot().
+ *
+ * _Stats is the instrumentation policy: no_stack_stats records nothing,
+ * stack_counters records the counters reported by stats().
+ *
+ * _Growth is the growth policy (see stackgrowth.h), deciding how many pages
+ * are added when the stack is full, and how many spare pages are kept when
+ * it gets lower.
  */
 
 namespace{
@@ -37,8 +55,22 @@ public:
 };
 }
 
+/**
+ * Single producer, single consumer mode of PagedStack.
+ *
+ * Used as the _Mutex parameter, it declares that the stack is modified
+ * by one thread only, without locking, while at most one other thread
+ * reads it through PagedStack::observe() or PagedStack::snapshot().
+ */
+class spsc_mutex {
+public:
+	void lock() const volatile noexcept {};
+	void unlock() const volatile noexcept {};
+};
+
 template<typename _T,
-	template<typename> typename _Allocator=std::allocator, typename _Mutex=dummy_mutex>
+	template<typename> typename _Allocator=std::allocator, typename _Mutex=dummy_mutex,
+	typename _Stats=no_stack_stats, typename _Growth=fixed_growth>
 class PagedStack
 {
 public:
@@ -53,115 +85,513 @@ public:
    using allocator_type = _Allocator<_T>;
 private:
 
-   using page_type = std::vector<_T, allocator_type>;
-   using page_allocator_type = typename allocator_type::template rebind<page_type>::other;
-   using base_type = std::list<page_type, page_allocator_type>;
+   using allocator_traits = std::allocator_traits<allocator_type>;
+   // Pages are raw buffers of m_pageSize elements; the directory lists them
+   // from the bottom of the stack, so reaching any page is an indexed load.
+   using directory_type = std::vector<_T*, typename allocator_traits::template rebind_alloc<_T*>>;
    size_t m_pageSize{DEFAULT_PAGE_SIZE};
    size_t m_allocSize{DEFAULT_BASE_SIZE};
-   base_type m_base;
-   typename base_type::iterator m_curBase;
    allocator_type m_dataAllocator;
+   directory_type m_pages;
+   size_t m_curPage{0};
+   // Elements in the current page.
+   size_t m_curSize{0};
+   // All the pages below the current one are full, so the position
+   // of each element can be computed from the count.
+   size_t m_count{0};
    mutable _Mutex m_mutex;
    mutable int m_syncIterCount{0};
-   mutable bool m_shrinkRequest{false};
+   mutable _Stats m_stats;
+   _Growth m_growth;
+
+   // Pages removed by shrink_to_fit(), and the epoch in which they were
+   // removed; they are freed outside the lock, when nothing can see them.
+   using quarantine_type = std::vector<std::pair<uint64_t, _T*>>;
+   quarantine_type m_quarantine;
+   bool m_deferReclaim{false};
+
+   /*
+    * Pages shared with forked stacks, one entry per page (null if the page
+    * is owned by this stack alone). Shared pages are full and read only;
+    * the last stack releasing one destroys its elements.
+    */
+   struct page_share {
+      std::atomic<size_t> m_refs{1};
+   };
+   std::vector<page_share*> m_shares;
+   // Entries of m_shares that are not null; read without the lock by the mutable iterators.
+   std::atomic<size_t> m_sharedPages{0};
+   // Thread holding the lock through a PagedStack::lock_guard, if any.
+   mutable std::atomic<std::thread::id> m_guardOwner{};
+
+   static constexpr bool SPSC = std::is_same<_Mutex, spsc_mutex>::value;
+
+   /*
+    * State shared with the observer in SPSC mode.
+    *
+    * Before changing or destroying an element, the owner lowers the low
+    * water mark to its position; the observer resets the mark before
+    * reading, and the elements below the mark at the end were not touched.
+    *
+    * The observer announces the epoch in which it's reading; directories
+    * and quarantined pages are freed only when no reader from an earlier
+    * epoch can still see them.
+    */
+   struct spsc_state {
+      std::atomic<size_t> m_count{0};
+      std::atomic<_T* const*> m_pages{nullptr};
+      std::atomic<size_t> m_lowWater{SIZE_MAX};
+      std::atomic<uint64_t> m_epoch{1};
+      std::atomic<uint64_t> m_readerEpoch{0};
+      std::vector<std::pair<uint64_t, directory_type>> m_retiredDirectories;
+   };
+   struct no_spsc_state {};
+   mutable typename std::conditional<SPSC, spsc_state, no_spsc_state>::type m_spsc;
 
 
    void growBase() {
-      size_t count = m_allocSize;
-      while(count) {
-         m_base.emplace_back(m_dataAllocator);
-         m_base.back().reserve(m_pageSize);
-         --count;
+      auto start = m_stats.now();
+      size_t added = m_growth.grow(m_pages.size(), m_allocSize);
+      size_t needed = m_pages.size() + added;
+      if constexpr (SPSC) {
+         if(needed > m_pages.capacity()) {
+            // the observer might be reading the old directory.
+            directory_type fresh(m_pages.get_allocator());
+            fresh.reserve(std::max(needed, 2 * m_pages.capacity()));
+            fresh.assign(m_pages.begin(), m_pages.end());
+            m_pages.swap(fresh);
+            m_spsc.m_pages.store(m_pages.data());
+            if(fresh.capacity() > 0) {
+               m_spsc.m_retiredDirectories.emplace_back(m_spsc.m_epoch.fetch_add(1), std::move(fresh));
+            }
+            reclaim_directories();
+         }
+      }
+      else {
+         m_pages.reserve(needed);
+      }
+      m_shares.reserve(needed);
+      for(size_t count = 0; count < added; ++count) {
+         m_pages.push_back(take_page());
+         m_shares.push_back(nullptr);
+      }
+      m_stats.grown(start);
+      m_stats.pages(m_pages.size());
+   }
+
+   _T* take_page() {
+      // Pages in quarantine are beyond the top, where no one reads.
+      if(!m_quarantine.empty()) {
+         _T* page = m_quarantine.back().second;
+         m_quarantine.pop_back();
+         m_stats.taken(true);
+         return page;
+      }
+      _T* page = allocator_traits::allocate(m_dataAllocator, m_pageSize);
+      m_stats.taken(false);
+      return page;
+   }
+
+   /** Pages released while shared are replaced when the stack reaches them again. */
+   void ensure_page(size_t page) {
+      if(m_pages[page] == nullptr) {
+         m_pages[page] = take_page();
+      }
+   }
+
+   /** Drops the reference to a shared page; returns true if it was the last one. */
+   bool release_share(size_t page) noexcept {
+      page_share* share = m_shares[page];
+      m_shares[page] = nullptr;
+      --m_sharedPages;
+      if(share->m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+         delete share;
+         return true;
+      }
+      return false;
+   }
+
+   void destroy_elements(_T* page, size_t from, size_t to) noexcept {
+      for(size_t pos = from; pos < to; ++pos) {
+         allocator_traits::destroy(m_dataAllocator, page + pos);
       }
    }
 
-   void advance() {
-      if (m_curBase->size() == m_pageSize) {
-         ++m_curBase;
-         if(m_curBase == m_base.end()) {
-            m_curBase--;
+   /**
+    * Makes a shared page private, keeping its first keep elements.
+    *
+    * If other stacks still use the page, the kept elements are copied to a
+    * page of this stack (none is taken when nothing is kept); otherwise, the
+    * page is taken over, and the elements from keep up are destroyed.
+    */
+   void unshare_page(size_t page, size_t keep) {
+      damage(page * m_pageSize + keep);
+      _T* data = m_pages[page];
+      if(m_shares[page]->m_refs.load(std::memory_order_acquire) == 1) {
+         release_share(page);
+         destroy_elements(data, keep, m_pageSize);
+         return;
+      }
+
+      _T* copy = nullptr;
+      if(keep > 0) {
+         copy = take_page();
+         size_t done = 0;
+         try {
+            for(; done < keep; ++done) {
+               allocator_traits::construct(m_dataAllocator, copy + done, data[done]);
+            }
+         }
+         catch(...) {
+            destroy_elements(copy, 0, done);
+            allocator_traits::deallocate(m_dataAllocator, copy, m_pageSize);
+            throw;
+         }
+         m_stats.copied();
+      }
+      m_pages[page] = copy;
+      if(release_share(page)) {
+         // the other stacks released it meanwhile.
+         damage(page * m_pageSize);
+         destroy_elements(data, 0, m_pageSize);
+         if(copy == nullptr) {
+            m_pages[page] = data;
+         }
+         else {
+            retire_page(data);
+         }
+      }
+   }
+
+   /**
+    * Makes private the shared pages holding the elements from pos up, before
+    * write access to them is given out. Called under the lock.
+    */
+   void unshare_from(size_t pos) {
+      for(size_t page = pos / m_pageSize; m_sharedPages > 0 && page < m_shares.size(); ++page) {
+         if(m_shares[page] != nullptr) {
+            // shared pages are full.
+            unshare_page(page, m_pageSize);
+         }
+      }
+   }
+
+   /**
+    * Makes all the shared pages private, for the mutable iterators.
+    *
+    * Takes no lock when nothing is shared, or when the calling thread
+    * already holds it through a lock_guard.
+    */
+   void unshare_all() {
+      if(m_sharedPages.load(std::memory_order_relaxed) == 0) {
+         return;
+      }
+      std::unique_lock<_Mutex> guard(m_mutex, std::defer_lock);
+      if(m_guardOwner.load(std::memory_order_relaxed) != std::this_thread::get_id()) {
+         guard.lock();
+      }
+      unshare_from(0);
+   }
+
+   /** Puts a page in quarantine, tagged with the current epoch in SPSC mode. */
+   void retire_page(_T* page) {
+      uint64_t epoch = 0;
+      if constexpr (SPSC) {
+         epoch = m_spsc.m_epoch.fetch_add(1);
+      }
+      m_quarantine.emplace_back(epoch, page);
+   }
+
+   /** Frees the directories retired before the epoch of the observer (SPSC mode). */
+   void reclaim_directories() noexcept {
+      uint64_t reader = m_spsc.m_readerEpoch.load();
+      auto& dirs = m_spsc.m_retiredDirectories;
+      dirs.erase(std::remove_if(dirs.begin(), dirs.end(),
+            [reader](const std::pair<uint64_t, directory_type>& entry) { return reader == 0 || reader > entry.first; }),
+            dirs.end());
+   }
+
+   /**
+    * Moves the quarantined pages that nothing can see anymore to pages.
+    *
+    * Called under the lock; the pages are then freed outside it.
+    */
+   void take_reclaimable(quarantine_type& pages) {
+      if(m_syncIterCount > 0) {
+         return;
+      }
+      if constexpr (SPSC) {
+         uint64_t reader = m_spsc.m_readerEpoch.load();
+         auto end = std::partition(m_quarantine.begin(), m_quarantine.end(),
+               [reader](const std::pair<uint64_t, _T*>& entry) { return reader != 0 && reader <= entry.first; });
+         pages.insert(pages.end(), end, m_quarantine.end());
+         m_quarantine.erase(end, m_quarantine.end());
+         reclaim_directories();
+      }
+      else {
+         pages.insert(pages.end(), m_quarantine.begin(), m_quarantine.end());
+         m_quarantine.clear();
+      }
+   }
+
+   void free_pages(const quarantine_type& pages) noexcept {
+      for(const auto& entry: pages) {
+         allocator_traits::deallocate(m_dataAllocator, entry.second, m_pageSize);
+      }
+   }
+
+   /** Makes the element count visible to the observer (SPSC mode). */
+   void publish(size_t count) noexcept {
+      if constexpr (SPSC) {
+         m_spsc.m_count.store(count, std::memory_order_release);
+      }
+   }
+
+   /** Declares that the elements from pos up are about to change (SPSC mode). */
+   void damage(size_t pos) noexcept {
+      if constexpr (SPSC) {
+         // Always a read-modify-write, ordering it with the reset of the observer.
+         size_t mark = m_spsc.m_lowWater.load(std::memory_order_relaxed);
+         while(!m_spsc.m_lowWater.compare_exchange_weak(mark, std::min(mark, pos))) {}
+         std::atomic_thread_fence(std::memory_order_release);
+      }
+   }
+
+   _T& element(ptrdiff_t pos) noexcept { return m_pages[pos / m_pageSize][pos % m_pageSize]; }
+   const _T& element(ptrdiff_t pos) const noexcept { return m_pages[pos / m_pageSize][pos % m_pageSize]; }
+
+   _T& internal_top() noexcept { return m_pages[m_curPage][m_curSize - 1]; }
+   const _T& internal_top() const noexcept { return m_pages[m_curPage][m_curSize - 1]; }
+
+   /** Where the next element goes; the stack is updated by commit_push(). */
+   _T* next_slot() {
+      if (m_curSize == m_pageSize) {
+         if(m_curPage + 1 == m_pages.size()) {
             growBase();
-            m_curBase++;
          }
+         ensure_page(m_curPage + 1);
+         return m_pages[m_curPage + 1];
+      }
+      if(m_curSize == 0) {
+         ensure_page(m_curPage);
+      }
+      return m_pages[m_curPage] + m_curSize;
+   }
+
+   void commit_push() noexcept {
+      if (m_curSize == m_pageSize) {
+         ++m_curPage;
+         m_curSize = 0;
       }
+      ++m_curSize;
+      ++m_count;
+      publish(m_count);
+   }
+
+   template<typename... _Args>
+   void internal_emplace(_Args&&... __args) {
+      allocator_traits::construct(m_dataAllocator, next_slot(), std::forward<_Args>(__args)...);
+      commit_push();
    }
 
    template<typename... _Args>
    void internal_pop(_T& value, _Args&&... __args) {
-      value = m_curBase->back();
+      value = internal_top();
       internal_pop_one();
       internal_pop(std::forward<_Args>(__args)...);
    }
 
    void internal_pop_one() {
-      m_curBase->pop_back();
-      if(m_curBase->empty() && m_curBase != m_base.begin()) {
-         --m_curBase;
+      bool shared = m_shares[m_curPage] != nullptr;
+      if(shared) {
+         // the other stacks keep the element.
+         unshare_page(m_curPage, m_curSize - 1);
+      }
+      publish(m_count - 1);
+      if(!shared) {
+         damage(m_count - 1);
+         allocator_traits::destroy(m_dataAllocator, &internal_top());
+      }
+      --m_count;
+      if(--m_curSize == 0 && m_curPage > 0) {
+         --m_curPage;
+         m_curSize = m_pageSize;
       }
    }
 
    void internal_pop() {}
 
-   template<typename _IBase, typename _IData>
-   void internal_discard(_IBase iBase, _IData iData)
+   /** Removes the elements from position count up. */
+   void internal_discard(size_t count)
    {
-      while(m_curBase != iBase) {
-         m_curBase->clear();
-         --m_curBase;
+      if(m_count > count) {
+         publish(count);
+         damage(count);
       }
-      if(iData == m_curBase->begin())
-      {
-         if (m_curBase != m_base.begin())
-         {
-            m_curBase--;
+      while(m_count > count) {
+         size_t keep = count > m_curPage * m_pageSize ? count - m_curPage * m_pageSize : 0;
+         if(m_shares[m_curPage] != nullptr) {
+            unshare_page(m_curPage, keep);
          }
          else {
-            m_curBase->clear();
+            destroy_elements(m_pages[m_curPage], keep, m_curSize);
+         }
+         m_count -= m_curSize - keep;
+         m_curSize = keep;
+         if(m_curSize == 0 && m_curPage > 0) {
+            --m_curPage;
+            m_curSize = m_pageSize;
          }
-      }
-      else {
-         m_curBase->resize(iData - m_curBase->begin());
       }
    }
 
    void internal_push(const _T& data) {
-      advance();
-      m_curBase->push_back(data);
+      internal_emplace(data);
    }
 
    template<typename... _Args>
    void internal_push(const _T& data, _Args&&... __args) {
-      advance();
-      m_curBase->push_back(data);
+      internal_push(data);
       internal_push(std::forward<_Args>(__args)...);
    }
 
-   void internal_shrink_to_fit() {
-        typename base_type::iterator iter = m_curBase;
-        ++iter;
-        // TODO: It would be nice to disengage the condemned elements and unlock.
-        while(iter != m_base.end()) {
-           iter = m_base.erase(iter);
+   /** Moves to the next page if the current one is full. */
+   void open_page() {
+      if (m_curSize == m_pageSize) {
+         if(m_curPage + 1 == m_pages.size()) {
+            growBase();
+         }
+         ensure_page(m_curPage + 1);
+         ++m_curPage;
+         m_curSize = 0;
+      }
+      else if(m_curSize == 0) {
+         ensure_page(m_curPage);
+      }
+   }
+
+   /** Undoes open_page() when nothing could be written in the new page. */
+   void close_empty_page() noexcept {
+      if(m_curSize == 0 && m_curPage > 0) {
+         --m_curPage;
+         m_curSize = m_pageSize;
+      }
+   }
+
+   template<typename _It>
+   void internal_push_range(_It first, size_t count) {
+      while(count > 0) {
+         open_page();
+         size_t chunk = std::min(count, m_pageSize - m_curSize);
+         _T* dest = m_pages[m_curPage] + m_curSize;
+         if constexpr (std::is_trivially_copyable<_T>::value && std::is_pointer<_It>::value
+                  && std::is_same<typename std::remove_cv<typename std::remove_pointer<_It>::type>::type, _T>::value) {
+            std::memcpy(dest, first, chunk * sizeof(_T));
+            first += chunk;
+         }
+         else {
+            size_t done = 0;
+            try {
+               for(; done < chunk; ++done, ++first) {
+                  allocator_traits::construct(m_dataAllocator, dest + done, *first);
+               }
+            }
+            catch(...) {
+               // keep what was pushed so far.
+               m_curSize += done;
+               m_count += done;
+               publish(m_count);
+               close_empty_page();
+               throw;
+            }
+         }
+         m_curSize += chunk;
+         m_count += chunk;
+         count -= chunk;
+         publish(m_count);
+      }
+   }
+
+   template<typename _OutIt>
+   _OutIt internal_copy_range(size_t from, _OutIt out) const {
+      while(from < m_count) {
+         size_t page = from / m_pageSize;
+         size_t offset = from % m_pageSize;
+         size_t chunk = std::min(m_count - from, m_pageSize - offset);
+         const _T* src = m_pages[page] + offset;
+         if constexpr (std::is_trivially_copyable<_T>::value && std::is_pointer<_OutIt>::value
+                  && std::is_same<typename std::remove_cv<typename std::remove_pointer<_OutIt>::type>::type, _T>::value) {
+            std::memcpy(out, src, chunk * sizeof(_T));
+            out += chunk;
+         }
+         else {
+            out = std::copy(src, src + chunk, out);
+         }
+         from += chunk;
+      }
+      return out;
+   }
+
+   /** Puts the pages from keep up in quarantine. */
+   void internal_shrink_to(size_t keep) {
+        size_t pages = m_pages.size();
+        while(m_pages.size() > keep) {
+           // pages above the top are never shared.
+           if(m_pages.back() != nullptr) {
+              retire_page(m_pages.back());
+           }
+           m_pages.pop_back();
+           m_shares.pop_back();
         }
+        if(pages > m_pages.size()) {
+           m_stats.shrunk(pages - m_pages.size());
+        }
+   }
+
+   void internal_shrink_to_fit() {
+      internal_shrink_to(m_curPage + 1);
+   }
+
+   /** Gives back the spare pages the growth policy doesn't keep; see shrink_to_fit(). */
+   void internal_trim(quarantine_type& condemned) {
+      if constexpr (_Growth::TRIMS) {
+         size_t used = m_curPage + 1;
+         size_t keep = std::max(used, m_growth.trim(used, m_pages.size(), m_allocSize));
+         if(keep < m_pages.size()) {
+            internal_shrink_to(keep);
+            if(!m_deferReclaim) {
+               take_reclaimable(condemned);
+            }
+         }
+      }
    }
 
    void removeSyncIterator() const noexcept {
-      std::lock_guard<_Mutex> guard(m_mutex);
-      if(--m_syncIterCount == 0 && m_shrinkRequest) {
-         m_shrinkRequest = false;
-         const_cast<PagedStack*>(this)->internal_shrink_to_fit();
+      PagedStack* self = const_cast<PagedStack*>(this);
+      quarantine_type condemned;
+      {
+         std::lock_guard<_Mutex> guard(m_mutex);
+         if(--m_syncIterCount == 0 && !m_deferReclaim) {
+            self->take_reclaimable(condemned);
+         }
       }
+      self->free_pages(condemned);
    }
 
-   template<typename _TT, typename _IBase, typename _IData>
+   /*
+    * Iterators refer to the position of the element from the bottom of
+    * the stack, so that moving them by any amount is a constant time
+    * operation. The end of the top-to-bottom iterators is position -1.
+    */
+
+   template<typename _TT, typename _Owner>
    class reverse_iterator_base {
    public:
-      _TT& operator*() noexcept { return *m_iData; }
-      const _TT& operator*() const noexcept { return *m_iData; }
-      _TT* operator->() const noexcept { return &(*m_iData); }
+      _TT& operator*() const noexcept { return m_owner->element(m_pos); }
+      _TT* operator->() const noexcept { return &m_owner->element(m_pos); }
 
       bool operator ==(const reverse_iterator_base& other) const noexcept {
-         return m_iBase == other.m_iBase && m_iData == other.m_iData;
+         return m_pos == other.m_pos;
       }
 
       bool operator !=(const reverse_iterator_base& other) const noexcept {
@@ -169,12 +599,12 @@ private:
       }
 
       const reverse_iterator_base& operator+=(size_t size) noexcept {
-         for(size_t i=0; i < size; ++i) {++ *this;}
+         m_pos += size;
          return *this;
       }
 
       const reverse_iterator_base& operator-=(size_t size) noexcept {
-         for(size_t i=0; i < size; ++i) {-- *this;}
+         m_pos -= size;
          return *this;
       }
 
@@ -190,51 +620,37 @@ private:
          return current;
       }
 
-
       const reverse_iterator_base& operator--() noexcept {
-         if(m_iData == m_iBase->begin()) {
-            --m_iBase;
-            m_iData = m_iBase->end();
-         }
-         --m_iData;
+         --m_pos;
          return *this;
       }
 
       const reverse_iterator_base& operator++() noexcept {
-         ++m_iData;
-         if(m_iData == m_iBase->end() && m_iBase != m_iBaseEnd) {
-            ++m_iBase;
-            m_iData = m_iBase->begin();
-         }
+         ++m_pos;
          return *this;
       }
 
    private:
-      reverse_iterator_base(const _IBase& iBase,
-            const _IData& iData,
-            const _IBase& end) noexcept:
-            m_iBase(iBase),
-            m_iData(iData),
-            m_iBaseEnd(end)
+      reverse_iterator_base(_Owner* owner, ptrdiff_t pos) noexcept:
+            m_owner(owner),
+            m_pos(pos)
       {}
 
-      _IBase m_iBase;
-      _IData m_iData;
-      _IBase m_iBaseEnd;
+      _Owner* m_owner;
+      ptrdiff_t m_pos;
 
       friend class PagedStack;
    };
 
-   template<typename _TT, typename _IBase, typename _IData>
+   template<typename _TT, typename _Owner>
    class iterator_base {
    public:
 
-      _TT& operator*() noexcept { return *m_iData; }
-      const _TT& operator*() const noexcept { return *m_iData; }
-      _TT* operator->() const noexcept { return &(*m_iData); }
+      _TT& operator*() const noexcept { return m_owner->element(m_pos); }
+      _TT* operator->() const noexcept { return &m_owner->element(m_pos); }
 
       bool operator ==(const iterator_base& other) const noexcept {
-         return m_iBase == other.m_iBase && m_iData == other.m_iData;
+         return m_pos == other.m_pos;
       }
 
       bool operator !=(const iterator_base& other) const noexcept {
@@ -242,12 +658,12 @@ private:
       }
 
       const iterator_base& operator+=(size_t size) noexcept {
-         for(size_t i=0; i < size; ++i) {++ *this;}
+         m_pos -= size;
          return *this;
       }
 
       const iterator_base& operator-=(size_t size) noexcept {
-         for(size_t i=0; i < size; ++i) {-- *this;}
+         m_pos += size;
          return *this;
       }
 
@@ -264,54 +680,42 @@ private:
       }
 
       const iterator_base& operator++() noexcept {
-         if(m_iData == m_iBase->begin() && m_iBase != m_iBaseBegin) {
-            --m_iBase;
-            m_iData = m_iBase->end();
-         }
-         --m_iData;
+         --m_pos;
          return *this;
       }
 
       const iterator_base& operator--() noexcept {
-         ++m_iData;
-         if(m_iData == m_iBase->end()) {
-            ++m_iBase;
-            m_iData = m_iBase->begin();
-         }
+         ++m_pos;
          return *this;
       }
    private:
 
-      iterator_base(const _IBase& iBase,
-            const _IData& iData,
-            const _IBase& end) noexcept:
-            m_iBase(iBase),
-            m_iData(iData),
-            m_iBaseBegin(end)
+      iterator_base(_Owner* owner, ptrdiff_t pos) noexcept:
+            m_owner(owner),
+            m_pos(pos)
       {}
 
-      _IBase m_iBase;
-      _IData m_iData;
-      _IBase m_iBaseBegin;
+      _Owner* m_owner;
+      ptrdiff_t m_pos;
       friend class PagedStack;
    };
 
    /**
     * A special iterator to access the structure synchronously.
     */
-   template<typename _TT, typename _IBase, typename _IData>
+   template<typename _TT>
    class sync_iterator_base {
    public:
 
       void get(_TT& value) {
          PagedStack::lock_guard guard(m_owner);
          synchronize();
-         value = *m_iData;
+         value = m_owner->element(m_pos);
       }
 
       bool operator ==(const sync_iterator_base& other) const noexcept {
          PagedStack::lock_guard guard(m_owner);
-         return m_iBase == other.m_iBase && m_iData == other.m_iData;
+         return m_pos == other.m_pos;
       }
 
       bool operator !=(const sync_iterator_base& other) const noexcept {
@@ -321,11 +725,7 @@ private:
       const sync_iterator_base& operator++()  {
          PagedStack::lock_guard guard(m_owner);
          if (synchronize()){
-            if(m_iData == m_iBase->begin() && m_iBase != m_iBaseBegin) {
-               --m_iBase;
-               m_iData = m_iBase->end();
-            }
-            --m_iData;
+            --m_pos;
          }
          return *this;
       }
@@ -333,11 +733,7 @@ private:
       const sync_iterator_base& operator--() {
          PagedStack::lock_guard guard(m_owner);
          if (synchronize()){
-            ++m_iData;
-            if(m_iData == m_iBase->end()) {
-               ++m_iBase;
-               m_iData = m_iBase->begin();
-            }
+            ++m_pos;
          }
          return *this;
       }
@@ -347,55 +743,35 @@ private:
       }
    private:
 
-      sync_iterator_base(PagedStack const* owner,
-            const _IBase& iBase,
-            const _IData& iData,
-            const _IBase& end) noexcept:
-            m_iBase(iBase),
-            m_iData(iData),
-            m_iBaseBegin(end),
-            m_owner(owner)
+      sync_iterator_base(PagedStack const* owner, ptrdiff_t pos) noexcept:
+            m_owner(owner),
+            m_pos(pos)
       {
          // the owner will create us in a locked space.
          owner->m_syncIterCount++;
       }
 
       bool synchronize() {
-         // are we fully synchronised?
-         if(m_owner->m_curBase == m_iBase) {
-            if (m_iBase->size() > m_iData - m_iBase->begin())
-            {
-               return true;
-            }
+         // we are in sync as long as the top is above us.
+         if(m_pos < static_cast<ptrdiff_t>(m_owner->m_count)) {
+            return true;
          }
-         else {
-            _IBase nbase = m_iBase;
-            while(++nbase != m_owner->m_base.end()) {
-               // we are in sync also if the base is BEYOND us.
-               if(nbase == m_owner->m_curBase) {
-                  return true;
-               }
-            }
 
-         }
          // we need to resync.
-         m_iBase = m_owner->m_curBase;
-         if ( m_iBase->size() == 0)
+         if (m_owner->m_count == 0)
          {
             // the stack has been emptied in the meanwhile.
             // any resync operation implies a movement or a dereference
             // hence, we're done.
             throw std::runtime_error("Empty stack while resync");
          }
-         m_iData = m_iBase->end()-1;
+         m_pos = m_owner->m_count - 1;
 
          return false;
       }
 
-      _IBase m_iBase;
-      _IData m_iData;
-      _IBase m_iBaseBegin;
       PagedStack const* m_owner;
+      ptrdiff_t m_pos;
       friend class PagedStack;
    };
 
@@ -403,40 +779,172 @@ public:
 
    class lock_guard {
    public:
-      lock_guard(PagedStack const* owner): m_guard(owner->m_mutex) {};
+      lock_guard(PagedStack const* owner): m_guard(owner->m_mutex), m_owner(owner) {
+         m_owner->m_guardOwner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+      }
+      ~lock_guard() {
+         m_owner->m_guardOwner.store(std::thread::id(), std::memory_order_relaxed);
+      }
    private:
       std::lock_guard<_Mutex> m_guard;
+      PagedStack const* m_owner;
    };
 
    friend class lock_guard;
 
-   using iterator = iterator_base<_T, typename base_type::iterator, typename page_type::iterator>;
-   using const_iterator = iterator_base<const _T, typename base_type::const_iterator, typename page_type::const_iterator>;
-   using reverse_iterator = reverse_iterator_base<_T, typename base_type::iterator, typename page_type::iterator>;
-   using const_reverse_iterator = reverse_iterator_base<const _T, typename base_type::const_iterator, typename page_type::const_iterator>;
-   using sync_iterator = sync_iterator_base<_T, typename base_type::iterator, typename page_type::iterator>;
-   using const_sync_iterator = sync_iterator_base<const _T, typename base_type::const_iterator, typename page_type::const_iterator>;
-   friend class sync_iterator_base<_T, typename base_type::iterator, typename page_type::iterator>;;
-   friend class sync_iterator_base<const _T, typename base_type::const_iterator, typename page_type::const_iterator>;
+   using iterator = iterator_base<_T, PagedStack>;
+   using const_iterator = iterator_base<const _T, const PagedStack>;
+   using reverse_iterator = reverse_iterator_base<_T, PagedStack>;
+   using const_reverse_iterator = reverse_iterator_base<const _T, const PagedStack>;
+   using sync_iterator = sync_iterator_base<_T>;
+   using const_sync_iterator = sync_iterator_base<const _T>;
+   friend class sync_iterator_base<_T>;
+   friend class sync_iterator_base<const _T>;
 
 
    PagedStack(size_t pageSize = DEFAULT_PAGE_SIZE, size_t prealloc = DEFAULT_BASE_SIZE,
          const allocator_type& dataAllocator = allocator_type() ):
             m_pageSize(pageSize),
             m_allocSize(prealloc),
-            m_base(page_allocator_type(dataAllocator)),
-            m_dataAllocator(dataAllocator)
+            m_dataAllocator(dataAllocator),
+            m_pages(dataAllocator)
    {
       growBase();
-      m_curBase = m_base.begin();
    }
 
-   void top(const _T& value) noexcept { std::lock_guard<_Mutex> guard(m_mutex); m_curBase->back() = value; }
-   const _T& top() const noexcept { std::lock_guard<_Mutex> guard(m_mutex); return m_curBase->back(); }
+   /** Selects the forking constructor. */
+   struct fork_tag {};
+
+   /**
+    * Creates a stack holding the same elements as parent, sharing its pages.
+    *
+    * The full pages of parent are shared copy-on-write, and only the
+    * elements in its topmost, partially filled page are copied; forking
+    * costs an atomic increment per page, whatever the depth of parent.
+    *
+    * Afterwards, the two stacks are independent: when either one pops,
+    * discards or changes the top in a shared page, it copies the elements it
+    * keeps from that page first. Asking for mutable iterators copies the
+    * shared pages they can reach: all of them for begin() and rbegin(), the
+    * ones holding the topmost depth elements for from_top(depth). The const
+    * iterators keep reading the pages in place.
+    *
+    * The new stack has the page size and allocator of parent; the stacks can
+    * be used from different threads. SPSC stacks can't be forked, as their
+    * observer reads the page directory without the lock.
+    */
+   PagedStack(PagedStack& parent, fork_tag):
+            m_pageSize(parent.m_pageSize),
+            m_allocSize(parent.m_allocSize),
+            m_dataAllocator(parent.m_dataAllocator),
+            m_pages(parent.m_dataAllocator)
+   {
+      static_assert(!SPSC, "SPSC stacks can't be forked");
+      std::lock_guard<_Mutex> guard(parent.m_mutex);
+      parent.m_stats.op(StackStats::FORK);
+      size_t shared = parent.m_count / m_pageSize;
+      size_t rest = parent.m_count % m_pageSize;
+      m_pages.reserve(shared + 1);
+      m_shares.reserve(shared + 1);
+
+      std::vector<std::unique_ptr<page_share>> fresh;
+      for(size_t page = 0; page < shared; ++page) {
+         if(parent.m_shares[page] == nullptr) {
+            fresh.emplace_back(new page_share);
+         }
+      }
+
+      _T* top = allocator_traits::allocate(m_dataAllocator, m_pageSize);
+      m_stats.taken(false);
+      size_t done = 0;
+      try {
+         for(; done < rest; ++done) {
+            allocator_traits::construct(m_dataAllocator, top + done, parent.m_pages[shared][done]);
+         }
+      }
+      catch(...) {
+         destroy_elements(top, 0, done);
+         allocator_traits::deallocate(m_dataAllocator, top, m_pageSize);
+         throw;
+      }
+
+      // Nothing can throw from here on.
+      auto next = fresh.begin();
+      for(size_t page = 0; page < shared; ++page) {
+         page_share* share = parent.m_shares[page];
+         if(share == nullptr) {
+            share = (next++)->release();
+            parent.m_shares[page] = share;
+            ++parent.m_sharedPages;
+         }
+         share->m_refs.fetch_add(1, std::memory_order_relaxed);
+         m_pages.push_back(parent.m_pages[page]);
+         m_shares.push_back(share);
+      }
+      m_pages.push_back(top);
+      m_shares.push_back(nullptr);
+      m_sharedPages = shared;
+
+      m_count = parent.m_count;
+      if(rest == 0 && shared > 0) {
+         m_curPage = shared - 1;
+         m_curSize = m_pageSize;
+      }
+      else {
+         m_curPage = shared;
+         m_curSize = rest;
+      }
+      if constexpr (SPSC) {
+         m_spsc.m_pages.store(m_pages.data());
+      }
+      publish(m_count);
+      m_stats.depth(m_count);
+      m_stats.pages(m_pages.size());
+   }
+
+   PagedStack(const PagedStack&) = delete;
+   PagedStack& operator=(const PagedStack&) = delete;
+
+   /**
+    * Returns a new stack holding the elements of this one.
+    *
+    * Meant to start coroutines and generators on top of the stack of their
+    * caller. See PagedStack(PagedStack&, fork_tag).
+    */
+   PagedStack fork() {
+      return PagedStack(*this, fork_tag());
+   }
+
+   ~PagedStack() {
+      internal_discard(0);
+      for(_T* page: m_pages) {
+         if(page != nullptr) {
+            allocator_traits::deallocate(m_dataAllocator, page, m_pageSize);
+         }
+      }
+      free_pages(m_quarantine);
+   }
+
+   void top(const _T& value) {
+      std::lock_guard<_Mutex> guard(m_mutex);
+      m_stats.op(StackStats::SET_TOP);
+      if(m_shares[m_curPage] != nullptr) {
+         unshare_page(m_curPage, m_curSize);
+      }
+      damage(m_count - 1);
+      internal_top() = value;
+   }
+   const _T& top() const noexcept {
+      std::lock_guard<_Mutex> guard(m_mutex);
+      m_stats.op(StackStats::PEEK);
+      return internal_top();
+   }
 
    void push(const _T& data) {
       std::lock_guard<_Mutex> guard(m_mutex);
       internal_push(data);
+      m_stats.op(StackStats::PUSH);
+      m_stats.depth(m_count);
    }
 
    /**
@@ -448,6 +956,8 @@ public:
    void push(const _T& data, _Args&&... __args) {
       std::lock_guard<_Mutex> guard(m_mutex);
       internal_push(data, std::forward<_Args>(__args)...);
+      m_stats.op(StackStats::PUSH);
+      m_stats.depth(m_count);
    }
 
    /**
@@ -456,9 +966,9 @@ public:
    template<typename... _Args>
    void push_emplace(_Args&&... __args)	{
       std::lock_guard<_Mutex> guard(m_mutex);
-      advance();
-      // vector::emplace writes at the previous iterator.
-      m_curBase->emplace_back(std::forward<_Args>(__args)...);
+      internal_emplace(std::forward<_Args>(__args)...);
+      m_stats.op(StackStats::PUSH);
+      m_stats.depth(m_count);
    }
 
    /**
@@ -468,8 +978,14 @@ public:
     */
    void pop() {
       assert(!empty());
-      std::lock_guard<_Mutex> guard(m_mutex);
-      internal_pop_one();
+      quarantine_type condemned;
+      {
+         std::lock_guard<_Mutex> guard(m_mutex);
+         m_stats.op(StackStats::POP);
+         internal_pop_one();
+         internal_trim(condemned);
+      }
+      free_pages(condemned);
    }
 
    /**
@@ -482,8 +998,14 @@ public:
    template<typename... _Args>
    void pop(_T& value, _Args&&... __args) {
       assert(!empty());
-      std::lock_guard<_Mutex> guard(m_mutex);
-      internal_pop(value, std::forward<_Args>(__args)...);
+      quarantine_type condemned;
+      {
+         std::lock_guard<_Mutex> guard(m_mutex);
+         m_stats.op(StackStats::POP);
+         internal_pop(value, std::forward<_Args>(__args)...);
+         internal_trim(condemned);
+      }
+      free_pages(condemned);
    }
 
    /**
@@ -493,18 +1015,16 @@ public:
     * Discarding more elements than those currently in the stack has
     * undefined behavior.
     */
-   void discard(size_t count) noexcept {
+   void discard(size_t count) {
       assert(count <= size());
-      std::lock_guard<_Mutex> guard(m_mutex);
-      while(count >= m_curBase->size()) {
-         count -= m_curBase->size();
-         m_curBase->clear();
-         if( m_curBase == m_base.begin() ) {
-            return;
-         }
-         m_curBase--;
+      quarantine_type condemned;
+      {
+         std::lock_guard<_Mutex> guard(m_mutex);
+         m_stats.op(StackStats::DISCARD);
+         internal_discard(m_count - count);
+         internal_trim(condemned);
       }
-      m_curBase->resize(m_curBase->size() - count);
+      free_pages(condemned);
    }
 
    /**
@@ -512,24 +1032,39 @@ public:
     *
     * The element pointed by the iterator is the new stack top.
     */
-   template<typename _TT, typename _IBase, typename _IData>
-   void discard(const iterator_base<_TT, _IBase, _IData>& iter) noexcept {
-      std::lock_guard<_Mutex> guard(m_mutex);
-      internal_discard(iter.m_iBase, iter.m_iData);
+   template<typename _TT, typename _Owner>
+   void discard(const iterator_base<_TT, _Owner>& iter) {
+      quarantine_type condemned;
+      {
+         std::lock_guard<_Mutex> guard(m_mutex);
+         m_stats.op(StackStats::DISCARD);
+         internal_discard(iter.m_pos);
+         internal_trim(condemned);
+      }
+      free_pages(condemned);
    }
-   template<typename _TT, typename _IBase, typename _IData>
-   void discard(const reverse_iterator_base<_TT, _IBase, _IData>& iter) noexcept {
-      std::lock_guard<_Mutex> guard(m_mutex);
-      internal_discard(iter.m_iBase, iter.m_iData);
+   template<typename _TT, typename _Owner>
+   void discard(const reverse_iterator_base<_TT, _Owner>& iter) {
+      quarantine_type condemned;
+      {
+         std::lock_guard<_Mutex> guard(m_mutex);
+         m_stats.op(StackStats::DISCARD);
+         internal_discard(iter.m_pos);
+         internal_trim(condemned);
+      }
+      free_pages(condemned);
    }
 
-   void clear() noexcept {
+   void clear() {
       //TODO: Swap base.
-      std::lock_guard<_Mutex> guard(m_mutex);
-      while(m_curBase != m_base.begin()) {
-         m_curBase->clear();
-         --m_curBase;
+      quarantine_type condemned;
+      {
+         std::lock_guard<_Mutex> guard(m_mutex);
+         m_stats.op(StackStats::DISCARD);
+         internal_discard(0);
+         internal_trim(condemned);
       }
+      free_pages(condemned);
    }
 
    /**
@@ -537,84 +1072,124 @@ public:
     *
     * This method discards extra allocated pages, saving memory.
     * The topmost currently allocated page is not resized.
+    *
+    * The discarded pages are put in quarantine under the lock, and freed
+    * after releasing it, unless a sync_iterator (or, in SPSC mode, the
+    * observer) is alive; in that case, they are freed when the last one
+    * goes away. If reclamation is deferred, they are freed by reclaim().
     */
    void shrink_to_fit() {
-      std::lock_guard<_Mutex> guard(m_mutex);
-      if(m_syncIterCount > 0){
-         m_shrinkRequest = true;
-         return;
+      quarantine_type condemned;
+      {
+         std::lock_guard<_Mutex> guard(m_mutex);
+         m_stats.op(StackStats::SHRINK);
+         internal_shrink_to_fit();
+         if(!m_deferReclaim) {
+            take_reclaimable(condemned);
+         }
+      }
+      free_pages(condemned);
+   }
+
+   /**
+    * Frees the quarantined pages that can't be seen anymore.
+    *
+    * Can be called by a background reclaimer, except in SPSC mode, where
+    * only the owner thread can call it. Returns the number of freed pages.
+    */
+   size_t reclaim() {
+      quarantine_type condemned;
+      {
+         std::lock_guard<_Mutex> guard(m_mutex);
+         m_stats.op(StackStats::RECLAIM);
+         take_reclaimable(condemned);
       }
-      internal_shrink_to_fit();
+      free_pages(condemned);
+      return condemned.size();
+   }
+
+   /**
+    * Leaves the pages discarded by shrink_to_fit() to reclaim().
+    *
+    * Useful to free the memory from a background thread, out of the
+    * way of the thread using the stack.
+    */
+   void deferred_reclaim(bool mode) noexcept {
+      std::lock_guard<_Mutex> guard(m_mutex);
+      m_deferReclaim = mode;
+   }
+
+   /** Number of pages discarded, and not yet freed. */
+   size_t quarantined() const noexcept {
+      std::lock_guard<_Mutex> guard(m_mutex);
+      return m_quarantine.size();
    }
 
    /**
     * Returns true if the stack is empty.
     *
-    * The operation used to check the emptiness of the stack is simple, but not trivial.
     */
    bool empty() const noexcept {
       std::lock_guard<_Mutex> guard(m_mutex);
-      return m_curBase == m_base.begin() && m_curBase->empty();
+      return m_count == 0;
    }
 
-   iterator begin() noexcept {return iterator(m_curBase, --m_curBase->end(), m_base.begin());}
-   const_iterator begin() const noexcept  {return const_iterator(m_curBase, --m_curBase->end(), m_base.cbegin());}
+   // Mutable iterators can write anywhere: after a fork, they make the shared pages private first.
+   // Nothing is written through end() and rend().
+   iterator begin() {unshare_all(); return iterator(this, top_pos());}
+   const_iterator begin() const noexcept  {return const_iterator(this, top_pos());}
    const_iterator cbegin() const noexcept {return begin();}
 
-   iterator end() noexcept {return iterator(m_base.begin(), --m_base.front().begin(), m_base.begin()); }
-   const_iterator end() const noexcept {return const_iterator(m_base.begin(), --m_base.front().begin(), m_base.cbegin()); }
+   iterator end() {return iterator(this, -1); }
+   const_iterator end() const noexcept {return const_iterator(this, -1); }
    const_iterator cend() const noexcept {return end(); }
 
-   reverse_iterator rbegin() noexcept {return reverse_iterator(m_base.begin(), m_base.front().begin(), --m_base.end());}
-   const_reverse_iterator rbegin() const noexcept {return const_reverse_iterator(m_base.cbegin(), m_base.front().cbegin(), --m_base.cend());}
+   reverse_iterator rbegin() {unshare_all(); return reverse_iterator(this, 0);}
+   const_reverse_iterator rbegin() const noexcept {return const_reverse_iterator(this, 0);}
    const_reverse_iterator crbegin() const noexcept {return rbegin();}
 
-   reverse_iterator rend() noexcept{return reverse_iterator(m_curBase, m_curBase->end(), m_curBase);}
-   const_reverse_iterator rend() const noexcept{return const_reverse_iterator(m_curBase, m_curBase->end(), m_curBase);}
+   reverse_iterator rend() {return reverse_iterator(this, m_count);}
+   const_reverse_iterator rend() const noexcept{return const_reverse_iterator(this, m_count);}
    const_reverse_iterator crend() const noexcept{return rend(); }
 
-   sync_iterator sync_begin() noexcept {std::lock_guard<_Mutex> guard(m_mutex); return sync_iterator(this, m_curBase, --m_curBase->end(), m_base.begin());}
-   sync_iterator sync_end() noexcept {std::lock_guard<_Mutex> guard(m_mutex); return sync_iterator(this, m_base.begin(), --m_base.front().begin(), m_base.begin());}
-   const_sync_iterator sync_begin() const noexcept {std::lock_guard<_Mutex> guard(m_mutex); return const_sync_iterator(this, m_curBase, --m_curBase->cend(), m_base.cbegin());}
-   const_sync_iterator sync_end() const noexcept {std::lock_guard<_Mutex> guard(m_mutex); return const_sync_iterator(this, m_base.begin(), --m_base.front().cbegin(), m_base.cbegin());}
+   sync_iterator sync_begin() noexcept {std::lock_guard<_Mutex> guard(m_mutex); return sync_iterator(this, top_pos());}
+   sync_iterator sync_end() noexcept {std::lock_guard<_Mutex> guard(m_mutex); return sync_iterator(this, -1);}
+   const_sync_iterator sync_begin() const noexcept {std::lock_guard<_Mutex> guard(m_mutex); return const_sync_iterator(this, top_pos());}
+   const_sync_iterator sync_end() const noexcept {std::lock_guard<_Mutex> guard(m_mutex); return const_sync_iterator(this, -1);}
    const_sync_iterator csync_begin() const noexcept {return sync_begin();}
    const_sync_iterator csync_end() const noexcept {return sync_end();}
 
 private:
 
+   ptrdiff_t top_pos() const noexcept { return static_cast<ptrdiff_t>(m_count) - 1; }
+
    reverse_iterator internal_from_top(size_t depth) noexcept {
-      typename base_type::iterator iBase = m_curBase;
-      while(depth > iBase->size()) {
-         depth -= iBase->size();
-         iBase--;
-      }
-      return reverse_iterator(iBase, iBase->begin() + (iBase->size() - depth), m_curBase);
+      return reverse_iterator(this, m_count - depth);
    }
 
-
    const_reverse_iterator internal_from_top(size_t depth) const noexcept {
-      typename base_type::iterator iBase = m_curBase;
-      while(depth > iBase->size()) {
-         depth -= iBase->size();
-         iBase--;
-      }
-      return const_reverse_iterator(iBase, iBase->begin() + (iBase->size() - depth), m_curBase);
+      return const_reverse_iterator(this, m_count - depth);
    }
 
 public:
 
    /**
     * Return a reverse iterator from the nth- element to the top.
+    *
+    * After a fork, the shared pages holding these elements are made private.
     */
-   reverse_iterator from_top(size_t depth) noexcept {
+   reverse_iterator from_top(size_t depth) {
       assert(depth <= size());
       std::lock_guard<_Mutex> guard(m_mutex);
+      unshare_from(m_count - depth);
+      m_stats.op(StackStats::PEEK);
       return internal_from_top(depth);
     }
 
    const_reverse_iterator from_top(size_t depth) const noexcept {
       assert(depth <= size());
       std::lock_guard<_Mutex> guard(m_mutex);
+      m_stats.op(StackStats::PEEK);
       return internal_from_top(depth);
    }
 
@@ -628,6 +1203,7 @@ public:
    {
       assert(sizeof...(__args) <= size());
       std::lock_guard<_Mutex> guard(m_mutex);
+      m_stats.op(StackStats::PEEK);
       distribute(cbegin(), std::forward<_Args>(__args)...);
    }
 
@@ -646,6 +1222,7 @@ public:
       assert(depth <= size());
       assert(depth >= sizeof...(__args));
       std::lock_guard<_Mutex> guard(m_mutex);
+      m_stats.op(StackStats::PEEK);
       distribute(internal_from_top(depth), std::forward<_Args>(__args)...);
    }
 
@@ -660,6 +1237,7 @@ public:
    {
       assert(sizeof...(__args) <= size());
       std::lock_guard<_Mutex> guard(m_mutex);
+      m_stats.op(StackStats::PEEK);
       distribute(internal_from_top(sizeof...(__args)), std::forward<_Args>(__args)...);
    }
 
@@ -677,47 +1255,141 @@ public:
    void pop_reverse(_Args&&... __args)
    {
       assert(sizeof...(__args) <= size());
+      quarantine_type condemned;
+      {
+         std::lock_guard<_Mutex> guard(m_mutex);
+         m_stats.op(StackStats::POP);
+         auto pos = internal_from_top(sizeof...(__args));
+         auto start = pos;
+         distribute(pos, std::forward<_Args>(__args)...);
+         internal_discard(start.m_pos);
+         internal_trim(condemned);
+      }
+      free_pages(condemned);
+   }
+
+   /**
+    * Pushes the elements in [first, last), in order.
+    *
+    * The last element will be on top of the stack. Elements are copied a
+    * page at a time; when the iterators are pointers and _T is trivially
+    * copyable, each page is filled with a single memcpy.
+    */
+   template<typename _It>
+   void push_range(_It first, _It last) {
+      size_t count = static_cast<size_t>(std::distance(first, last));
       std::lock_guard<_Mutex> guard(m_mutex);
-      auto pos = internal_from_top(sizeof...(__args));
-      auto start = pos;
-      distribute(pos, std::forward<_Args>(__args)...);
-      internal_discard(start.m_iBase, start.m_iData);
+      m_stats.op(StackStats::PUSH_RANGE);
+      internal_push_range(first, count);
+      m_stats.depth(m_count);
    }
 
    /**
-    * Computes the size of the stack.
+    * Copies the count topmost elements to out, and removes them.
+    *
+    * The elements are written in the order they were pushed, so that
+    * the previous top is written last, as for pop_reverse().
     *
-    * This is a lengthy operation. Don't use it on optimised code
+    * Returns the output iterator past the last written element.
+    * Popping more elements than those in the stack has undefined behaviour.
     */
+   template<typename _OutIt>
+   _OutIt pop_range(_OutIt out, size_t count) {
+      assert(count <= size());
+      quarantine_type condemned;
+      {
+         std::lock_guard<_Mutex> guard(m_mutex);
+         m_stats.op(StackStats::POP_RANGE);
+         size_t from = m_count - count;
+         out = internal_copy_range(from, out);
+         internal_discard(from);
+         internal_trim(condemned);
+      }
+      free_pages(condemned);
+      return out;
+   }
 
+   /**
+    * Returns the number of elements in the stack.
+    */
    size_t size() const noexcept {
-      size_t count = 0;
       std::lock_guard<_Mutex> guard(m_mutex);
-      auto iter = m_base.begin();
-      while(iter != m_curBase) {
-         count += iter->size();
-         ++iter;
+      return m_count;
+   }
+
+   /**
+    * Reads the stack from a thread other than the owner (SPSC mode only).
+    *
+    * Calls func on each element from the bottom, without locking, and
+    * returns how many elements from the bottom were not touched by the owner
+    * while being read. The elements above those might have been changed or
+    * destroyed meanwhile: func should copy them, and not follow pointers
+    * they hold, unless they turn out to be valid.
+    *
+    * Only one thread at a time can observe the stack.
+    */
+   template<typename _Func>
+   size_t observe(_Func&& func) const {
+      static_assert(SPSC, "PagedStack::observe requires the spsc_mutex mode");
+      spsc_state& state = m_spsc;
+      state.m_readerEpoch.store(state.m_epoch.load());
+      state.m_lowWater.exchange(SIZE_MAX);
+      size_t count = state.m_count.load(std::memory_order_acquire);
+      _T* const* pages = state.m_pages.load();
+      for(size_t pos = 0; pos < count; ++pos) {
+         func(static_cast<const _T&>(pages[pos / m_pageSize][pos % m_pageSize]));
       }
-      count += m_curBase->size();
-      return count;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      size_t valid = std::min(count, state.m_lowWater.load(std::memory_order_relaxed));
+      state.m_readerEpoch.store(0, std::memory_order_release);
+      return valid;
+   }
+
+   /**
+    * Copies the stack from a thread other than the owner (SPSC mode only).
+    *
+    * The elements changed by the owner while being copied are dropped, so
+    * out receives a consistent bottom part of the stack.
+    */
+   void snapshot(std::vector<_T>& out) const {
+      static_assert(std::is_trivially_copyable<_T>::value, "PagedStack::snapshot requires trivially copyable elements");
+      out.clear();
+      size_t valid = observe([&out](const _T& value) { out.push_back(value); });
+      out.erase(out.begin() + valid, out.end());
    }
 
    allocator_type get_allocator() const noexcept { return m_dataAllocator;}
 
+   /**
+    * Returns the counters recorded by the instrumentation policy, with the
+    * current layout of the stack.
+    *
+    * The layout is read under the lock; with dummy_mutex or spsc_mutex,
+    * other threads should read only the counters, through counters().
+    */
+   StackStats stats() const noexcept {
+      std::lock_guard<_Mutex> guard(m_mutex);
+      StackStats stats;
+      m_stats.fill(stats);
+      stats.m_pageSize = m_pageSize;
+      stats.m_prealloc = m_allocSize;
+      stats.m_pages = m_pages.size();
+      stats.m_depth = m_count;
+      return stats;
+   }
+
+   /** The instrumentation policy; its counters can be read from any thread. */
+   const _Stats& counters() const noexcept { return m_stats; }
+
    /**
     * Diagnostic
     */
    void getStats(size_t& blocks, size_t& depth, size_t& curBlock, size_t& curData) const noexcept {
       std::lock_guard<_Mutex> guard(m_mutex);
-      blocks = m_base.size();
+      blocks = m_pages.size();
       depth = m_pageSize;
-      typename base_type::const_iterator iter = m_base.begin();
-      curBlock = 1;
-      while(iter != m_curBase) {
-         ++curBlock;
-         ++iter;
-      }
-      curData = m_curBase->size();
+      curBlock = m_curPage + 1;
+      curData = m_curSize;
    }
 };
 
@@ -0,0 +1,234 @@
+/*****************************************************************************
+  FALCON - The Falcon Programming Language
+  FILE: pairitem.h
+
+  Item layout as a pair of raw data and type handler.
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin : 
+  Touch : 
+
+  -------------------------------------------------------------------
+  (C) Copyright 2018 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_PAIRITEM_H_
+#define _FALCON_PAIRITEM_H_
+
+#include <cstring>
+#include <stdexcept>
+#include "falcon/types.h"
+#include "falcon/engine/handlerfactory.h"
+
+namespace falcon {
+
+/**
+ * Item layout storing the raw data and the handler side by side.
+ *
+ * This is the default, 16 bytes wide, item layout. Every type known
+ * by the engine can be stored here, as the handler is always explicit.
+ */
+class PairItem {
+public:
+    ItemData data;
+    Handler* handler;
+
+    PairItem() : data(nullptr), handler(&HandlerFactory::nilHandler) {}
+
+    template<typename T>
+    PairItem(T value) : data(nullptr), handler(nullptr) {
+        if constexpr (std::is_same_v<T, bool>) {
+            data = ItemData(value);
+            handler = &HandlerFactory::boolHandler;
+        } else if constexpr (std::is_same_v<T, char>) {
+            data = ItemData(value);
+            handler = &HandlerFactory::intHandler;
+        } else if constexpr (std::is_same_v<T, byte>) {
+            data = ItemData(value);
+            handler = &HandlerFactory::intHandler;
+        } else if constexpr (std::is_same_v<T, int32>) {
+            data = ItemData(value);
+            handler = &HandlerFactory::intHandler;
+        } else if constexpr (std::is_same_v<T, uint32>) {
+            data = ItemData(value);
+            handler = &HandlerFactory::intHandler;
+        } else if constexpr (std::is_same_v<T, int64>) {
+            data = ItemData(value);
+            handler = &HandlerFactory::intHandler;
+        } else if constexpr (std::is_same_v<T, uint64>) {
+            data = ItemData(value);
+            handler = &HandlerFactory::intHandler;
+        } else if constexpr (std::is_same_v<T, numeric>) {
+            data = ItemData(value);
+            handler = &HandlerFactory::floatHandler;
+        } else if constexpr (std::is_same_v<T, ccstring>) {
+            setString(value, std::strlen(value));
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            setString(value.data(), value.size());
+        }
+        else if constexpr (std::is_same_v<T, Atom*>) {
+            // the item takes the reference held by the caller.
+            data.ptrValue = value;
+            handler = &HandlerFactory::atomHandler;
+        }
+        else if constexpr (std::is_same_v<T, BigNum>) {
+            data = BigNumHandler::create(value);
+            handler = &HandlerFactory::bigNumHandler;
+        }
+        else if constexpr (std::is_same_v<T, Int128>) {
+            data = FixedIntHandler<128>::create(value);
+            handler = &HandlerFactory::int128Handler;
+        }
+        else if constexpr (std::is_same_v<T, Int256>) {
+            data = FixedIntHandler<256>::create(value);
+            handler = &HandlerFactory::int256Handler;
+        }
+        else if constexpr (is_typed_array<T>::value) {
+            data = TypedArrayHandler<typename T::value_type>::create(std::move(value));
+            handler = HandlerFactory::typedArrayHandler<typename T::value_type>();
+        }
+        else if constexpr (std::is_same_v<T, Dict<PairItem>>) {
+            data = DictHandler<PairItem>::create(std::move(value));
+            handler = &HandlerFactory::pairDictHandler;
+        } else {
+            throw std::invalid_argument("Not a valid item type");
+        }
+    }
+
+    PairItem(const PairItem& other) noexcept : data(other.handler->copy(other.data)), handler(other.handler) {}
+
+    /** Moving an item leaves nil in the source, without touching reference counts. */
+    PairItem(PairItem&& other) noexcept : data(other.data), handler(other.handler) {
+        other.handler = &HandlerFactory::nilHandler;
+    }
+
+    PairItem& operator=(const PairItem& other) noexcept {
+        if (this != &other) {
+            ItemData copied = other.handler->copy(other.data);
+            handler->destroy(data);
+            data = copied;
+            handler = other.handler;
+        }
+        return *this;
+    }
+
+    PairItem& operator=(PairItem&& other) noexcept {
+        if (this != &other) {
+            handler->destroy(data);
+            data = other.data;
+            handler = other.handler;
+            other.handler = &HandlerFactory::nilHandler;
+        }
+        return *this;
+    }
+
+    ~PairItem() {
+        handler->destroy(data);
+    }
+
+    /**
+     * Write access to the deep payload of type T held by this item.
+     *
+     * If the payload is a value shared with other items, this item receives
+     * a private copy first. Strings stored inline or interned are promoted
+     * to a heap string.
+     *
+     * @throw std::invalid_argument if the item doesn't hold a T.
+     */
+    template<typename T>
+    T& modify() {
+        if constexpr (std::is_same_v<T, String>) {
+            if (handler != &HandlerFactory::stringHandler) {
+                PairItem promoted;
+                promoted.data = StringHandler::create(toString());
+                promoted.handler = &HandlerFactory::stringHandler;
+                *this = std::move(promoted);
+            }
+        }
+        if (handler != HandlerFactory::deepHandler<T>()) {
+            throw std::invalid_argument("Item doesn't hold the requested type");
+        }
+        return static_cast<const DeepHandlerBase<T>*>(handler)->writable(data);
+    }
+
+    /**
+     * Replaces a heap string with its atom in the global StringPool.
+     *
+     * Equal interned strings share a single copy, and compare by pointer.
+     * The other items, short strings included, are left as they are.
+     */
+    void intern() {
+        if (handler == &HandlerFactory::stringHandler) {
+            Atom* atom = StringPool::global().intern(StringHandler::payload(data));
+            handler->destroy(data);
+            data.ptrValue = atom;
+            handler = &HandlerFactory::atomHandler;
+        }
+    }
+
+    template<typename T>
+    T get() const {
+        if constexpr (std::is_same_v<T, bool>) {
+            return data.boolValue;
+        } else if constexpr (std::is_same_v<T, int64>) {
+            return data.int64Value;
+        } else if constexpr (std::is_same_v<T, uint64>) {
+           return data.uint64Value;
+        } else if constexpr (std::is_same_v<T, numeric>) {
+            return data.numericValue;
+        } else if constexpr (std::is_same_v<T, String>) {
+           if (handler == &HandlerFactory::shortStringHandler) {
+              return HandlerFactory::shortStringHandler.toString(data);
+           }
+           if (handler == &HandlerFactory::atomHandler) {
+              return AtomHandler::atom(data)->value();
+           }
+           return StringHandler::payload(data);
+        }
+        else if constexpr (std::is_same_v<T, BigNum>) {
+           return BigNumHandler::payload(data);
+        }
+        else if constexpr (std::is_same_v<T, Int128> || std::is_same_v<T, Int256>) {
+           return FixedIntHandler<T::BITS>::payload(data);
+        }
+        else if constexpr (is_typed_array<T>::value) {
+           return TypedArrayHandler<typename T::value_type>::payload(data);
+        }
+        else if constexpr (std::is_same_v<T, Dict<PairItem>>) {
+           return DictHandler<PairItem>::payload(data);
+        } else {
+            throw std::invalid_argument("Not a valid item type");
+        }
+    }
+
+    String toString() const noexcept {return HandlerFactory::dispatch(handler, [&](const auto& h) {return h.toString(data);});}
+    void toString(String& out) const noexcept {HandlerFactory::dispatch(handler, [&](const auto& h) {h.toString(data, out);});}
+    int64 toInt() const noexcept {return HandlerFactory::dispatch(handler, [&](const auto& h) {return h.toInt(data);});}
+    bool toBool() const noexcept {return HandlerFactory::dispatch(handler, [&](const auto& h) {return h.toBool(data);});}
+
+    size_t hash() const noexcept {return HandlerFactory::dispatch(handler, [&](const auto& h) {return h.hash(data);});}
+    bool equals(const PairItem& other) const noexcept {
+        return HandlerFactory::dispatch(handler, [&](const auto& h) {return h.equals(data, other.handler, other.data);});
+    }
+    int compare(const PairItem& other) const noexcept {
+        return HandlerFactory::dispatch(handler, [&](const auto& h) {return h.compare(data, other.handler, other.data);});
+    }
+
+private:
+    /** Short strings are stored inline, the others are promoted to the heap. */
+    void setString(const char* str, size_t len) {
+        if (ShortStringHandler::fits(str, len)) {
+            data = ShortStringHandler::store(str, len);
+            handler = &HandlerFactory::shortStringHandler;
+        }
+        else {
+            data = StringHandler::create(str, len);
+            handler = &HandlerFactory::stringHandler;
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*****************************************************************************
+  FALCON - The Falcon Programming Language
+  FILE: shortstringhandler.h
+
+  Handler for short strings stored inline in the item.
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin : 
+  Touch : 
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+#ifndef _FALCON_SHORTSTRINGHANDLER_H_
+#define _FALCON_SHORTSTRINGHANDLER_H_
+
+#include <cstring>
+#include "falcon/engine/flathandler.h"
+
+namespace falcon {
+
+/**
+ * Handler for strings short enough to be stored in the ItemData itself.
+ *
+ * The characters are stored zero-padded in ItemData::shortString, so
+ * the length is implicit. Strings longer than CAPACITY, or containing
+ * zero characters, are stored by the heap-backed StringHandler instead.
+ */
+struct ShortStringHandler final: public FlatHandler {
+    static constexpr size_t CAPACITY = sizeof(ItemData::shortString);
+
+    virtual ~ShortStringHandler() {}
+
+    ItemData allocate() const override {return 0LL;}
+
+    /** Returns true if the given string can be stored inline, in at most capacity bytes. */
+    static bool fits(const char* str, size_t len, size_t capacity = CAPACITY) noexcept {
+        return len <= capacity && std::memchr(str, 0, len) == nullptr;
+    }
+
+    /** Stores a string that fits() in the item data. */
+    static ItemData store(const char* str, size_t len) noexcept {
+        ItemData data(0LL);
+        std::memcpy(data.shortString, str, len);
+        return data;
+    }
+
+    static size_t length(const ItemData& data) noexcept {
+        const void* end = std::memchr(data.shortString, 0, CAPACITY);
+        return end ? static_cast<size_t>(static_cast<const char*>(end) - data.shortString) : CAPACITY;
+    }
+
+    String typeName() const noexcept override {return "String";}
+    String toString(ItemData data) const noexcept override {return String(data.shortString, length(data));}
+    void toString(ItemData data, String& out) const noexcept override {out.append(data.shortString, length(data));}
+    bool toBool(ItemData data) const noexcept override {return data.shortString[0] != 0;}
+    int64 toInt(ItemData data) const noexcept override {return std::stoll(toString(data));}
+
+    bool stringView(const ItemData& data, std::string_view& view) const noexcept override {
+        view = std::string_view(data.shortString, length(data));
+        return true;
+    }
+    size_t hash(ItemData data) const noexcept override {return hashString(std::string_view(data.shortString, length(data)));}
+    bool equals(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+        return equalsString(std::string_view(data.shortString, length(data)), other, otherData);
+    }
+    int compare(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+        return compareString(std::string_view(data.shortString, length(data)), other, otherData);
+    }
+};
+
+}
+
+#endif
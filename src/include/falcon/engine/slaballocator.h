@@ -0,0 +1,256 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: slaballocator.h
+
+  Per-thread slab allocator for fixed size objects
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_SLABALLOCATOR_H_
+#define _FALCON_SLABALLOCATOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace falcon {
+
+/** Snapshot of the status of a slab allocator. */
+struct SlabStats {
+   /** Objects currently allocated and not yet released. */
+   size_t m_liveObjects;
+   /** Bytes used by the live objects. */
+   size_t m_liveBytes;
+   /** Number of slabs reserved from the system. */
+   size_t m_slabs;
+   /** Bytes reserved from the system. */
+   size_t m_reservedBytes;
+};
+
+/**
+ * Allocator serving single objects of type _T from per-thread free lists.
+ *
+ * Objects are carved from slabs of SLAB_SIZE bytes; each thread keeps its
+ * own list of free blocks, so allocating and releasing an object usually
+ * doesn't need any lock. Objects can be released by any thread: the block
+ * goes to the free list of the releasing thread. Threads keeping too many
+ * free blocks, and terminating threads, give them back to a pool shared by
+ * all the threads of the process.
+ *
+ * Slabs are never given back to the system.
+ *
+ * The allocator is stateless, and can be used as the _Allocator template
+ * parameter of DeepHandler or PagedStack. Requests for more than one object
+ * are forwarded to std::allocator.
+ */
+template<typename _T>
+class SlabAllocator
+{
+public:
+   static constexpr size_t SLAB_SIZE = 64 * 1024;
+   static constexpr size_t BATCH_SIZE = 64;
+
+   using value_type = _T;
+   using size_type = std::size_t;
+   using propagate_on_container_move_assignment = std::true_type;
+   using is_always_equal = std::true_type;
+
+   template <class U> struct rebind { typedef SlabAllocator<U> other; };
+
+   SlabAllocator() noexcept {}
+   template <typename U>
+   SlabAllocator(const SlabAllocator<U>&) noexcept {}
+
+   _T* allocate(std::size_t size)
+   {
+      if(size != 1) {
+         return std::allocator<_T>().allocate(size);
+      }
+
+      Cache* cache = Cache::current();
+      if(cache == nullptr) {
+         std::lock_guard<std::mutex> guard(global().m_mtx);
+         Block* block = global().takeLocked();
+         ++global().m_retiredAllocs;
+         return reinterpret_cast<_T*>(block);
+      }
+
+      if(cache->m_free == nullptr) {
+         std::lock_guard<std::mutex> guard(global().m_mtx);
+         for(size_t i = 0; i < BATCH_SIZE; ++i) {
+            cache->push(global().takeLocked());
+         }
+      }
+      cache->m_allocs.store(cache->m_allocs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return reinterpret_cast<_T*>(cache->pop());
+   }
+
+   void deallocate(_T* data, std::size_t size) noexcept
+   {
+      if(size != 1) {
+         std::allocator<_T>().deallocate(data, size);
+         return;
+      }
+
+      Block* block = reinterpret_cast<Block*>(data);
+      Cache* cache = Cache::current();
+      if(cache == nullptr) {
+         std::lock_guard<std::mutex> guard(global().m_mtx);
+         global().putLocked(block);
+         ++global().m_retiredFrees;
+         return;
+      }
+
+      cache->push(block);
+      cache->m_frees.store(cache->m_frees.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      if(cache->m_freeCount > 4 * BATCH_SIZE) {
+         std::lock_guard<std::mutex> guard(global().m_mtx);
+         for(size_t i = 0; i < 2 * BATCH_SIZE; ++i) {
+            global().putLocked(cache->pop());
+         }
+      }
+   }
+
+   /** Status of the allocator for objects of type _T, across all threads. */
+   static SlabStats stats() noexcept
+   {
+      Global& g = global();
+      std::lock_guard<std::mutex> guard(g.m_mtx);
+      size_t allocs = g.m_retiredAllocs;
+      size_t frees = g.m_retiredFrees;
+      for(Cache* cache: g.m_caches) {
+         allocs += cache->m_allocs.load(std::memory_order_relaxed);
+         frees += cache->m_frees.load(std::memory_order_relaxed);
+      }
+
+      SlabStats stats;
+      // counters of other threads are read while they run, and might lag.
+      stats.m_liveObjects = allocs > frees ? allocs - frees : 0;
+      stats.m_liveBytes = stats.m_liveObjects * sizeof(_T);
+      stats.m_slabs = g.m_slabs.size();
+      stats.m_reservedBytes = stats.m_slabs * SLAB_BLOCKS * sizeof(Block);
+      return stats;
+   }
+
+   template<typename U>
+   bool operator==(const SlabAllocator<U>&) const noexcept { return true; }
+   template<typename U>
+   bool operator!=(const SlabAllocator<U>&) const noexcept { return false; }
+
+private:
+   union Block {
+      Block* m_next;
+      alignas(_T) unsigned char m_data[sizeof(_T)];
+   };
+
+   static constexpr size_t SLAB_BLOCKS = std::max(SLAB_SIZE / sizeof(Block), BATCH_SIZE);
+
+   class Cache;
+
+   struct Global {
+      std::mutex m_mtx;
+      std::vector<Block*> m_slabs;
+      std::vector<Cache*> m_caches;
+      Block* m_free{nullptr};
+      size_t m_retiredAllocs{0};
+      size_t m_retiredFrees{0};
+
+      Block* takeLocked() {
+         if(m_free == nullptr) {
+            Block* slab = new Block[SLAB_BLOCKS];
+            m_slabs.push_back(slab);
+            for(size_t i = 0; i < SLAB_BLOCKS; ++i) {
+               putLocked(slab + i);
+            }
+         }
+         Block* block = m_free;
+         m_free = block->m_next;
+         return block;
+      }
+
+      void putLocked(Block* block) noexcept {
+         block->m_next = m_free;
+         m_free = block;
+      }
+   };
+
+   // Created on first use, and never destroyed: objects might be released
+   // during the destruction of static data, after the end of any thread.
+   static Global& global() noexcept {
+      static Global* g = new Global;
+      return *g;
+   }
+
+   class Cache {
+   public:
+      Block* m_free{nullptr};
+      size_t m_freeCount{0};
+      // Written by the owner thread only; atomic to be read by stats().
+      std::atomic<size_t> m_allocs{0};
+      std::atomic<size_t> m_frees{0};
+
+      Cache() {
+         std::lock_guard<std::mutex> guard(global().m_mtx);
+         global().m_caches.push_back(this);
+      }
+
+      ~Cache() {
+         retired() = true;
+         Global& g = global();
+         std::lock_guard<std::mutex> guard(g.m_mtx);
+         while(m_free != nullptr) {
+            g.putLocked(pop());
+         }
+         g.m_retiredAllocs += m_allocs.load(std::memory_order_relaxed);
+         g.m_retiredFrees += m_frees.load(std::memory_order_relaxed);
+         for(auto iter = g.m_caches.begin(); iter != g.m_caches.end(); ++iter) {
+            if(*iter == this) {
+               g.m_caches.erase(iter);
+               break;
+            }
+         }
+      }
+
+      void push(Block* block) noexcept {
+         block->m_next = m_free;
+         m_free = block;
+         ++m_freeCount;
+      }
+
+      Block* pop() noexcept {
+         Block* block = m_free;
+         m_free = block->m_next;
+         --m_freeCount;
+         return block;
+      }
+
+      /** The cache of this thread, or nullptr if the thread is terminating. */
+      static Cache* current() noexcept {
+         if(retired()) {
+            return nullptr;
+         }
+         static thread_local Cache s_cache;
+         return &s_cache;
+      }
+
+      static bool& retired() noexcept {
+         static thread_local bool s_retired = false;
+         return s_retired;
+      }
+   };
+};
+
+}
+
+#endif /* _FALCON_SLABALLOCATOR_H_ */
+
+/* end of slaballocator.h */
@@ -0,0 +1,117 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: stackgrowth.h
+
+  Growth policies of PagedStack
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_STACKGROWTH_H_
+#define _FALCON_STACKGROWTH_H_
+
+#include <algorithm>
+#include <cstddef>
+
+namespace falcon {
+
+/*
+ * A growth policy decides how many pages PagedStack adds to its directory
+ * when it's full, and how many spare pages it keeps when the stack gets
+ * lower. The page size never changes: positions are computed from it.
+ *
+ * - grow(pages, prealloc) returns the number of pages to add to a full
+ *   directory of pages pages; prealloc is the value given to the stack.
+ * - trim(used, pages, prealloc) is called after removing elements, with the
+ *   pages currently used, and returns the number of pages to keep. It's
+ *   called only if TRIMS is true.
+ *
+ * The pages given back go through the quarantine of the stack, as with
+ * shrink_to_fit().
+ */
+
+/** Grows by prealloc pages, and never gives pages back on its own. */
+class fixed_growth {
+public:
+   static constexpr bool TRIMS = false;
+
+   size_t grow(size_t, size_t prealloc) noexcept { return prealloc; }
+   size_t trim(size_t, size_t pages, size_t) noexcept { return pages; }
+};
+
+
+/**
+ * Doubles the directory, and halves it when mostly unused.
+ *
+ * The pages are given back only when less than a quarter of them is used,
+ * keeping twice the used ones: a stack moving up and down around a page
+ * boundary never allocates and frees the same pages over and over.
+ */
+class geometric_growth {
+public:
+   static constexpr bool TRIMS = true;
+
+   size_t grow(size_t pages, size_t prealloc) noexcept { return std::max(pages, prealloc); }
+
+   size_t trim(size_t used, size_t pages, size_t prealloc) noexcept {
+      if(pages > prealloc && pages > 4 * used) {
+         return std::max(prealloc, 2 * used);
+      }
+      return pages;
+   }
+};
+
+
+/**
+ * Sizes the directory after the high-water marks observed in the past.
+ *
+ * The highest number of pages used is recorded over windows of WINDOW
+ * calls to trim(). When growing, the directory goes straight to the mark
+ * of the previous window, so that a recursion reaching the same depth again
+ * doesn't grow a few pages at a time; when a window ends, the pages above
+ * that mark, plus a quarter, are given back.
+ *
+ * Interpreters running small scripts stay small, and those going deep
+ * keep the pages they keep needing.
+ */
+class adaptive_growth {
+public:
+   static constexpr bool TRIMS = true;
+   enum {
+      WINDOW = 4096
+   };
+
+   size_t grow(size_t pages, size_t prealloc) noexcept {
+      // the directory is full, and one more page is needed.
+      m_recent = std::max(m_recent, pages + 1);
+      return std::max(pages + prealloc, m_mark) - pages;
+   }
+
+   size_t trim(size_t used, size_t pages, size_t prealloc) noexcept {
+      m_recent = std::max(m_recent, used);
+      if(++m_calls < WINDOW) {
+         return pages;
+      }
+      m_calls = 0;
+      m_mark = m_recent;
+      m_recent = used;
+      return std::min(pages, std::max(prealloc, m_mark + m_mark / 4));
+   }
+
+private:
+   size_t m_mark{0};
+   size_t m_recent{0};
+   size_t m_calls{0};
+};
+
+}
+
+#endif /* _FALCON_STACKGROWTH_H_ */
+
+/* end of stackgrowth.h */
@@ -0,0 +1,253 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: stackstats.h
+
+  Instrumentation policies of PagedStack
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_STACKSTATS_H_
+#define _FALCON_STACKSTATS_H_
+
+#include <falcon/setup.h>
+#include <falcon/atomic.h>
+#include <falcon/statistics.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace falcon {
+
+/** Snapshot of the counters of a PagedStack. */
+struct FALCON_API_ StackStats {
+   /** Operations counted separately. */
+   enum Op {
+      PUSH,
+      POP,
+      DISCARD,
+      PEEK,
+      SET_TOP,
+      PUSH_RANGE,
+      POP_RANGE,
+      FORK,
+      SHRINK,
+      RECLAIM,
+      OP_COUNT
+   };
+
+   /** Elements per page. */
+   size_t m_pageSize{0};
+   /** Pages added each time the stack grows. */
+   size_t m_prealloc{0};
+   /** Pages in the directory of the stack. */
+   size_t m_pages{0};
+   /** Elements in the stack. */
+   size_t m_depth{0};
+
+   /** Greatest number of elements ever held. */
+   uint64_t m_highWater{0};
+   /** Greatest number of pages ever held in the directory. */
+   uint64_t m_peakPages{0};
+   /** Times the directory was grown. */
+   uint64_t m_grows{0};
+   /** Time spent growing the directory, allocating the pages included. */
+   uint64_t m_growNanos{0};
+   /** Times the stack was shrunk, and the pages it gave back. */
+   uint64_t m_shrinks{0};
+   uint64_t m_shrunkPages{0};
+   /**
+    * Pages obtained from the allocator; each one is touched, and faulted
+    * in, when the stack first reaches it.
+    */
+   uint64_t m_allocatedPages{0};
+   /** Pages taken back from the quarantine instead. */
+   uint64_t m_reusedPages{0};
+   /** Pages shared with a forked stack, and copied to be written. */
+   uint64_t m_copiedPages{0};
+   uint64_t m_ops[OP_COUNT]{};
+
+   /** Name of the operation, as written by write(). */
+   static const char* opName(Op op) noexcept;
+
+   /**
+    * Writes the stats in the Prometheus text format.
+    *
+    * Each sample is labelled with stack="name"; the names of the metrics
+    * start with falcon_stack_. The output is a whole exposition, with the
+    * TYPE lines: use writeAll() to dump several stacks together.
+    */
+   void write(std::ostream& out, const std::string& name) const;
+
+   /**
+    * Writes the stats of several stacks, each paired with its name.
+    *
+    * Each metric family is written once, with the samples of all the stacks.
+    */
+   static void writeAll(std::ostream& out, const std::vector<std::pair<std::string, StackStats>>& stacks);
+};
+
+
+/**
+ * Instrumentation policy of PagedStack recording nothing.
+ *
+ * All the calls are empty, and disappear when inlined.
+ */
+class no_stack_stats {
+public:
+   using time_point = int;
+
+   void op(StackStats::Op) noexcept {}
+   void depth(size_t) noexcept {}
+   void pages(size_t) noexcept {}
+   time_point now() const noexcept { return 0; }
+   void grown(time_point) noexcept {}
+   void shrunk(size_t) noexcept {}
+   void taken(bool) noexcept {}
+   void copied() noexcept {}
+   void fill(StackStats&) const noexcept {}
+};
+
+
+/**
+ * Instrumentation policy of PagedStack recording the counters of StackStats.
+ *
+ * The counters are written by the thread holding the stack (or its lock),
+ * and can be read at any time through fill() from other threads.
+ */
+class stack_counters {
+public:
+   using time_point = std::chrono::steady_clock::time_point;
+
+   void op(StackStats::Op op) noexcept { add(m_ops[op], 1); }
+
+   void depth(size_t count) noexcept {
+      if(count > m_highWater.load(std::memory_order_relaxed)) {
+         m_highWater.store(count, std::memory_order_relaxed);
+      }
+   }
+
+   void pages(size_t count) noexcept {
+      if(count > m_peakPages.load(std::memory_order_relaxed)) {
+         m_peakPages.store(count, std::memory_order_relaxed);
+      }
+   }
+
+   time_point now() const noexcept { return std::chrono::steady_clock::now(); }
+
+   void grown(time_point start) noexcept {
+      add(m_grows, 1);
+      add(m_growNanos, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now() - start).count()));
+   }
+
+   void shrunk(size_t pages) noexcept {
+      add(m_shrinks, 1);
+      add(m_shrunkPages, pages);
+   }
+
+   void taken(bool reused) noexcept { add(reused ? m_reusedPages : m_allocatedPages, 1); }
+   void copied() noexcept { add(m_copiedPages, 1); }
+
+   void fill(StackStats& stats) const noexcept {
+      stats.m_highWater = m_highWater.load(std::memory_order_relaxed);
+      stats.m_peakPages = m_peakPages.load(std::memory_order_relaxed);
+      stats.m_grows = m_grows.load(std::memory_order_relaxed);
+      stats.m_growNanos = m_growNanos.load(std::memory_order_relaxed);
+      stats.m_shrinks = m_shrinks.load(std::memory_order_relaxed);
+      stats.m_shrunkPages = m_shrunkPages.load(std::memory_order_relaxed);
+      stats.m_allocatedPages = m_allocatedPages.load(std::memory_order_relaxed);
+      stats.m_reusedPages = m_reusedPages.load(std::memory_order_relaxed);
+      stats.m_copiedPages = m_copiedPages.load(std::memory_order_relaxed);
+      for(int op = 0; op < StackStats::OP_COUNT; ++op) {
+         stats.m_ops[op] = m_ops[op].load(std::memory_order_relaxed);
+      }
+   }
+
+private:
+   // One writer at a time: no need for a locked increment.
+   static void add(std::atomic<uint64_t>& counter, uint64_t value) noexcept {
+      atomicAddOwned(counter, value);
+   }
+
+   std::atomic<uint64_t> m_highWater{0};
+   std::atomic<uint64_t> m_peakPages{0};
+   std::atomic<uint64_t> m_grows{0};
+   std::atomic<uint64_t> m_growNanos{0};
+   std::atomic<uint64_t> m_shrinks{0};
+   std::atomic<uint64_t> m_shrunkPages{0};
+   std::atomic<uint64_t> m_allocatedPages{0};
+   std::atomic<uint64_t> m_reusedPages{0};
+   std::atomic<uint64_t> m_copiedPages{0};
+   std::atomic<uint64_t> m_ops[StackStats::OP_COUNT]{};
+};
+
+
+/**
+ * Instrumentation policy of PagedStack adding to counters of the Statistics
+ * registry.
+ *
+ * The counters are shared by all the stacks using this policy, and written
+ * per thread, so that it can stay on in production: the registry shows the
+ * operations of all the stacks of the process, as falcon_stacks_ops_total
+ * with an op label, and the page counters of StackStats, all named
+ * falcon_stacks_ so as not to clash with the families written by
+ * StackStats::write(). The high-water marks are not kept, and fill()
+ * leaves the counters of the stack empty.
+ */
+class FALCON_API_ stack_statistics {
+public:
+   using time_point = std::chrono::steady_clock::time_point;
+
+   stack_statistics();
+
+   void op(StackStats::Op op) noexcept { m_counters->m_ops[op]->inc(); }
+   void depth(size_t) noexcept {}
+   void pages(size_t) noexcept {}
+   time_point now() const noexcept { return std::chrono::steady_clock::now(); }
+
+   void grown(time_point start) noexcept {
+      m_counters->m_grows->inc();
+      m_counters->m_growNanos->add(static_cast<uint64>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now() - start).count()));
+   }
+
+   void shrunk(size_t pages) noexcept {
+      m_counters->m_shrinks->inc();
+      m_counters->m_shrunkPages->add(pages);
+   }
+
+   void taken(bool reused) noexcept { (reused ? m_counters->m_reusedPages : m_counters->m_allocatedPages)->inc(); }
+   void copied() noexcept { m_counters->m_copiedPages->inc(); }
+   void fill(StackStats&) const noexcept {}
+
+   struct Counters {
+      Counter* m_ops[StackStats::OP_COUNT];
+      Counter* m_grows;
+      Counter* m_growNanos;
+      Counter* m_shrinks;
+      Counter* m_shrunkPages;
+      Counter* m_allocatedPages;
+      Counter* m_reusedPages;
+      Counter* m_copiedPages;
+   };
+
+private:
+   const Counters* m_counters;
+};
+
+}
+
+#endif /* _FALCON_STACKSTATS_H_ */
+
+/* end of stackstats.h */
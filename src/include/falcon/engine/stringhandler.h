@@ -16,18 +16,32 @@
 #define _FALCON_STRINGHANDLER_H_
 
 #include "falcon/engine/deepflatcopyhandler.h"
+#include "falcon/engine/slaballocator.h"
 
 
 namespace falcon {
 
-struct StringHandler: public DeepFlatCopyHandler<String> {
+struct StringHandler: public DeepFlatCopyHandler<String, SlabAllocator> {
     virtual ~StringHandler() {}
 
     String typeName() const noexcept override {return "String";}
-    String toString(ItemData data) const noexcept override { return *reinterpret_cast<String *>(data.ptrValue); }
-
-    bool toBool(ItemData data) const noexcept override { return !reinterpret_cast<String *>(data.ptrValue)->empty(); }
-    int64 toInt(ItemData data) const noexcept override { return std::stoll(*reinterpret_cast<String *>(data.ptrValue)); }
+    String toString(ItemData data) const noexcept override { return payload(data); }
+    void toString(ItemData data, String& out) const noexcept override { out += payload(data); }
+
+    bool toBool(ItemData data) const noexcept override { return !payload(data).empty(); }
+    int64 toInt(ItemData data) const noexcept override { return std::stoll(payload(data)); }
+
+    bool stringView(const ItemData& data, std::string_view& view) const noexcept override {
+        view = payload(data);
+        return true;
+    }
+    size_t hash(ItemData data) const noexcept override { return hashString(payload(data)); }
+    bool equals(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+        return equalsString(payload(data), other, otherData);
+    }
+    int compare(ItemData data, const Handler* other, ItemData otherData) const noexcept override {
+        return compareString(payload(data), other, otherData);
+    }
 };
 
 }
@@ -0,0 +1,125 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: stringpool.h
+
+  Global pool of interned immutable strings
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_STRINGPOOL_H_
+#define _FALCON_STRINGPOOL_H_
+
+#include <falcon/setup.h>
+#include <atomic>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace falcon {
+
+class StringPool;
+
+/**
+ * Immutable string shared through the StringPool.
+ *
+ * There is at most one atom for each distinct string in the pool, so two
+ * atoms are equal if and only if they are the same pointer. The hash of the
+ * string is computed once, when the atom is created.
+ */
+class Atom {
+public:
+   const String& value() const noexcept { return m_value; }
+   size_t hash() const noexcept { return m_hash; }
+   uint32 refCount() const noexcept { return m_refCount.load(std::memory_order_relaxed); }
+
+   /** Acquires a new reference; the caller must already hold one. */
+   void incref() noexcept { m_refCount.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+   Atom(const char* str, size_t len, size_t hash):
+      m_hash(hash),
+      m_value(str, len)
+   {}
+   Atom(const Atom&) = delete;
+   Atom(Atom&&) = delete;
+   ~Atom() = default;
+
+   std::atomic<uint32> m_refCount{1};
+   size_t m_hash;
+   String m_value;
+
+   friend class StringPool;
+};
+
+/**
+ * Concurrent deduplicating pool of immutable strings.
+ *
+ * The pool is split into shards selected by the string hash, each one
+ * protected by its own mutex, so that threads interning different strings
+ * seldom contend.
+ *
+ * Atoms are reference counted; the pool forgets an atom when its last
+ * reference is released. Dropping a reference that is not the last one
+ * doesn't need any lock.
+ */
+class FALCON_API_ StringPool
+{
+public:
+   enum {
+      SHARD_COUNT = 64
+   };
+
+   StringPool() = default;
+   StringPool(const StringPool&) = delete;
+   StringPool(StringPool&&) = delete;
+   ~StringPool();
+
+   /** The pool shared by the whole engine. */
+   static StringPool& global();
+
+   /**
+    * Returns the atom for the given string, creating it if necessary.
+    *
+    * The caller receives a reference that must be given back via release().
+    */
+   Atom* intern(const char* str, size_t len);
+   Atom* intern(const String& str) { return intern(str.data(), str.size()); }
+
+   /** Releases a reference obtained by intern() or Atom::incref(). */
+   void release(Atom* atom) noexcept;
+
+   /** Number of distinct strings currently in the pool. */
+   size_t size() const noexcept;
+
+   static size_t hash(const char* str, size_t len) noexcept {
+      return std::hash<std::string_view>()(std::string_view(str, len));
+   }
+
+private:
+   // The hash is precomputed, so the map just uses it as is.
+   struct IdentityHash {
+      size_t operator()(size_t hash) const noexcept { return hash; }
+   };
+
+   struct Shard {
+      mutable std::mutex m_mtx;
+      std::unordered_multimap<size_t, Atom*, IdentityHash> m_atoms;
+   };
+
+   Shard& shard(size_t hash) noexcept { return m_shards[hash % SHARD_COUNT]; }
+
+   Shard m_shards[SHARD_COUNT];
+};
+
+}
+
+#endif /* _FALCON_STRINGPOOL_H_ */
+
+/* end of stringpool.h */
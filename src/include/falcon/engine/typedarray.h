@@ -0,0 +1,236 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: typedarray.h
+
+  Homogeneous arrays of unboxed numbers
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_TYPEDARRAY_H_
+#define _FALCON_TYPEDARRAY_H_
+
+#include <algorithm>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "falcon/types.h"
+#include "falcon/engine/numformat.h"
+
+namespace falcon {
+
+/**
+ * Stateless allocator returning memory aligned to _Align bytes.
+ */
+template<typename _T, size_t _Align>
+struct AlignedAllocator {
+   using value_type = _T;
+   using is_always_equal = std::true_type;
+
+   template <class U> struct rebind { typedef AlignedAllocator<U, _Align> other; };
+
+   AlignedAllocator() noexcept {}
+   template <typename U>
+   AlignedAllocator(const AlignedAllocator<U, _Align>&) noexcept {}
+
+   _T* allocate(std::size_t size) {
+      return static_cast<_T*>(::operator new(size * sizeof(_T), std::align_val_t(_Align)));
+   }
+
+   void deallocate(_T* data, std::size_t) noexcept {
+      ::operator delete(data, std::align_val_t(_Align));
+   }
+
+   template<typename U>
+   bool operator==(const AlignedAllocator<U, _Align>&) const noexcept { return true; }
+   template<typename U>
+   bool operator!=(const AlignedAllocator<U, _Align>&) const noexcept { return false; }
+};
+
+/**
+ * Array of numbers of the same type, stored unboxed in a contiguous buffer.
+ *
+ * The buffer is aligned to a cache line, and the bulk operations are plain
+ * loops over restrict pointers, without calls or data dependent branches,
+ * so the compiler can vectorize them for the target instruction set.
+ *
+ * The supported element types are int64, numeric and byte.
+ */
+template<typename _T>
+class TypedArray {
+public:
+   static_assert(std::is_same_v<_T, int64> || std::is_same_v<_T, numeric> || std::is_same_v<_T, byte>,
+            "TypedArray supports int64, numeric and byte elements");
+
+   enum {
+      ALIGNMENT = 64
+   };
+
+   using value_type = _T;
+   /** Type of sum(): int64 for the integral elements, numeric for the others. */
+   using sum_type = std::conditional_t<std::is_integral_v<_T>, int64, numeric>;
+   using allocator_type = AlignedAllocator<_T, ALIGNMENT>;
+   using storage_type = std::vector<_T, allocator_type>;
+   using iterator = typename storage_type::iterator;
+   using const_iterator = typename storage_type::const_iterator;
+
+   TypedArray() = default;
+   explicit TypedArray(size_t size, _T value = _T()) : m_data(size, value) {}
+   TypedArray(std::initializer_list<_T> values) : m_data(values) {}
+
+   /** An array of size elements, all set to value; as Array.buffer() in scripts. */
+   static TypedArray buffer(size_t size, _T value) { return TypedArray(size, value); }
+
+   size_t size() const noexcept { return m_data.size(); }
+   bool empty() const noexcept { return m_data.empty(); }
+   _T* data() noexcept { return m_data.data(); }
+   const _T* data() const noexcept { return m_data.data(); }
+
+   _T& operator[](size_t pos) noexcept { return m_data[pos]; }
+   const _T& operator[](size_t pos) const noexcept { return m_data[pos]; }
+
+   iterator begin() noexcept { return m_data.begin(); }
+   iterator end() noexcept { return m_data.end(); }
+   const_iterator begin() const noexcept { return m_data.begin(); }
+   const_iterator end() const noexcept { return m_data.end(); }
+
+   void push_back(_T value) { m_data.push_back(value); }
+   void resize(size_t size, _T value = _T()) { m_data.resize(size, value); }
+   void reserve(size_t size) { m_data.reserve(size); }
+   void clear() noexcept { m_data.clear(); }
+
+   /** Copy of the elements in [begin, end); the limits are clamped to the array size. */
+   TypedArray slice(size_t begin, size_t end) const {
+      end = std::min(end, size());
+      begin = std::min(begin, end);
+      TypedArray result;
+      result.m_data.assign(m_data.begin() + begin, m_data.begin() + end);
+      return result;
+   }
+
+   /**
+    * The element at pos, as a generic item.
+    *
+    * The item layout is a parameter, so that this header doesn't depend on it.
+    */
+   template<typename _Item>
+   _Item itemAt(size_t pos) const { return _Item(m_data[pos]); }
+
+   void fill(_T value) noexcept {
+      _T* __restrict out = data();
+      const size_t count = size();
+      for (size_t i = 0; i < count; ++i) {
+         out[i] = value;
+      }
+   }
+
+   /** Replaces each element with func(element). */
+   template<typename _Func>
+   void map(_Func&& func) {
+      _T* __restrict out = data();
+      const size_t count = size();
+      for (size_t i = 0; i < count; ++i) {
+         out[i] = func(out[i]);
+      }
+   }
+
+   /** Folds the elements left to right, as func(func(init, a[0]), a[1])... */
+   template<typename _Func>
+   _T reduce(_T init, _Func&& func) const {
+      const _T* __restrict in = data();
+      const size_t count = size();
+      for (size_t i = 0; i < count; ++i) {
+         init = func(init, in[i]);
+      }
+      return init;
+   }
+
+   /**
+    * Sum of the elements.
+    *
+    * The sum is kept in sum_type, so that adding bytes (as the result of
+    * compare()) doesn't wrap at 256. Uses independent partial sums, which
+    * the compiler can keep in vector lanes; for floating point values the
+    * rounding may then differ from a left to right sum.
+    */
+   sum_type sum() const noexcept {
+      enum { LANES = 8 };
+      const _T* __restrict in = data();
+      const size_t count = size();
+      sum_type partial[LANES] = {};
+      size_t i = 0;
+      for (; i + LANES <= count; i += LANES) {
+         for (size_t lane = 0; lane < LANES; ++lane) {
+            partial[lane] += in[i + lane];
+         }
+      }
+      sum_type total = sum_type();
+      for (; i < count; ++i) {
+         total += in[i];
+      }
+      for (size_t lane = 0; lane < LANES; ++lane) {
+         total += partial[lane];
+      }
+      return total;
+   }
+
+   /**
+    * Applies pred to the pairs of elements of this and the other array.
+    *
+    * The result holds 1 where pred is true and 0 elsewhere, and it's as long
+    * as the shorter of the two arrays.
+    */
+   template<typename _Pred>
+   TypedArray<byte> compare(const TypedArray& other, _Pred&& pred) const {
+      const size_t count = std::min(size(), other.size());
+      TypedArray<byte> result(count);
+      const _T* __restrict left = data();
+      const _T* __restrict right = other.data();
+      byte* __restrict out = result.data();
+      for (size_t i = 0; i < count; ++i) {
+         out[i] = pred(left[i], right[i]) ? 1 : 0;
+      }
+      return result;
+   }
+
+   bool operator==(const TypedArray& other) const noexcept { return m_data == other.m_data; }
+   bool operator!=(const TypedArray& other) const noexcept { return m_data != other.m_data; }
+
+   /** Appends the elements to out, as "[1, 2, 3]". */
+   void toString(String& out) const {
+      out += '[';
+      for (size_t i = 0; i < size(); ++i) {
+         if (i > 0) {
+            out += ", ";
+         }
+         if constexpr (std::is_same_v<_T, numeric>) {
+            appendFloat(out, m_data[i]);
+         }
+         else {
+            appendInt(out, static_cast<int64>(m_data[i]));
+         }
+      }
+      out += ']';
+   }
+
+private:
+   storage_type m_data;
+};
+
+template<typename _T>
+struct is_typed_array: std::false_type {};
+template<typename _T>
+struct is_typed_array<TypedArray<_T>>: std::true_type {};
+
+}
+
+#endif /* _FALCON_TYPEDARRAY_H_ */
+
+/* end of typedarray.h */
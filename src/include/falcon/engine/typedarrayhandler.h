@@ -0,0 +1,58 @@
+/*****************************************************************************
+  FALCON - The Falcon Programming Language
+  FILE: typedarrayhandler.h
+
+  Handler for homogeneous typed array items.
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin : 
+  Touch : 
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+#ifndef _FALCON_TYPEDARRAYHANDLER_H_
+#define _FALCON_TYPEDARRAYHANDLER_H_
+
+#include "falcon/engine/typedarray.h"
+#include "falcon/engine/deephandler.h"
+
+namespace falcon {
+
+/**
+ * Handler for TypedArray items.
+ *
+ * Arrays are deep: copies of the item refer to the same array, and
+ * changes done through any of them are seen by all.
+ */
+template<typename _T>
+struct TypedArrayHandler final: public DeepHandler<TypedArray<_T>> {
+  using Base = DeepHandler<TypedArray<_T>>;
+
+  virtual ~TypedArrayHandler() {}
+
+  String typeName() const noexcept override {
+    if constexpr (std::is_same_v<_T, int64>) {
+      return "IntArray";
+    } else if constexpr (std::is_same_v<_T, numeric>) {
+      return "FloatArray";
+    } else {
+      return "ByteArray";
+    }
+  }
+
+  String toString(ItemData data) const noexcept override {
+    String out;
+    Base::payload(data).toString(out);
+    return out;
+  }
+  void toString(ItemData data, String& out) const noexcept override { Base::payload(data).toString(out); }
+
+  bool toBool(ItemData data) const noexcept override { return ! Base::payload(data).empty(); }
+  int64 toInt(ItemData data) const noexcept override { return static_cast<int64>(Base::payload(data).size()); }
+};
+
+}
+
+#endif
@@ -2,7 +2,7 @@
   FALCON2 - The Falcon Programming Language
   FILE: futex.h
 
-  Lightweight non-blocking mutex
+  Lightweight mutexes
   -------------------------------------------------------------------
   Author: Giancarlo Niccolai
   Begin : Fri, 12 Apr 2019 13:01:55 +0100
@@ -16,13 +16,69 @@
 #ifndef _FALCON_FUTEX_H_
 #define _FALCON_FUTEX_H_
 
+#include <falcon/setup.h>
+#include <falcon/atomic.h>
+#include <falcon/lockprofile.h>
 #include <atomic>
+#include <climits>
+#include <functional>
 #include <thread>
-#include <iostream>
-
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace falcon {
+
+/**
+ * Tells the CPU that the thread is spinning.
+ *
+ * It lets the other hyperthread of the core run, and avoids the pipeline
+ * flush when the spin loop exits.
+ */
+inline void cpuRelax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+   __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+   asm volatile("yield");
+#elif defined(_MSC_VER)
+   _mm_pause();
+#endif
+}
+
+/**
+ * Puts the thread to sleep while word holds expected.
+ *
+ * On Linux, this is the futex(2) FUTEX_WAIT operation; the thread can be
+ * woken spuriously. On other systems, the thread just yields.
+ */
+FALCON_API_ void futexWait(std::atomic<int>& word, int expected) noexcept;
+
+/** Wakes up to count threads sleeping in futexWait() on word. */
+FALCON_API_ void futexWake(std::atomic<int>& word, int count) noexcept;
+
+/** Small number identifying the calling thread, starting from 1. */
+class ThreadOrdinal {
+   static std::atomic<unsigned int> s_count;
+   static thread_local unsigned int s_ordinal;
+
+public:
+   static unsigned int get() noexcept {
+      if (s_ordinal == 0) {
+         s_ordinal = ++s_count;
+      }
+      return s_ordinal;
+   }
+};
+
+/*
+ * All the futexes take a profiling policy, _Profile, recording their
+ * contention: no_lock_profile or lock_profile (see lockprofile.h). The
+ * policy is a base class of the futex, taking no room when empty, and
+ * profile() returns it.
+ */
+
 /**
  * Lightweight non-blocking mutex.
  *
@@ -36,8 +92,8 @@ namespace falcon {
  * With more than one, the a contended lock is idle-spun down to zero,
  * and if still unsuccessful, the thread is yielded.
  */
-template<unsigned int spinCount=0>
-class Futex {
+template<unsigned int spinCount=0, typename _Profile=default_lock_profile>
+class Futex: private _Profile {
    std::atomic<bool> m_owned{false};
 
 public:
@@ -47,6 +103,28 @@ public:
    ~Futex() {}
 
    void lock() noexcept {
+      bool isOwned = false;
+      if(!m_owned.compare_exchange_strong(isOwned, true, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+         lockContended();
+      }
+      profile().acquired();
+   }
+
+   void unlock() noexcept {
+      m_owned.store(false, std::memory_order_release);
+   }
+
+   bool isLocked() noexcept {
+      return m_owned.load(std::memory_order_acquire);
+   }
+
+   _Profile& profile() noexcept { return *this; }
+
+private:
+   void lockContended() noexcept {
+      auto start = profile().now();
+      uint64_t spins = 0;
+      bool yielded = false;
       bool isOwned = false;
       unsigned int sc = spinCount;
       while(!m_owned.compare_exchange_weak(
@@ -54,65 +132,468 @@ public:
             std::memory_order_acq_rel,
             std::memory_order_relaxed) || isOwned ) {
          isOwned = false;
+         ++spins;
 
          if(spinCount && --sc == 0) {
             std::this_thread::yield();
+            yielded = true;
          }
       }
+      profile().waited(start, spins, yielded);
+   }
+};
+
+
+/**
+ * Mutex spinning for a short while, and then sleeping.
+ *
+ * A contended lock is spun for up to spinCount rounds, relaxing the CPU
+ * at each round; if it's still owned, the thread sleeps in the kernel
+ * until the owner releases it. Threads waiting for an owner that was
+ * descheduled don't burn their core.
+ *
+ * The state is 0 when the mutex is free, 1 when it's owned, and 2 when it's
+ * owned and some thread might be sleeping on it; only in this case unlock()
+ * enters the kernel to wake one of them.
+ */
+template<unsigned int spinCount=100, typename _Profile=default_lock_profile>
+class BlockingFutex: private _Profile {
+   std::atomic<int> m_state{0};
+
+public:
+   BlockingFutex() {}
+   BlockingFutex(const BlockingFutex& )= delete;
+   BlockingFutex(BlockingFutex&& )= delete;
+   ~BlockingFutex() {}
+
+   void lock() noexcept {
+      int state = 0;
+      if(!m_state.compare_exchange_strong(state, 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+         lockContended(state);
+      }
+      profile().acquired();
+   }
+
+   bool try_lock() noexcept {
+      int state = 0;
+      if(m_state.compare_exchange_strong(state, 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+         profile().acquired();
+         return true;
+      }
+      return false;
    }
 
    void unlock() noexcept {
-      m_owned.store(false, std::memory_order_release);
+      if(m_state.exchange(0, std::memory_order_release) == 2) {
+         futexWake(m_state, 1);
+      }
    }
 
    bool isLocked() noexcept {
-      return m_owned.load(std::memory_order_acquire);
+      return m_state.load(std::memory_order_acquire) != 0;
+   }
+
+   _Profile& profile() noexcept { return *this; }
+
+private:
+   void lockContended(int state) noexcept {
+      auto start = profile().now();
+      for(unsigned int spin = 0; spin < spinCount; ++spin) {
+         if(state == 0 && m_state.compare_exchange_weak(state, 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+            profile().waited(start, spin, false);
+            return;
+         }
+         cpuRelax();
+         state = m_state.load(std::memory_order_relaxed);
+      }
+
+      // From here on, we might sleep: the owner must wake us.
+      if(state != 2) {
+         state = m_state.exchange(2, std::memory_order_acquire);
+      }
+      while(state != 0) {
+         futexWait(m_state, 2);
+         state = m_state.exchange(2, std::memory_order_acquire);
+      }
+      profile().waited(start, spinCount, true);
    }
 };
 
 
-class RFutex {
-   static std::atomic<unsigned int> s_count;
-   static thread_local unsigned int s_thread_id;
+/**
+ * Recursive mutex, sleeping when contended as BlockingFutex.
+ *
+ * The owner can lock it again; it's released when unlocked as many times.
+ */
+template<typename _Profile=default_lock_profile>
+class BasicRFutex {
+   BlockingFutex<100, _Profile> m_lock;
+   // Written only by the owner: a thread reads its own id only if it's the owner.
    std::atomic<unsigned int> m_owner{0};
    unsigned int m_count{0};
 
+   static unsigned int threadId() noexcept {
+      return ThreadOrdinal::get();
+   }
+
 public:
-   RFutex() {}
-   RFutex(const RFutex& )= delete;
-   RFutex(RFutex&& )= delete;
-   ~RFutex() {}
+   BasicRFutex() {}
+   BasicRFutex(const BasicRFutex& )= delete;
+   BasicRFutex(BasicRFutex&& )= delete;
+   ~BasicRFutex() {}
 
    void lock() noexcept {
-      if (s_thread_id == 0) {
-         s_thread_id = ++s_count;
+      unsigned int thread_id = threadId();
+      if(m_owner.load(std::memory_order_relaxed) != thread_id) {
+         m_lock.lock();
+         m_owner.store(thread_id, std::memory_order_relaxed);
       }
+      ++m_count;
+   }
 
-      unsigned int free = 0;
-      unsigned int thread_id = s_thread_id;
-
-      while(!m_owner.compare_exchange_strong(
-            free, thread_id,
-            std::memory_order_seq_cst,
-            std::memory_order_seq_cst) || free != thread_id) {
-         free = 0;
+   bool try_lock() noexcept {
+      unsigned int thread_id = threadId();
+      if(m_owner.load(std::memory_order_relaxed) != thread_id) {
+         if(!m_lock.try_lock()) {
+            return false;
+         }
+         m_owner.store(thread_id, std::memory_order_relaxed);
       }
       ++m_count;
+      return true;
    }
 
    void unlock() noexcept {
       if(m_count > 0 && --m_count == 0) {
-         m_owner.store(0, std::memory_order_seq_cst);
+         m_owner.store(0, std::memory_order_relaxed);
+         m_lock.unlock();
       }
    }
 
    bool isLocked() noexcept {
-      return m_owner.load(std::memory_order_seq_cst) != 0;
+      return m_lock.isLocked();
    }
 
    bool isOwner() noexcept {
-      return m_owner.load(std::memory_order_seq_cst) == s_thread_id;
+      return m_owner.load(std::memory_order_relaxed) == threadId();
+   }
+
+   /** The profile of the lock, counting the first acquisitions of the owner only. */
+   _Profile& profile() noexcept { return m_lock.profile(); }
+};
+
+using RFutex = BasicRFutex<>;
+
+
+
+/**
+ * Wakes a consumer thread, only when it's sleeping.
+ *
+ * The consumer calls wait() when it runs out of work, and producers call
+ * ring() after publishing some. While the consumer is busy, ring() costs
+ * a fence and a load; it enters the kernel only to wake the consumer up.
+ * There can be many producers, but only one consumer.
+ */
+class Doorbell {
+public:
+   Doorbell() {}
+   Doorbell(const Doorbell& )= delete;
+   ~Doorbell() {}
+
+   void ring() noexcept {
+      // the work published before must be seen by the consumer, or we must
+      // see it sleeping.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if(m_sleeping.load(std::memory_order_relaxed) != 0 && m_sleeping.exchange(0) != 0) {
+         futexWake(m_sleeping, 1);
+      }
+   }
+
+   /**
+    * Sleeps, unless hasWork() finds something to do.
+    *
+    * hasWork() is called after the consumer declared itself sleeping, so
+    * that no ring() is lost. The consumer can wake up spuriously.
+    */
+   template<typename _Pred>
+   void wait(_Pred hasWork) noexcept {
+      m_sleeping.store(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if(!hasWork()) {
+         futexWait(m_sleeping, 1);
+      }
+      m_sleeping.store(0, std::memory_order_relaxed);
+   }
+
+   bool isSleeping() noexcept {
+      return m_sleeping.load(std::memory_order_relaxed) != 0;
    }
+
+private:
+   std::atomic<int> m_sleeping{0};
+};
+
+
+/**
+ * Reader-writer mutex, preferring writers.
+ *
+ * Readers announce themselves on one of SLOTS counters, chosen by thread,
+ * each on its own cache line: readers on different threads seldom write
+ * the same line. A writer raises its flag and waits for the counters to
+ * drain; readers arriving meanwhile step back, and sleep until the writer
+ * is done. Writers wait for each other on a BlockingFutex.
+ *
+ * The mutex is not recursive: a reader locking it again while a writer
+ * waits deadlocks. Usable with std::shared_lock.
+ *
+ * The profile counts the acquisitions of readers and writers alike, and
+ * the waits of both: readers for the writer, writers for each other and
+ * for the readers.
+ */
+template<typename _Profile=default_lock_profile>
+class BasicRWFutex: private _Profile {
+public:
+   enum {
+      SLOTS = 16,
+      SPIN_COUNT = 100
+   };
+
+   BasicRWFutex() {}
+   BasicRWFutex(const BasicRWFutex& )= delete;
+   BasicRWFutex(BasicRWFutex&& )= delete;
+   ~BasicRWFutex() {}
+
+   void lock_shared() noexcept {
+      std::atomic<int>& slot = m_slots[readerSlot()];
+      slot.fetch_add(1);
+      if(m_writer.load() != 0) {
+         lockSharedContended(slot);
+      }
+      profile().acquired();
+   }
+
+   bool try_lock_shared() noexcept {
+      std::atomic<int>& slot = m_slots[readerSlot()];
+      slot.fetch_add(1);
+      if(m_writer.load() != 0) {
+         leave(slot);
+         return false;
+      }
+      profile().acquired();
+      return true;
+   }
+
+   void unlock_shared() noexcept {
+      leave(m_slots[readerSlot()]);
+   }
+
+   void lock() noexcept {
+      auto start = profile().now();
+      bool contended = false;
+      if(!m_writers.try_lock()) {
+         contended = true;
+         m_writers.lock();
+      }
+      m_writer.store(1);
+      uint64_t spins = 0;
+      bool slept = false;
+      if(readersIn()) {
+         contended = true;
+         slept = waitReaders(spins);
+      }
+      if(contended) {
+         // Sleeping on the other writers counts as spinning.
+         profile().waited(start, spins, slept);
+      }
+      profile().acquired();
+   }
+
+   bool try_lock() noexcept {
+      if(!m_writers.try_lock()) {
+         return false;
+      }
+      m_writer.store(1);
+      if(readersIn()) {
+         unlock();
+         return false;
+      }
+      profile().acquired();
+      return true;
+   }
+
+   void unlock() noexcept {
+      if(m_writer.exchange(0) == 2) {
+         futexWake(m_writer, INT_MAX);
+      }
+      m_writers.unlock();
+   }
+
+   /** True if a writer holds the mutex, or is waiting for the readers. */
+   bool isLocked() noexcept {
+      return m_writer.load(std::memory_order_acquire) != 0;
+   }
+
+   _Profile& profile() noexcept { return *this; }
+
+private:
+   // All the accesses to the counters and the flag are sequentially
+   // consistent: a reader must see the flag of a writer, or the writer
+   // must see the reader.
+   PaddedAtomic<int> m_slots[SLOTS];
+   // 0: no writer; 1: a writer; 2: a writer, and readers might be sleeping.
+   alignas(CACHE_LINE_SIZE) std::atomic<int> m_writer{0};
+   // Changed when a reader leaves while a writer waits.
+   std::atomic<int> m_drain{0};
+   // Not profiled on its own: its waits are the waits of the writers.
+   BlockingFutex<100, no_lock_profile> m_writers;
+
+   static unsigned int readerSlot() noexcept {
+      return ThreadOrdinal::get() % SLOTS;
+   }
+
+   bool readersIn() noexcept {
+      for(const PaddedAtomic<int>& slot: m_slots) {
+         if(slot.load() != 0) {
+            return true;
+         }
+      }
+      return false;
+   }
+
+   void leave(std::atomic<int>& slot) noexcept {
+      slot.fetch_sub(1);
+      if(m_writer.load() != 0) {
+         m_drain.fetch_add(1);
+         futexWake(m_drain, 1);
+      }
+   }
+
+   void lockSharedContended(std::atomic<int>& slot) noexcept {
+      auto start = profile().now();
+      uint64_t spins = 0;
+      bool slept = false;
+      do {
+         // let the writer go first.
+         leave(slot);
+         slept = waitWriter(spins) || slept;
+         slot.fetch_add(1);
+      }
+      while(m_writer.load() != 0);
+      profile().waited(start, spins, slept);
+   }
+
+   /** Waits for the writer to be done, adding the rounds spun to spins; true if it slept. */
+   bool waitWriter(uint64_t& spins) noexcept {
+      for(unsigned int spin = 0; spin < SPIN_COUNT; ++spin, ++spins) {
+         if(m_writer.load(std::memory_order_relaxed) == 0) {
+            return false;
+         }
+         cpuRelax();
+      }
+      int state = m_writer.load();
+      while(state != 0) {
+         if(state == 1 && !m_writer.compare_exchange_strong(state, 2)) {
+            continue;
+         }
+         futexWait(m_writer, 2);
+         state = m_writer.load();
+      }
+      return true;
+   }
+
+   /** Waits for the readers to leave, adding the rounds spun to spins; true if it slept. */
+   bool waitReaders(uint64_t& spins) noexcept {
+      for(unsigned int spin = 0; spin < SPIN_COUNT; ++spin, ++spins) {
+         if(!readersIn()) {
+            return false;
+         }
+         cpuRelax();
+      }
+      while(true) {
+         int drain = m_drain.load();
+         if(!readersIn()) {
+            return true;
+         }
+         futexWait(m_drain, drain);
+      }
+   }
+};
+
+using RWFutex = BasicRWFutex<>;
+
+
+/**
+ * Array of locks, chosen by the hash of a key.
+ *
+ * Tables split in as many shards as the locks lock only the shard holding a
+ * key, so that threads working on different keys seldom wait for each
+ * other. Each lock has its own cache line. _Lock can be any lockable,
+ * RWFutex included.
+ *
+ * Operations on the whole table take all the locks, always in the same
+ * order, through lockAll().
+ *
+ * The locks are profiled by their own policy; LOCK_PROFILE on the sharded
+ * futex names all of them, and the dump adds their counters up.
+ */
+template<typename _Lock = BlockingFutex<>, unsigned int shards = 16>
+class ShardedFutex {
+public:
+   static constexpr unsigned int SHARDS = shards;
+
+   ShardedFutex() {}
+   ShardedFutex(const ShardedFutex& )= delete;
+   ShardedFutex(ShardedFutex&& )= delete;
+   ~ShardedFutex() {}
+
+   /** The shard of a hash value; the high bits are mixed in, as many hashes vary only there. */
+   static unsigned int shardOf(size_t hash) noexcept {
+      // mixed on 64 bits, as size_t can be 32 bits wide.
+      uint64 mixed = hash;
+      mixed ^= mixed >> 32;
+      mixed ^= mixed >> 16;
+      return static_cast<unsigned int>(mixed % shards);
+   }
+
+   _Lock& shard(unsigned int index) noexcept { return m_shards[index].m_lock; }
+   _Lock& forHash(size_t hash) noexcept { return shard(shardOf(hash)); }
+
+   template<typename _Key>
+   _Lock& forKey(const _Key& key) noexcept { return forHash(std::hash<_Key>()(key)); }
+
+   void lockAll() noexcept {
+      for(Shard& shard: m_shards) {
+         shard.m_lock.lock();
+      }
+   }
+
+   void unlockAll() noexcept {
+      for(unsigned int index = shards; index-- > 0;) {
+         m_shards[index].m_lock.unlock();
+      }
+   }
+
+   /** Names all the locks at once; see LOCK_PROFILE. */
+   class Profile {
+   public:
+      void site(const char* name, const char* file, int line) noexcept {
+         for(Shard& shard: m_owner->m_shards) {
+            shard.m_lock.profile().site(name, file, line);
+         }
+      }
+   private:
+      explicit Profile(ShardedFutex* owner) noexcept: m_owner(owner) {}
+      ShardedFutex* m_owner;
+      friend class ShardedFutex;
+   };
+
+   Profile profile() noexcept { return Profile(this); }
+
+private:
+   struct alignas(CACHE_LINE_SIZE) Shard {
+      _Lock m_lock;
+   };
+   Shard m_shards[shards];
 };
 
 }
@@ -0,0 +1,179 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: lockprofile.h
+
+  Contention profiling policies of the futexes
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_LOCKPROFILE_H_
+#define _FALCON_LOCKPROFILE_H_
+
+#include <falcon/setup.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace falcon {
+
+/** Snapshot of the contention counters of a lock. */
+struct FALCON_API_ LockStats {
+   enum {
+      /**
+       * Buckets of the wait time histogram. Bucket i counts the waits
+       * shorter than 2^(i+7) nanoseconds, from 128ns to about half a second;
+       * the last one counts the longer waits.
+       */
+      BUCKETS = 24
+   };
+
+   /** Name given to the lock, and where; null if never given. */
+   const char* m_name{nullptr};
+   const char* m_file{nullptr};
+   int m_line{0};
+   /** Address of the profile, within the lock: names it in write() when it has no name. */
+   const void* m_lock{nullptr};
+
+   /** Times the lock was taken. */
+   uint64_t m_acquisitions{0};
+   /** Times the lock was found owned, and waited for. */
+   uint64_t m_contended{0};
+   /** Rounds spun waiting for the lock. */
+   uint64_t m_spins{0};
+   /** Waits that ended up sleeping in the kernel (or yielding). */
+   uint64_t m_sleeps{0};
+   /** Time spent waiting, overall and per bucket. */
+   uint64_t m_waitNanos{0};
+   uint64_t m_waits[BUCKETS]{};
+
+   /** The bucket of a wait lasting nanos nanoseconds. */
+   static unsigned int bucketOf(uint64_t nanos) noexcept;
+
+   /**
+    * Writes the stats in the Prometheus text format.
+    *
+    * Each sample is labelled with lock="name" and site="file:line"; the
+    * names of the metrics start with falcon_lock_, and the wait times are a
+    * histogram in seconds. The output is a whole exposition, with the
+    * TYPE lines: use writeAll() to dump several locks together.
+    */
+   void write(std::ostream& out) const;
+
+   /**
+    * Writes the stats of all the profiled locks alive.
+    *
+    * This is the registry dump: run it when the throughput collapses, and
+    * look at the locks with the longest waits. Each metric family is
+    * written once, with the samples of all the locks. The locks with the
+    * same name and site are written as one, adding their counters up.
+    */
+   static void writeAll(std::ostream& out);
+};
+
+
+/**
+ * Profiling policy of the futexes recording nothing.
+ *
+ * All the calls are empty, and disappear when inlined.
+ */
+class no_lock_profile {
+public:
+   using time_point = int;
+
+   void site(const char*, const char*, int) noexcept {}
+   void acquired() noexcept {}
+   time_point now() const noexcept { return 0; }
+   void waited(time_point, uint64_t, bool) noexcept {}
+   void fill(LockStats&) const noexcept {}
+};
+
+
+/**
+ * Profiling policy of the futexes recording the counters of LockStats.
+ *
+ * Each lock using it is listed in a global registry while it lives, and
+ * dumped by LockStats::writeAll(). The counters are shared by all the
+ * threads taking the lock, so that every acquisition costs a locked
+ * increment: use it to look for contention, not in production.
+ */
+class FALCON_API_ lock_profile {
+public:
+   using time_point = std::chrono::steady_clock::time_point;
+
+   lock_profile();
+   lock_profile(const lock_profile&) = delete;
+   ~lock_profile();
+
+   /** Names the lock; see LOCK_PROFILE. */
+   void site(const char* name, const char* file, int line) noexcept {
+      m_name.store(name, std::memory_order_relaxed);
+      m_file.store(file, std::memory_order_relaxed);
+      m_line.store(line, std::memory_order_relaxed);
+   }
+
+   void acquired() noexcept { m_acquisitions.fetch_add(1, std::memory_order_relaxed); }
+
+   time_point now() const noexcept { return std::chrono::steady_clock::now(); }
+
+   /** A thread waited since start, spinning spins rounds, before getting the lock. */
+   void waited(time_point start, uint64_t spins, bool slept) noexcept {
+      uint64_t nanos = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now() - start).count());
+      m_contended.fetch_add(1, std::memory_order_relaxed);
+      m_spins.fetch_add(spins, std::memory_order_relaxed);
+      if(slept) {
+         m_sleeps.fetch_add(1, std::memory_order_relaxed);
+      }
+      m_waitNanos.fetch_add(nanos, std::memory_order_relaxed);
+      m_waits[LockStats::bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+   }
+
+   void fill(LockStats& stats) const noexcept;
+
+private:
+   friend struct LockStats;
+
+   std::atomic<const char*> m_name{nullptr};
+   std::atomic<const char*> m_file{nullptr};
+   std::atomic<int> m_line{0};
+   std::atomic<uint64_t> m_acquisitions{0};
+   std::atomic<uint64_t> m_contended{0};
+   std::atomic<uint64_t> m_spins{0};
+   std::atomic<uint64_t> m_sleeps{0};
+   std::atomic<uint64_t> m_waitNanos{0};
+   std::atomic<uint64_t> m_waits[LockStats::BUCKETS]{};
+
+   // links of the registry.
+   lock_profile* m_prev{nullptr};
+   lock_profile* m_next{nullptr};
+};
+
+
+/**
+ * Policy of the futexes when not given explicitly.
+ *
+ * Building with FALCON_PROFILE_LOCKS profiles all the engine locks.
+ */
+#ifdef FALCON_PROFILE_LOCKS
+using default_lock_profile = lock_profile;
+#else
+using default_lock_profile = no_lock_profile;
+#endif
+
+}
+
+/** Names a lock in the profile, with the place where this is written. */
+#define LOCK_PROFILE(__LOCK, __NAME) ((__LOCK).profile().site(__NAME, __FILE__, __LINE__))
+
+#endif /* _FALCON_LOCKPROFILE_H_ */
+
+/* end of lockprofile.h */
@@ -17,12 +17,16 @@
 #define _FALCON_LOGSYSTEM_H_
 
 #include <falcon/setup.h>
+#include <falcon/atomic.h>
+#include <falcon/futex.h>
+#include <falcon/mpscring.h>
+#include <falcon/statistics.h>
 #include <atomic>
-#include <condition_variable>
 #include <deque>
 #include <memory>
 #include <mutex>
 #include <regex>
+#include <shared_mutex>
 #include <string>
 #include <thread>
 #include <iostream>
@@ -109,7 +113,9 @@ public:
 		  m_level(LEVEL::TRACE),
 		  m_enabled(true),
 		  m_detached(false)
-	  {}
+	  {
+		  LOCK_PROFILE(m_mtxCategory, "LogSystem::Listener::category");
+	  }
       Listener(const Listener& ) = delete;
       Listener(Listener&& ) = delete;
       virtual ~Listener() = default;
@@ -121,7 +127,7 @@ public:
        */
       void category( const std::string& regex_cat )
       {
-    	  std::lock_guard<std::mutex> guard(m_mtxCategory);
+    	  std::lock_guard<RWFutex> guard(m_mtxCategory);
     	  // may throw in case of error
     	  try{
 			  m_catRegex = std::regex(regex_cat);
@@ -136,7 +142,7 @@ public:
        * Returns the current category filter
        */
       const std::string& category() const noexcept {
-    	  std::lock_guard<std::mutex> guard(m_mtxCategory);
+    	  std::shared_lock<RWFutex> guard(m_mtxCategory);
     	  return m_category;
       }
 
@@ -157,10 +163,10 @@ public:
        * @note As this method is not synchronised, time might pass before
        * the filter level change is actually enforced.
        */
-      void level(LEVEL l) noexcept {m_level = l;}
+      void level(LEVEL l) noexcept {atomicSet(m_level, l, std::memory_order_relaxed);}
 
       /** Get the current minimum log level */
-      LEVEL level() const noexcept {return m_level;}
+      LEVEL level() const noexcept {return atomicFetch(m_level, std::memory_order_relaxed);}
 
       bool isDetached() const noexcept {return m_detached;}
 
@@ -168,7 +174,8 @@ public:
       virtual void onMessage( const Message& msg ) = 0;
 
    private:
-      mutable std::mutex m_mtxCategory;
+      // read for every message, written when the filter changes.
+      mutable RWFutex m_mtxCategory;
       std::string m_category;
       std::regex m_catRegex;
       std::atomic<LEVEL> m_level;
@@ -215,10 +222,10 @@ public:
     * @note As this method is not synchronised, time might pass before
     * the filter level change is actually enforced.
     */
-   void level(LEVEL l) noexcept {m_level = l;}
+   void level(LEVEL l) noexcept {atomicSet(m_level, l, std::memory_order_relaxed);}
 
    /** Get the current minimum log level */
-   LEVEL level() const noexcept {return m_level;}
+   LEVEL level() const noexcept {return atomicFetch(m_level, std::memory_order_relaxed);}
 
    /** Starts the service */
    void start();
@@ -229,7 +236,14 @@ public:
 
    /** Maximum number of pre-allocated message */
    enum {
-	   MESSAGE_POOL_THRESHOLD = 64
+	   MESSAGE_POOL_THRESHOLD = 64,
+	   /**
+	    * Messages waiting for the logging thread; more make log() wait, or
+	    * are dropped if the thread is not running.
+	    */
+	   MESSAGE_QUEUE_SIZE = 4096,
+	   /** Messages taken by the logging thread at each round. */
+	   MESSAGE_BATCH = 64
    };
 
    /** Stucture used for reporting the internal status of the logger.
@@ -242,6 +256,7 @@ public:
 
 	   size_t m_msgsCreated;
 	   size_t m_msgsDiscarded;
+	   size_t m_msgsDropped;
 	   size_t m_pendingListeners;
 	   size_t m_activeListeners;
 	   size_t m_enabledListeners;
@@ -257,27 +272,31 @@ private:
 
    void loggingThread() noexcept;
    Message* allocateMsg();
-   void disposeMsg(Message*) noexcept;
+   void disposeMsgs(Message** msgs, size_t count) noexcept;
    void cleanupTerminatedListeners();
    void sendMessageToListeners(Message* msg) noexcept;
    void processNewListeners() noexcept;
 
    /* Current log level */
    std::atomic<LEVEL> m_level;
-   std::atomic<size_t> m_unpooled;
-   std::atomic<size_t> m_destroyed;
-   size_t m_maxMsgQueueSize;
-   size_t m_msgReceived;
-
-
-   using MessageQueue = std::deque<Message*>;
-   MessageQueue m_messages;
-   bool m_isTerminated;
-   std::condition_variable m_cvLogs;
-   mutable std::mutex m_mtxMessage;
+   Counter m_unpooled;
+   Counter m_destroyed;
+   std::atomic<size_t> m_maxMsgQueueSize;
+   Counter m_msgReceived;
+   Counter m_queueFull;
+   Counter m_dropped;
+
+   // Filled by the logging threads, emptied by the log thread.
+   MPSCRing<Message*> m_messages;
+   std::atomic<bool> m_isTerminated;
+   // True while a log thread empties the queue.
+   std::atomic<bool> m_isRunning;
+   // Wakes the log thread, when it's sleeping.
+   Doorbell m_doorbell;
 
    mutable std::mutex m_mtxPool;
-   MessageQueue m_pool;
+   using MessagePool = std::deque<Message*>;
+   MessagePool m_pool;
 
 
    using ListenerList = std::deque<std::shared_ptr<Listener>>;
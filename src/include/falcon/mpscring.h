@@ -0,0 +1,162 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: mpscring.h
+
+  Bounded lock-free queue with many producers and one consumer
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_MPSCRING_H_
+#define _FALCON_MPSCRING_H_
+
+#include <falcon/setup.h>
+#include <falcon/atomic.h>
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+
+namespace falcon {
+
+/**
+ * Bounded lock-free queue, filled by many threads and emptied by one.
+ *
+ * Each cell carries a sequence number telling whose turn it is. Producers
+ * claim a position by advancing the tail with a CAS, fill its cell, and
+ * publish it by bumping the sequence; the consumer takes the cells in
+ * order, and hands them back to the producers of the next round by
+ * bumping the sequence again. A producer descheduled between claiming and
+ * publishing holds back the consumer, but not the other producers.
+ *
+ * The capacity is rounded up to a power of two. The values are copied in
+ * and out of the cells, and must be trivially copyable (as pointers).
+ */
+template<typename _T>
+class MPSCRing {
+   static_assert(std::is_trivially_copyable<_T>::value, "MPSCRing values must be trivially copyable");
+
+public:
+   explicit MPSCRing(size_t capacity):
+      m_capacity(roundUp(capacity)),
+      m_mask(m_capacity - 1),
+      m_cells(new Cell[m_capacity])
+   {
+      for(size_t pos = 0; pos < m_capacity; ++pos) {
+         m_cells[pos].m_seq.store(pos, std::memory_order_relaxed);
+      }
+   }
+
+   MPSCRing(const MPSCRing&) = delete;
+   ~MPSCRing() {}
+
+   /**
+    * Adds a value; any thread can call it.
+    *
+    * Returns the number of values in the queue after this one was added,
+    * as seen by this thread, or 0 if the queue is full.
+    */
+   size_t push(const _T& value) noexcept {
+      size_t pos = m_tail.load(std::memory_order_relaxed);
+      while(true) {
+         // the consumer can't be past an unclaimed position.
+         size_t head = m_head.load(std::memory_order_relaxed);
+         Cell& cell = m_cells[pos & m_mask];
+         size_t seq = cell.m_seq.load(std::memory_order_acquire);
+         if(seq == pos) {
+            if(m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+               cell.m_value = value;
+               cell.m_seq.store(pos + 1, std::memory_order_release);
+               return std::min(pos + 1 - std::min(head, pos), m_capacity);
+            }
+         }
+         else if(seq < pos) {
+            // the consumer hasn't taken this cell in the previous round yet.
+            return 0;
+         }
+         else {
+            pos = m_tail.load(std::memory_order_relaxed);
+         }
+      }
+   }
+
+   /** Takes the oldest value, if any; only the consumer can call it. */
+   bool pop(_T& value) noexcept {
+      return pop(&value, 1) == 1;
+   }
+
+   /**
+    * Takes up to count values, oldest first; only the consumer can call it.
+    *
+    * Returns the number of values taken.
+    */
+   size_t pop(_T* values, size_t count) noexcept {
+      size_t head = m_head.load(std::memory_order_relaxed);
+      size_t taken = 0;
+      while(taken < count) {
+         Cell& cell = m_cells[head & m_mask];
+         if(cell.m_seq.load(std::memory_order_acquire) != head + 1) {
+            break;
+         }
+         values[taken++] = cell.m_value;
+         cell.m_seq.store(head + m_capacity, std::memory_order_release);
+         ++head;
+      }
+      if(taken != 0) {
+         m_head.store(head, std::memory_order_relaxed);
+      }
+      return taken;
+   }
+
+   /**
+    * True if the consumer would find nothing to take.
+    *
+    * A value claimed by a producer but not published yet isn't there.
+    */
+   bool empty() const noexcept {
+      size_t head = m_head.load(std::memory_order_relaxed);
+      return m_cells[head & m_mask].m_seq.load(std::memory_order_acquire) != head + 1;
+   }
+
+   /** Number of values in the queue; it can be stale as soon as it's read. */
+   size_t size() const noexcept {
+      size_t head = m_head.load(std::memory_order_relaxed);
+      size_t tail = m_tail.load(std::memory_order_relaxed);
+      return std::min(tail - std::min(head, tail), m_capacity);
+   }
+
+   size_t capacity() const noexcept { return m_capacity; }
+
+private:
+   struct Cell {
+      std::atomic<size_t> m_seq;
+      _T m_value;
+   };
+
+   static size_t roundUp(size_t capacity) noexcept {
+      size_t size = 2;
+      while(size < capacity) {
+         size <<= 1;
+      }
+      return size;
+   }
+
+   const size_t m_capacity;
+   const size_t m_mask;
+   std::unique_ptr<Cell[]> m_cells;
+   // claimed by the producers.
+   PaddedAtomic<size_t> m_tail{0};
+   // written by the consumer only.
+   PaddedAtomic<size_t> m_head{0};
+};
+
+}
+
+#endif /* _FALCON_MPSCRING_H_ */
+
+/* end of mpscring.h */
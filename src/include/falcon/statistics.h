@@ -0,0 +1,168 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: statistics.h
+
+  Per-thread counters and gauges of the engine
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#ifndef _FALCON_STATISTICS_H_
+#define _FALCON_STATISTICS_H_
+
+#include <falcon/setup.h>
+#include <falcon/atomic.h>
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace falcon {
+
+/**
+ * Per-thread slots of the counters.
+ *
+ * Each thread adding to a counter gets a block of MAX_COUNTERS slots, and
+ * each counter owns a slot in all the blocks: a thread adds to its own
+ * slot with a plain load and store, and reading the counter sums the slots
+ * of all the threads. When a thread ends, its slots are added to the
+ * counters they belong to.
+ */
+class ThreadCounters {
+public:
+   enum {
+      MAX_COUNTERS = 512
+   };
+
+   static std::atomic<uint64>* slots() noexcept {
+      if(s_slots == nullptr) {
+         s_slots = attach();
+      }
+      return s_slots;
+   }
+
+private:
+   friend class ThreadCountersBlock;
+   static thread_local std::atomic<uint64>* s_slots;
+
+   FALCON_API_ static std::atomic<uint64>* attach() noexcept;
+};
+
+
+/**
+ * Named counter, published in the Statistics registry while it lives.
+ *
+ * Adding to it costs a thread-local load and store, without locked
+ * instructions or shared cache lines, so that counters can stay in
+ * production builds; reading it is slower, as it takes the registry lock
+ * and sums the slots of all the threads.
+ *
+ * Counters with the same name and labels, as those of several instances
+ * of a class, are written as their sum by Statistics::write().
+ */
+class FALCON_API_ Counter {
+public:
+   /**
+    * Creates a counter.
+    *
+    * The labels, if any, are written as they are between the braces of
+    * the samples, as in `op="push"`.
+    *
+    * Will throw std::length_error if MAX_COUNTERS counters are alive.
+    */
+   Counter(const std::string& name, const std::string& help, const std::string& labels = "");
+   Counter(const Counter&) = delete;
+   ~Counter();
+
+   void add(uint64 value = 1) noexcept {
+      atomicAddOwned(ThreadCounters::slots()[m_index], value);
+   }
+
+   void inc() noexcept { add(1); }
+
+   /** The sum of the slots of all the threads. */
+   uint64 value() const noexcept;
+
+   const std::string& name() const noexcept { return m_name; }
+   const std::string& help() const noexcept { return m_help; }
+   const std::string& labels() const noexcept { return m_labels; }
+
+private:
+   friend class Statistics;
+   friend class ThreadCountersBlock;
+
+   uint64 total() const noexcept;
+
+   std::string m_name;
+   std::string m_help;
+   std::string m_labels;
+   unsigned int m_index;
+   // the slots of the threads that are gone; guarded by the registry lock.
+   uint64 m_retired{0};
+};
+
+
+/**
+ * Named value going up and down, published in the Statistics registry.
+ *
+ * Either set explicitly, or read from a probe function when the registry
+ * is written, so that values already kept elsewhere (as the size of a
+ * queue) cost nothing until looked at. The probe is called under the
+ * registry lock, and must not create or destroy counters or gauges.
+ */
+class FALCON_API_ Gauge {
+public:
+   using probe_type = std::function<int64()>;
+
+   Gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+   Gauge(const std::string& name, const std::string& help, probe_type probe, const std::string& labels = "");
+   Gauge(const Gauge&) = delete;
+   ~Gauge();
+
+   void set(int64 value) noexcept { atomicSet(m_value, value, std::memory_order_relaxed); }
+   void add(int64 value) noexcept { atomicAdd(m_value, value, std::memory_order_relaxed); }
+
+   int64 value() const;
+
+   const std::string& name() const noexcept { return m_name; }
+   const std::string& help() const noexcept { return m_help; }
+   const std::string& labels() const noexcept { return m_labels; }
+
+private:
+   std::string m_name;
+   std::string m_help;
+   std::string m_labels;
+   probe_type m_probe;
+   atomic_int64 m_value{0};
+};
+
+
+/** Registry of the counters and gauges alive. */
+class FALCON_API_ Statistics {
+public:
+   /**
+    * Writes all the counters and gauges in the Prometheus text format.
+    *
+    * The metrics are sorted by name, and those with the same name and
+    * labels are summed.
+    */
+   static void write(std::ostream& out);
+
+   /**
+    * Reads the sum of the counters or gauges with the given name and labels.
+    *
+    * Returns false if there are none.
+    */
+   static bool find(const std::string& name, int64& value, const std::string& labels = "");
+};
+
+}
+
+#endif /* _FALCON_STATISTICS_H_ */
+
+/* end of statistics.h */
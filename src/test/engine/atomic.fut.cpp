@@ -0,0 +1,118 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: atomic.fut.cpp
+
+  Test for the atomic operations
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/atomic.h>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace falcon;
+
+class AtomicTest: public falcon::testing::TestCase
+{
+public:
+   void SetUp() {}
+   void TearDown() {}
+
+   // each thread increments its own counter in counters.
+   template<typename _Counter>
+   void counters_test(_Counter* counters, int threadCount, int perfCount)
+   {
+      std::vector<std::thread> threads;
+      for(int t = 0; t < threadCount; ++t) {
+         threads.emplace_back([=]() {
+            for(int i = 0; i < perfCount; ++i) {
+               atomicInc(counters[t], std::memory_order_relaxed);
+            }
+         });
+      }
+      for(auto& thread: threads) {
+         thread.join();
+      }
+      for(int t = 0; t < threadCount; ++t) {
+         EXPECT_EQ(static_cast<uint64>(perfCount), atomicFetch(counters[t]));
+      }
+   }
+};
+
+TEST_F(AtomicTest, int32)
+{
+   atomic_int value{10};
+   EXPECT_EQ(11, atomicInc(value));
+   EXPECT_EQ(10, atomicDec(value));
+   EXPECT_EQ(15, atomicAdd(value, 5));
+   EXPECT_EQ(15, atomicFetch(value));
+   atomicSet(value, 3);
+   EXPECT_EQ(3, atomicExchange(value, 6));
+   EXPECT_FALSE(atomicCAS(value, 3, 7));
+   EXPECT_TRUE(atomicCAS(value, 6, 7));
+   EXPECT_EQ(7, atomicFetch(value, std::memory_order_relaxed));
+   EXPECT_EQ(7, atomicAnd(value, 3));
+   EXPECT_EQ(3, atomicOr(value, 8));
+   EXPECT_EQ(11, atomicXor(value, 1));
+   EXPECT_EQ(10, atomicFetch(value));
+}
+
+TEST_F(AtomicTest, int64)
+{
+   atomic_uint64 value{0};
+   const uint64 big = uint64(1) << 40;
+   EXPECT_EQ(big, atomicAdd(value, big, std::memory_order_relaxed));
+   EXPECT_EQ(big + 1, atomicInc(value, std::memory_order_relaxed));
+   atomicAddOwned(value, big);
+   EXPECT_EQ(2 * big + 1, atomicFetch(value));
+
+   atomic_int64 negative{0};
+   EXPECT_EQ(-1, atomicDec(negative, std::memory_order_release));
+}
+
+TEST_F(AtomicTest, padded)
+{
+   EXPECT_EQ(CACHE_LINE_SIZE, sizeof(PaddedAtomic<int>));
+   EXPECT_EQ(CACHE_LINE_SIZE, alignof(PaddedAtomic<uint64>));
+
+   PaddedAtomic<uint64> counters[4];
+   EXPECT_EQ(0, atomicFetch(counters[3]));
+   EXPECT_EQ(CACHE_LINE_SIZE, size_t(reinterpret_cast<char*>(&counters[1]) - reinterpret_cast<char*>(&counters[0])));
+   EXPECT_EQ(0, reinterpret_cast<uintptr_t>(&counters[0]) % CACHE_LINE_SIZE);
+
+   PaddedAtomic<int> value(5);
+   EXPECT_EQ(6, atomicInc(value));
+   value = 2;
+   EXPECT_EQ(2, value.load());
+}
+
+TEST_F(AtomicTest, padded_threads)
+{
+   PaddedAtomic<uint64> counters[4];
+   counters_test(counters, 4, 100000);
+}
+
+TEST_F(AtomicTest, perf_test_packed_counters)
+{
+   std::atomic<uint64> counters[4]{};
+   counters_test(counters, 4, 20000000);
+}
+
+TEST_F(AtomicTest, perf_test_padded_counters)
+{
+   PaddedAtomic<uint64> counters[4];
+   counters_test(counters, 4, 20000000);
+}
+
+FALCON_TEST_MAIN
+
+/* end of atomic.fut.cpp */
@@ -0,0 +1,254 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: boxeditem.fut.cpp
+
+  Test the NaN-boxed item layout, and compare it with the pair layout.
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/engine/item.h>
+#include <falcon/engine/pagedstack.h>
+#include <limits>
+#include <vector>
+
+using namespace falcon;
+
+class BoxedItemTest: public falcon::testing::TestCase
+{
+public:
+   enum {
+      PERF_COUNT = 2000000,
+      PERF_DEPTH = 4096
+   };
+
+   void SetUp() {}
+   void TearDown() {}
+
+   template<class _Item>
+   void push_pop_test(int count, int depth)
+   {
+      falcon::PagedStack<_Item> stack;
+      int64 sum = 0;
+      for(int i = 0; i < count / depth; ++i) {
+         for(int j = 0; j < depth; ++j) {
+            stack.push_emplace(static_cast<int64>(j));
+         }
+         for(int j = 0; j < depth; ++j) {
+            sum += stack.top().toInt();
+            stack.pop();
+         }
+      }
+      EXPECT_EQ(static_cast<int64>(count / depth) * depth * (depth - 1) / 2, sum);
+      EXPECT_TRUE(stack.empty());
+   }
+
+   template<class _Item>
+   void arithmetic_test(int count)
+   {
+      std::vector<_Item> values;
+      for(int i = 0; i < 256; ++i) {
+         if (i % 2) {
+            values.emplace_back(static_cast<int64>(i));
+         }
+         else {
+            values.emplace_back(static_cast<numeric>(i));
+         }
+      }
+
+      _Item acc(0LL);
+      for(int i = 0; i < count; ++i) {
+         const _Item& value = values[i & 0xFF];
+         acc = _Item(acc.toInt() + value.toInt() - (i & 0xFF));
+      }
+      EXPECT_EQ(0, acc.toInt());
+   }
+};
+
+TEST_F(BoxedItemTest, size)
+{
+   EXPECT_EQ(8, sizeof(BoxedItem));
+   EXPECT_EQ(16, sizeof(PairItem));
+}
+
+TEST_F(BoxedItemTest, nil)
+{
+   BoxedItem item;
+   EXPECT_EQ(BoxedItem::TAG_NIL, item.tag());
+   EXPECT_TRUE(item.handler() == &HandlerFactory::nilHandler);
+   EXPECT_STREQ("nil", item.toString());
+   EXPECT_FALSE(item.toBool());
+}
+
+TEST_F(BoxedItemTest, boolean)
+{
+   EXPECT_EQ(BoxedItem::TAG_BOOL, BoxedItem(true).tag());
+   EXPECT_TRUE(BoxedItem(true).toBool());
+   EXPECT_FALSE(BoxedItem(false).toBool());
+   EXPECT_STREQ("true", BoxedItem(true).toString());
+}
+
+TEST_F(BoxedItemTest, integer)
+{
+   BoxedItem positive(123456789LL);
+   BoxedItem negative(-123456789LL);
+   EXPECT_EQ(BoxedItem::TAG_INT, positive.tag());
+   EXPECT_EQ(123456789LL, positive.toInt());
+   EXPECT_EQ(-123456789LL, negative.toInt());
+   EXPECT_EQ(-123456789LL, negative.get<int64>());
+   EXPECT_STREQ("-123456789", negative.toString());
+}
+
+TEST_F(BoxedItemTest, long_integer)
+{
+   const int64 large = std::numeric_limits<int64>::max();
+   const int64 small = std::numeric_limits<int64>::min();
+   BoxedItem item(large);
+   EXPECT_EQ(BoxedItem::TAG_EXTENDED, item.tag());
+   EXPECT_EQ(large, item.toInt());
+   EXPECT_EQ(small, BoxedItem(small).toInt());
+
+   BoxedItem copy(item);
+   EXPECT_EQ(large, copy.toInt());
+   EXPECT_NE(item.word(), copy.word());
+}
+
+TEST_F(BoxedItemTest, floating)
+{
+   BoxedItem item(2.5);
+   EXPECT_EQ(BoxedItem::TAG_FLOAT, item.tag());
+   EXPECT_TRUE(item.handler() == &HandlerFactory::floatHandler);
+   EXPECT_EQ(2.5, item.get<numeric>());
+   EXPECT_EQ(-2.5, BoxedItem(-2.5).get<numeric>());
+
+   BoxedItem inf(-std::numeric_limits<numeric>::infinity());
+   EXPECT_EQ(BoxedItem::TAG_FLOAT, inf.tag());
+
+   BoxedItem nan(-std::numeric_limits<numeric>::quiet_NaN());
+   EXPECT_EQ(BoxedItem::TAG_FLOAT, nan.tag());
+   EXPECT_TRUE(std::isnan(nan.get<numeric>()));
+}
+
+TEST_F(BoxedItemTest, string)
+{
+   BoxedItem item("Hello world");
+   EXPECT_EQ(BoxedItem::TAG_STRING, item.tag());
+   EXPECT_STREQ("Hello world", item.toString());
+   EXPECT_TRUE(item.toBool());
+   EXPECT_EQ(100LL, BoxedItem("100").toInt());
+
+   BoxedItem copy;
+   copy = item;
+   EXPECT_STREQ("Hello world", copy.get<String>());
+
+   BoxedItem moved(std::move(copy));
+   EXPECT_STREQ("Hello world", moved.toString());
+   EXPECT_EQ(BoxedItem::TAG_NIL, copy.tag());
+}
+
+TEST_F(BoxedItemTest, short_string)
+{
+   BoxedItem item("abcdef");
+   EXPECT_EQ(BoxedItem::TAG_SHORTSTRING, item.tag());
+   EXPECT_STREQ("abcdef", item.toString());
+   EXPECT_STREQ("abcdef", item.get<String>());
+   EXPECT_EQ(BoxedItem::TAG_SHORTSTRING, BoxedItem("").tag());
+   EXPECT_FALSE(BoxedItem("").toBool());
+   EXPECT_EQ(42, BoxedItem("42").toInt());
+
+   BoxedItem promoted("abcdefg");
+   EXPECT_EQ(BoxedItem::TAG_STRING, promoted.tag());
+   EXPECT_STREQ("abcdefg", promoted.toString());
+}
+
+TEST_F(BoxedItemTest, intern)
+{
+   BoxedItem item("Hello world");
+   BoxedItem other(std::string("Hello world"));
+   item.intern();
+   other.intern();
+   EXPECT_EQ(BoxedItem::TAG_ATOM, item.tag());
+   EXPECT_EQ(item.word(), other.word());
+   EXPECT_STREQ("Hello world", item.toString());
+   EXPECT_TRUE(item.equals(BoxedItem("Hello world")));
+
+   BoxedItem small("abc");
+   small.intern();
+   EXPECT_EQ(BoxedItem::TAG_SHORTSTRING, small.tag());
+}
+
+TEST_F(BoxedItemTest, copy_on_write)
+{
+   BoxedItem item("Hello world");
+   BoxedItem copy(item);
+   EXPECT_EQ(item.word(), copy.word());
+   EXPECT_EQ(2, StringHandler::refCount(item.data()));
+
+   copy.modify<String>() += "!";
+   EXPECT_NE(item.word(), copy.word());
+   EXPECT_STREQ("Hello world", item.toString());
+   EXPECT_STREQ("Hello world!", copy.toString());
+   EXPECT_EQ(BoxedItem::TAG_STRING, copy.tag());
+
+   BoxedItem small("abc");
+   small.modify<String>() += "defgh";
+   EXPECT_EQ(BoxedItem::TAG_STRING, small.tag());
+   EXPECT_STREQ("abcdefgh", small.toString());
+}
+
+TEST_F(BoxedItemTest, modify_wrong_type)
+{
+   BoxedItem number(static_cast<int64>(5));
+   BoxedItem wide(Int128(5));
+   BoxedItem array(TypedArray<int64>{1, 2});
+   bool thrown = false;
+   try { number.modify<Int128>(); } catch(std::invalid_argument&) { thrown = true; }
+   EXPECT_TRUE(thrown);
+   thrown = false;
+   try { wide.modify<Int256>(); } catch(std::invalid_argument&) { thrown = true; }
+   EXPECT_TRUE(thrown);
+   thrown = false;
+   try { array.modify<TypedArray<numeric>>(); } catch(std::invalid_argument&) { thrown = true; }
+   EXPECT_TRUE(thrown);
+
+   EXPECT_STREQ("5", wide.toString());
+   EXPECT_EQ(2u, array.modify<TypedArray<int64>>().size());
+}
+
+TEST_F(BoxedItemTest, bignum)
+{
+   BoxedItem item(BigNum(12345));
+   EXPECT_EQ(BoxedItem::TAG_BIGNUM, item.tag());
+   EXPECT_EQ(12345, item.toInt());
+}
+
+TEST_F(BoxedItemTest, perf_test_pair_push_pop)
+{
+   push_pop_test<PairItem>(PERF_COUNT, PERF_DEPTH);
+}
+
+TEST_F(BoxedItemTest, perf_test_boxed_push_pop)
+{
+   push_pop_test<BoxedItem>(PERF_COUNT, PERF_DEPTH);
+}
+
+TEST_F(BoxedItemTest, perf_test_pair_arithmetic)
+{
+   arithmetic_test<PairItem>(PERF_COUNT);
+}
+
+TEST_F(BoxedItemTest, perf_test_boxed_arithmetic)
+{
+   arithmetic_test<BoxedItem>(PERF_COUNT);
+}
+
+FALCON_TEST_MAIN
+
+/* end of boxeditem.fut.cpp */
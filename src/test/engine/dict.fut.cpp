@@ -0,0 +1,279 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: dict.fut.cpp
+
+  Test for the dictionary of items
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/engine/item.h>
+#include <falcon/engine/stringpool.h>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace falcon;
+
+class DictTest: public falcon::testing::TestCase
+{
+public:
+   enum {
+      PERF_COUNT = 200000
+   };
+
+   using ItemDict = Dict<Item>;
+
+   void SetUp() {}
+   void TearDown() {}
+
+   // Keys too long to be stored inline.
+   void long_keys_test(ItemDict& dict)
+   {
+      const std::string prefix("A long enough key number ");
+      for (int64 i = 0; i < PERF_COUNT; ++i) {
+         dict.set(Item(prefix + std::to_string(i)), Item(i));
+      }
+      int64 sum = 0;
+      for (int64 i = 0; i < PERF_COUNT; ++i) {
+         sum += dict.find(Item(prefix + std::to_string(i)))->toInt();
+      }
+      EXPECT_EQ(static_cast<int64>(PERF_COUNT) * (PERF_COUNT - 1) / 2, sum);
+   }
+
+   static String toString(const ItemDict& dict)
+   {
+      String out;
+      dict.toString(out);
+      return out;
+   }
+};
+
+TEST_F(DictTest, smoke)
+{
+   ItemDict dict{{Item("a"), Item(0LL)}, {Item("b"), Item(1LL)}};
+   EXPECT_EQ(2, dict.size());
+   EXPECT_EQ(0, dict.find(Item("a"))->toInt());
+   EXPECT_EQ(1, dict.find(Item("b"))->toInt());
+   EXPECT_TRUE(dict.find(Item("c")) == nullptr);
+
+   EXPECT_FALSE(dict.set(Item("a"), Item(10LL)));
+   EXPECT_TRUE(dict.set(Item("c"), Item(2LL)));
+   EXPECT_EQ(10, dict.find(Item("a"))->toInt());
+   EXPECT_EQ(3, dict.size());
+
+   dict[Item(5LL)] = Item(2.5);
+   EXPECT_STREQ("[a => 10, b => 1, c => 2, 5 => 2.5]", toString(dict));
+}
+
+TEST_F(DictTest, keys)
+{
+   ItemDict dict;
+   // All the string representations are the same key.
+   dict.set(Item("key"), Item(1LL));
+   EXPECT_EQ(1, dict.find(Item(String("key")))->toInt());
+   EXPECT_EQ(1, dict.find(Item(StringPool::global().intern("key")))->toInt());
+
+   dict.set(Item("A long enough string"), Item(2LL));
+   Item interned(StringPool::global().intern("A long enough string"));
+   EXPECT_EQ(2, dict.find(interned)->toInt());
+
+   // Types are distinct.
+   dict.set(Item(1LL), Item("int"));
+   dict.set(Item(1.0), Item("float"));
+   dict.set(Item(true), Item("bool"));
+   EXPECT_STREQ("int", dict.find(Item(1LL))->toString());
+   EXPECT_STREQ("float", dict.find(Item(1.0))->toString());
+   EXPECT_STREQ("bool", dict.find(Item(true))->toString());
+   EXPECT_TRUE(dict.find(Item(false)) == nullptr);
+
+   dict.set(Item(), Item("nil"));
+   EXPECT_STREQ("nil", dict.find(Item())->toString());
+   dict.set(Item(0.0), Item("zero"));
+   EXPECT_STREQ("zero", dict.find(Item(-0.0))->toString());
+   EXPECT_EQ(7, dict.size());
+}
+
+TEST_F(DictTest, erase)
+{
+   ItemDict dict;
+   for (int64 i = 0; i < 1000; ++i) {
+      dict.set(Item(i), Item(i * 2));
+   }
+   for (int64 i = 0; i < 1000; i += 2) {
+      EXPECT_TRUE(dict.erase(Item(i)));
+   }
+   EXPECT_FALSE(dict.erase(Item(0LL)));
+   EXPECT_EQ(500, dict.size());
+
+   int64 expected = 1;
+   bool ordered = true;
+   dict.forEach([&](const Item& key, const Item& value) {
+      ordered = ordered && key.toInt() == expected && value.toInt() == expected * 2;
+      expected += 2;
+   });
+   EXPECT_TRUE(ordered);
+
+   // Churning on the same keys doesn't grow the table.
+   size_t capacity = dict.capacity();
+   for (int round = 0; round < 100; ++round) {
+      for (int64 i = 0; i < 1000; i += 2) {
+         dict.set(Item(i), Item(i));
+      }
+      for (int64 i = 0; i < 1000; i += 2) {
+         dict.erase(Item(i));
+      }
+   }
+   EXPECT_EQ(500, dict.size());
+   EXPECT_EQ(capacity, dict.capacity());
+   EXPECT_EQ(3, dict.find(Item(3LL))->toInt() / 2);
+}
+
+TEST_F(DictTest, sorted)
+{
+   ItemDict dict{{Item("b"), Item(1LL)}, {Item(3LL), Item(2LL)}, {Item("a"), Item(3LL)}, {Item(-1LL), Item(4LL)}};
+   EXPECT_STREQ("[b => 1, 3 => 2, a => 3, -1 => 4]", toString(dict));
+
+   dict.setOrder(ItemDict::Order::SORTED);
+   EXPECT_STREQ("[-1 => 4, 3 => 2, a => 3, b => 1]", toString(dict));
+
+   dict.set(Item("A long enough string"), Item());
+   dict.erase(Item(3LL));
+   EXPECT_STREQ("[-1 => 4, A long enough string => nil, a => 3, b => 1]", toString(dict));
+}
+
+TEST_F(DictTest, sorted_nan)
+{
+   const numeric nan = std::numeric_limits<numeric>::quiet_NaN();
+   ItemDict dict;
+   dict.set(Item(2.0), Item(1LL));
+   dict.set(Item(nan), Item(2LL));
+   dict.set(Item(1.0), Item(3LL));
+   dict.set(Item(-nan), Item(4LL));
+   dict.set(Item(-1.0), Item(5LL));
+   dict.setOrder(ItemDict::Order::SORTED);
+
+   // NaN never equals a key, so the two are kept, after all the numbers.
+   EXPECT_EQ(5, dict.size());
+   std::vector<numeric> keys;
+   dict.forEach([&](const Item& key, const Item&) {keys.push_back(key.get<numeric>());});
+   EXPECT_EQ(5u, keys.size());
+   EXPECT_EQ(-1.0, keys[0]);
+   EXPECT_EQ(1.0, keys[1]);
+   EXPECT_EQ(2.0, keys[2]);
+   EXPECT_TRUE(std::isnan(keys[3]));
+   EXPECT_TRUE(std::isnan(keys[4]));
+}
+
+TEST_F(DictTest, interned_keys)
+{
+   const size_t before = StringPool::global().size();
+   {
+      ItemDict plain{{Item("A long enough string key"), Item(0LL)}};
+      EXPECT_EQ(before, StringPool::global().size());
+
+      ItemDict first;
+      first.setInternKeys(true);
+      first.set(Item("A long enough string key"), Item(1LL));
+      first.set(Item("short"), Item(2LL));
+      ItemDict second;
+      second.setInternKeys(true);
+      second.set(Item("A long enough string key"), Item(3LL));
+
+      // Only the heap string is interned, once for both dictionaries.
+      EXPECT_EQ(before + 1, StringPool::global().size());
+      EXPECT_EQ(1, first.find(Item("A long enough string key"))->toInt());
+      EXPECT_EQ(3, second.find(Item(StringPool::global().intern("A long enough string key")))->toInt());
+      EXPECT_EQ(2, first.find(Item("short"))->toInt());
+   }
+   EXPECT_EQ(before, StringPool::global().size());
+}
+
+TEST_F(DictTest, merge)
+{
+   ItemDict dict{{Item("a"), Item(0LL)}, {Item("b"), Item(1LL)}};
+   ItemDict other{{Item("b"), Item(10LL)}, {Item("c"), Item(20LL)}};
+   dict.merge(other);
+   EXPECT_STREQ("[a => 0, b => 10, c => 20]", toString(dict));
+}
+
+TEST_F(DictTest, item)
+{
+   Item item(ItemDict{{Item("a"), Item(1LL)}});
+   EXPECT_STREQ("[a => 1]", item.toString());
+   EXPECT_EQ(1, item.toInt());
+   EXPECT_TRUE(item.toBool());
+
+   // Dictionaries are shared by reference, and can be nested.
+   Item copy(item);
+   copy.modify<ItemDict>().set(Item("nested"), Item(ItemDict()));
+   EXPECT_STREQ("[a => 1, nested => []]", item.toString());
+   EXPECT_TRUE(copy.equals(item));
+   EXPECT_FALSE(Item(ItemDict()).equals(item));
+}
+
+TEST_F(DictTest, perf_test_std_map)
+{
+   std::map<std::string, int64> map;
+   for (int64 i = 0; i < PERF_COUNT; ++i) {
+      map[std::to_string(i)] = i;
+   }
+   int64 sum = 0;
+   for (int64 i = 0; i < PERF_COUNT; ++i) {
+      sum += map.find(std::to_string(i))->second;
+   }
+   EXPECT_EQ(static_cast<int64>(PERF_COUNT) * (PERF_COUNT - 1) / 2, sum);
+}
+
+TEST_F(DictTest, perf_test_std_unordered_map)
+{
+   std::unordered_map<std::string, int64> map;
+   for (int64 i = 0; i < PERF_COUNT; ++i) {
+      map[std::to_string(i)] = i;
+   }
+   int64 sum = 0;
+   for (int64 i = 0; i < PERF_COUNT; ++i) {
+      sum += map.find(std::to_string(i))->second;
+   }
+   EXPECT_EQ(static_cast<int64>(PERF_COUNT) * (PERF_COUNT - 1) / 2, sum);
+}
+
+TEST_F(DictTest, perf_test_dict)
+{
+   ItemDict dict;
+   for (int64 i = 0; i < PERF_COUNT; ++i) {
+      dict.set(Item(std::to_string(i)), Item(i));
+   }
+   int64 sum = 0;
+   for (int64 i = 0; i < PERF_COUNT; ++i) {
+      sum += dict.find(Item(std::to_string(i)))->toInt();
+   }
+   EXPECT_EQ(static_cast<int64>(PERF_COUNT) * (PERF_COUNT - 1) / 2, sum);
+}
+
+TEST_F(DictTest, perf_test_dict_long_keys)
+{
+   ItemDict dict;
+   long_keys_test(dict);
+}
+
+TEST_F(DictTest, perf_test_dict_interned_keys)
+{
+   ItemDict dict;
+   dict.setInternKeys(true);
+   long_keys_test(dict);
+}
+
+FALCON_TEST_MAIN
+
+/* end of dict.fut.cpp */
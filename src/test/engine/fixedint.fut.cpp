@@ -0,0 +1,210 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: fixedint.fut.cpp
+
+  Test for the fixed width big integers
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/engine/fixedint.h>
+#include <falcon/engine/item.h>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace falcon;
+
+class FixedIntTest: public falcon::testing::TestCase
+{
+public:
+   enum {
+      PERF_COUNT = 200000
+   };
+
+   void SetUp() {}
+   void TearDown() {}
+};
+
+TEST_F(FixedIntTest, smoke)
+{
+   EXPECT_EQ(16, sizeof(Int128));
+   EXPECT_EQ(32, sizeof(Int256));
+
+   Int128 zero;
+   EXPECT_TRUE(zero.isZero());
+   EXPECT_STREQ("0", zero.toString());
+
+   Int128 negative(-42);
+   EXPECT_TRUE(negative.isNegative());
+   EXPECT_EQ(-42, negative.toInt64());
+   EXPECT_STREQ("-42", negative.toString());
+   EXPECT_EQ(~0ULL, negative.limb(1));
+}
+
+TEST_F(FixedIntTest, arithmetic)
+{
+   Int128 a(std::numeric_limits<int64>::max());
+   Int128 b = a + a;
+   EXPECT_FALSE(b.fitsInt64());
+   EXPECT_STREQ("18446744073709551614", b.toString());
+   EXPECT_EQ(std::numeric_limits<int64>::max(), b.toInt64());
+   EXPECT_TRUE(b - a == a);
+   EXPECT_STREQ("-9223372036854775807", (a - b).toString());
+
+   Int128 c = a * a;
+   EXPECT_STREQ("85070591730234615847396907784232501249", c.toString());
+   EXPECT_STREQ("-85070591730234615847396907784232501249", (c * Int128(-1)).toString());
+   EXPECT_STREQ("85070591730234615847396907784232501249", (-a * -a).toString());
+
+   EXPECT_STREQ("170141183460469231731687303715884105727", Int128::max().toString());
+   EXPECT_STREQ("-170141183460469231731687303715884105728", Int128::min().toString());
+   EXPECT_TRUE(Int128::max() + Int128(1) == Int128::min());
+}
+
+TEST_F(FixedIntTest, parse)
+{
+   const char* big = "-57896044618658097711785492504343953926634992332820282019728792003956564819968";
+   Int256 value = Int256::parse(big, std::strlen(big));
+   EXPECT_TRUE(value == Int256::min());
+   EXPECT_STREQ(big, value.toString());
+
+   EXPECT_TRUE(Int128::parse(String("+1000000000000000000000")) == Int128(1000000000000LL) * Int128(1000000000LL));
+
+   bool thrown = false;
+   try {
+      Int128::parse(String("12a"));
+   }
+   catch(std::invalid_argument&) {
+      thrown = true;
+   }
+   EXPECT_TRUE(thrown);
+}
+
+TEST_F(FixedIntTest, parse_range)
+{
+   // 2^127 - 1 and -2^127 are the limits of Int128.
+   EXPECT_TRUE(Int128::parse(String("170141183460469231731687303715884105727")) == Int128::max());
+   EXPECT_TRUE(Int128::parse(String("-170141183460469231731687303715884105728")) == Int128::min());
+
+   const char* outside[] = {
+      "170141183460469231731687303715884105728",
+      "-170141183460469231731687303715884105729",
+      // wraps past 2^128, back to a small value.
+      "340282366920938463463374607431768211457",
+      "1000000000000000000000000000000000000000000000000"
+   };
+   for (const char* literal: outside) {
+      bool thrown = false;
+      try {
+         Int128::parse(String(literal));
+      }
+      catch(std::out_of_range&) {
+         thrown = true;
+      }
+      EXPECT_TRUE(thrown);
+   }
+}
+
+TEST_F(FixedIntTest, compare)
+{
+   Int256 small(-5);
+   Int256 large = Int256(1000000000000LL) * Int256(1000000000000LL);
+   EXPECT_TRUE(small < large);
+   EXPECT_TRUE(large > Int256(7));
+   EXPECT_TRUE(-large < small);
+   EXPECT_EQ(0, compare(large, large));
+   EXPECT_TRUE(large != small);
+}
+
+TEST_F(FixedIntTest, kernels)
+{
+   std::vector<Int128> a, b, result(100);
+   std::vector<int8> order(100);
+   for (int i = 0; i < 100; ++i) {
+      a.emplace_back(i);
+      b.emplace_back(50 - i);
+   }
+
+   add(a.data(), b.data(), result.data(), a.size());
+   EXPECT_TRUE(sum(result.data(), result.size()) == Int128(5000));
+
+   mul(a.data(), b.data(), result.data(), a.size());
+   EXPECT_EQ(3 * 47, result[3].toInt64());
+   EXPECT_EQ(-99 * 49, result[99].toInt64());
+
+   compare(a.data(), b.data(), order.data(), a.size());
+   EXPECT_EQ(-1, order[0]);
+   EXPECT_EQ(0, order[25]);
+   EXPECT_EQ(1, order[99]);
+}
+
+TEST_F(FixedIntTest, item)
+{
+   Item item(Int128(1) * Int128(std::numeric_limits<int64>::max()) * Int128(4));
+   EXPECT_STREQ("36893488147419103228", item.toString());
+   EXPECT_EQ(std::numeric_limits<int64>::max(), item.toInt());
+   EXPECT_TRUE(item.toBool());
+
+   Item copy(item);
+   copy.modify<Int128>() += Int128(2);
+   EXPECT_STREQ("36893488147419103228", item.toString());
+   EXPECT_STREQ("36893488147419103230", copy.get<Int128>().toString());
+
+   EXPECT_EQ(-7, Item(Int256(-7)).toInt());
+   EXPECT_FALSE(Item(Int256()).toBool());
+}
+
+TEST_F(FixedIntTest, handler)
+{
+   PairItem pair(Int256(-7));
+   EXPECT_TRUE(pair.handler == &HandlerFactory::int256Handler);
+   EXPECT_STREQ("Int256", pair.handler->typeName());
+
+   BoxedItem boxed(Int128(3));
+   EXPECT_EQ(BoxedItem::TAG_EXTENDED, boxed.tag());
+   EXPECT_TRUE(boxed.handler() == &HandlerFactory::int128Handler);
+   EXPECT_STREQ("Int128", boxed.handler()->typeName());
+
+   BoxedItem copy(boxed);
+   EXPECT_NE(boxed.word(), copy.word());
+   copy.modify<Int128>() -= Int128(5);
+   EXPECT_EQ(3, boxed.toInt());
+   EXPECT_EQ(-2, copy.toInt());
+}
+
+TEST_F(FixedIntTest, perf_test_bignum_sum)
+{
+   std::vector<BigNum> values;
+   for (int i = 0; i < PERF_COUNT; ++i) {
+      values.emplace_back(i);
+   }
+   BigNum total(0);
+   for (const BigNum& value: values) {
+      total += value * value;
+   }
+   EXPECT_TRUE(total > BigNum(0));
+}
+
+TEST_F(FixedIntTest, perf_test_int128_sum)
+{
+   std::vector<Int128> values;
+   for (int i = 0; i < PERF_COUNT; ++i) {
+      values.emplace_back(i);
+   }
+   std::vector<Int128> squares(values.size());
+   mul(values.data(), values.data(), squares.data(), values.size());
+   Int128 total = sum(squares.data(), squares.size());
+   EXPECT_TRUE(total > Int128(0));
+}
+
+FALCON_TEST_MAIN
+
+/* end of fixedint.fut.cpp */
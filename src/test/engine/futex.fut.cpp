@@ -15,7 +15,11 @@
 
 #include <falcon/fut/fut.h>
 #include <falcon/futex.h>
+#include <atomic>
+#include <chrono>
+#include <ctime>
 #include <mutex>
+#include <shared_mutex>
 #include <thread>
 #include <vector>
 
@@ -27,6 +31,10 @@ public:
    mutable Futex<0> m_futex;
    mutable Futex<1> m_yield_futex;
    mutable Futex<50> m_sl_futex;
+   mutable BlockingFutex<> m_blocking_futex;
+   mutable RFutex m_rfutex;
+   mutable RWFutex m_rw_futex;
+   mutable std::shared_mutex m_shared_mutex;
    mutable std::mutex m_mutex;
 
    void SetUp() {
@@ -66,6 +74,42 @@ public:
 
       EXPECT_EQ(perfCount * threadCount, counter);
    }
+
+   // one operation in writeEvery writes two counters; the others read them.
+   template<class _Mutex>
+   void read_mostly_test(_Mutex& mutex, int perfCount, int threadCount, int writeEvery)
+   {
+      volatile int first = 0;
+      volatile int second = 0;
+      std::atomic<int> torn{0};
+      auto check = [&](){
+         for(int i = 1; i <= perfCount; ++i) {
+            if(i % writeEvery == 0) {
+               std::lock_guard guard(mutex);
+               ++first;
+               ++second;
+            }
+            else {
+               std::shared_lock guard(mutex);
+               if(first != second) {
+                  ++torn;
+               }
+            }
+         }
+      };
+
+      std::vector<std::thread> threads;
+      for (int i = 0; i < threadCount; ++i) {
+         threads.emplace_back(check);
+      }
+
+      for (int i = 0; i < threadCount; ++i) {
+         threads[i].join();
+      }
+
+      EXPECT_EQ(0, torn);
+      EXPECT_EQ(perfCount / writeEvery * threadCount, first);
+   }
 };
 
 TEST_F(FutexTest, smoke)
@@ -93,6 +137,190 @@ TEST_F(FutexTest, thread_counter)
    performance_test(m_futex, 10000, 10, 0);
 }
 
+TEST_F(FutexTest, blocking_smoke)
+{
+   EXPECT_FALSE(m_blocking_futex.isLocked());
+   {
+      std::lock_guard guard(m_blocking_futex);
+      EXPECT_TRUE(m_blocking_futex.isLocked());
+      EXPECT_FALSE(m_blocking_futex.try_lock());
+   }
+   EXPECT_FALSE(m_blocking_futex.isLocked());
+   EXPECT_TRUE(m_blocking_futex.try_lock());
+   m_blocking_futex.unlock();
+}
+
+TEST_F(FutexTest, blocking_thread_counter)
+{
+   performance_test(m_blocking_futex, 10000, 10, 0);
+}
+
+#ifdef __linux__
+TEST_F(FutexTest, blocking_sleeps)
+{
+   std::atomic<long> waiterCpu{0};
+   m_blocking_futex.lock();
+   std::thread waiter([&]() {
+      m_blocking_futex.lock();
+      timespec ts;
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+      waiterCpu = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+      m_blocking_futex.unlock();
+   });
+   std::this_thread::sleep_for(std::chrono::milliseconds(300));
+   m_blocking_futex.unlock();
+   waiter.join();
+
+   // the waiter slept while the lock was held.
+   EXPECT_TRUE(waiterCpu < 100);
+   EXPECT_FALSE(m_blocking_futex.isLocked());
+}
+#endif
+
+TEST_F(FutexTest, recursive)
+{
+   EXPECT_FALSE(m_rfutex.isLocked());
+   EXPECT_FALSE(m_rfutex.isOwner());
+   m_rfutex.lock();
+   m_rfutex.lock();
+   EXPECT_TRUE(m_rfutex.try_lock());
+   EXPECT_TRUE(m_rfutex.isOwner());
+   m_rfutex.unlock();
+   m_rfutex.unlock();
+   EXPECT_TRUE(m_rfutex.isLocked());
+
+   std::atomic<bool> other{true};
+   std::thread thread([&]() {
+      other = m_rfutex.try_lock() || m_rfutex.isOwner();
+   });
+   thread.join();
+   EXPECT_FALSE(other);
+
+   m_rfutex.unlock();
+   EXPECT_FALSE(m_rfutex.isLocked());
+}
+
+TEST_F(FutexTest, recursive_thread_counter)
+{
+   performance_test(m_rfutex, 10000, 10, 0);
+}
+
+TEST_F(FutexTest, rw_smoke)
+{
+   EXPECT_FALSE(m_rw_futex.isLocked());
+   m_rw_futex.lock_shared();
+   m_rw_futex.lock_shared();
+   EXPECT_TRUE(m_rw_futex.try_lock_shared());
+   EXPECT_FALSE(m_rw_futex.try_lock());
+   EXPECT_FALSE(m_rw_futex.isLocked());
+
+   std::atomic<bool> shared{false};
+   std::thread reader([&]() {
+      shared = m_rw_futex.try_lock_shared();
+      if(shared) {
+         m_rw_futex.unlock_shared();
+      }
+   });
+   reader.join();
+   EXPECT_TRUE(shared);
+
+   m_rw_futex.unlock_shared();
+   m_rw_futex.unlock_shared();
+   m_rw_futex.unlock_shared();
+   {
+      std::lock_guard guard(m_rw_futex);
+      EXPECT_TRUE(m_rw_futex.isLocked());
+      EXPECT_FALSE(m_rw_futex.try_lock_shared());
+   }
+   EXPECT_FALSE(m_rw_futex.isLocked());
+   EXPECT_TRUE(m_rw_futex.try_lock());
+   m_rw_futex.unlock();
+}
+
+TEST_F(FutexTest, rw_thread_counter)
+{
+   performance_test(m_rw_futex, 10000, 10, 0);
+   read_mostly_test(m_rw_futex, 100000, 8, 10);
+}
+
+TEST_F(FutexTest, rw_writer_first)
+{
+   // readers keep coming, but a waiting writer goes before the new ones.
+   std::atomic<bool> stop{false};
+   std::atomic<int> reads{0};
+   std::vector<std::thread> readers;
+   for(int i = 0; i < 4; ++i) {
+      readers.emplace_back([&]() {
+         while(!stop) {
+            std::shared_lock guard(m_rw_futex);
+            ++reads;
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+         }
+      });
+   }
+   while(reads < 100) {
+      std::this_thread::yield();
+   }
+
+   auto start = std::chrono::steady_clock::now();
+   m_rw_futex.lock();
+   auto waited = std::chrono::steady_clock::now() - start;
+   int readsIn = reads;
+   std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   int readsAfter = reads;
+   m_rw_futex.unlock();
+
+   stop = true;
+   for(auto& reader: readers) {
+      reader.join();
+   }
+   EXPECT_EQ(readsIn, readsAfter);
+   EXPECT_TRUE(waited < std::chrono::seconds(1));
+}
+
+TEST_F(FutexTest, sharded)
+{
+   ShardedFutex<> sharded;
+   EXPECT_EQ(16, ShardedFutex<>::SHARDS);
+   EXPECT_TRUE(&sharded.forKey(std::string("alpha")) == &sharded.forKey(std::string("alpha")));
+   EXPECT_TRUE(&sharded.forHash(3) == &sharded.shard(3));
+   EXPECT_TRUE(&sharded.forHash(size_t(3) << 32) == &sharded.shard(3));
+
+   sharded.lockAll();
+   for(unsigned int i = 0; i < ShardedFutex<>::SHARDS; ++i) {
+      EXPECT_TRUE(sharded.shard(i).isLocked());
+   }
+   sharded.unlockAll();
+   EXPECT_FALSE(sharded.forKey(42).isLocked());
+
+   // each thread counts on the shard of its own keys.
+   const int threadCount = 8;
+   int counts[ShardedFutex<>::SHARDS] = {};
+   std::vector<std::thread> threads;
+   for(int t = 0; t < threadCount; ++t) {
+      threads.emplace_back([&, t]() {
+         for(size_t key = t; key < 80000; key += threadCount) {
+            std::lock_guard guard(sharded.forHash(key));
+            ++counts[ShardedFutex<>::shardOf(key)];
+         }
+      });
+   }
+   for(auto& thread: threads) {
+      thread.join();
+   }
+   int total = 0;
+   for(int count: counts) {
+      total += count;
+   }
+   EXPECT_EQ(80000, total);
+}
+
+TEST_F(FutexTest, sharded_rw)
+{
+   ShardedFutex<RWFutex, 4> sharded;
+   read_mostly_test(sharded.forKey(std::string("symbol")), 10000, 4, 10);
+}
+
 
 
 
@@ -111,6 +339,11 @@ TEST_F(FutexTest, perf_test_sl_trio)
    performance_test(m_sl_futex, 10000000, 3, 30);
 }
 
+TEST_F(FutexTest, perf_test_blocking_trio)
+{
+   performance_test(m_blocking_futex, 10000000, 3, 30);
+}
+
 TEST_F(FutexTest, perf_test_mutex_trio)
 {
    performance_test(m_mutex, 10000000, 3, 30);
@@ -134,6 +367,11 @@ TEST_F(FutexTest, perf_test_sl_contention)
    performance_test(m_sl_futex, 10000000, 4, 0);
 }
 
+TEST_F(FutexTest, perf_test_blocking_contention)
+{
+   performance_test(m_blocking_futex, 10000000, 4, 0);
+}
+
 TEST_F(FutexTest, perf_test_mutex_contention)
 {
    performance_test(m_mutex, 10000000, 4, 0);
@@ -157,10 +395,28 @@ TEST_F(FutexTest, perf_test_sl_non_contention)
    performance_test(m_sl_futex, 1000000, 10, 1000);
 }
 
+TEST_F(FutexTest, perf_test_blocking_non_contention)
+{
+   performance_test(m_blocking_futex, 1000000, 10, 1000);
+}
+
 TEST_F(FutexTest, perf_test_mutex_non_contention)
 {
    performance_test(m_mutex, 1000000, 10, 1000);
 }
+
+
+
+
+TEST_F(FutexTest, perf_test_rw_read_mostly)
+{
+   read_mostly_test(m_rw_futex, 2000000, 4, 100);
+}
+
+TEST_F(FutexTest, perf_test_shared_mutex_read_mostly)
+{
+   read_mostly_test(m_shared_mutex, 2000000, 4, 100);
+}
 FALCON_TEST_MAIN
 
 /* end of futex.fut.cpp */
@@ -44,6 +44,123 @@ FALCON_TEST(Item, StringNumber)
   EXPECT_EQ(100LL, Item("100").toInt());
 }
 
+FALCON_TEST(Item, ShortString)
+{
+  PairItem item("key");
+  EXPECT_TRUE(item.handler == &HandlerFactory::shortStringHandler);
+  EXPECT_STREQ("key", item.toString());
+  EXPECT_STREQ("key", item.get<String>());
+  EXPECT_STREQ("12345678", Item("12345678").toString());
+  EXPECT_STREQ("", Item("").toString());
+}
+
+FALCON_TEST(Item, ShortStringPromotion)
+{
+  PairItem item("123456789");
+  EXPECT_TRUE(item.handler == &HandlerFactory::stringHandler);
+  EXPECT_STREQ("123456789", item.toString());
+
+  PairItem zeroes(std::string("a\0b", 3));
+  EXPECT_TRUE(zeroes.handler == &HandlerFactory::stringHandler);
+  EXPECT_EQ(3, zeroes.get<String>().size());
+}
+
+FALCON_TEST(Item, CopyShares)
+{
+  PairItem item("A long enough string");
+  {
+    PairItem copy(item);
+    EXPECT_EQ(item.data.ptrValue, copy.data.ptrValue);
+    EXPECT_EQ(2, StringHandler::refCount(item.data));
+    EXPECT_STREQ("A long enough string", copy.toString());
+  }
+  EXPECT_EQ(1, StringHandler::refCount(item.data));
+}
+
+FALCON_TEST(Item, CopyOnWrite)
+{
+  PairItem item("A long enough string");
+  PairItem copy;
+  copy = item;
+  copy.modify<String>() += "!";
+  EXPECT_NE(item.data.ptrValue, copy.data.ptrValue);
+  EXPECT_STREQ("A long enough string", item.toString());
+  EXPECT_STREQ("A long enough string!", copy.toString());
+  EXPECT_EQ(1, StringHandler::refCount(item.data));
+
+  // not shared anymore, written in place.
+  void* ptr = copy.data.ptrValue;
+  copy.modify<String>() += "!";
+  EXPECT_EQ(ptr, copy.data.ptrValue);
+}
+
+FALCON_TEST(Item, ModifyPromotes)
+{
+  Item item("short");
+  item.modify<String>() += " and now long";
+  EXPECT_STREQ("short and now long", item.toString());
+}
+
+FALCON_TEST(Item, ModifyWrongType)
+{
+  PairItem number(static_cast<int64>(5));
+  PairItem wide(Int128(5));
+  PairItem array(TypedArray<int64>{1, 2});
+  bool thrown = false;
+  try { number.modify<Int128>(); } catch(std::invalid_argument&) { thrown = true; }
+  EXPECT_TRUE(thrown);
+  thrown = false;
+  try { wide.modify<Int256>(); } catch(std::invalid_argument&) { thrown = true; }
+  EXPECT_TRUE(thrown);
+  thrown = false;
+  try { array.modify<TypedArray<numeric>>(); } catch(std::invalid_argument&) { thrown = true; }
+  EXPECT_TRUE(thrown);
+
+  EXPECT_STREQ("5", wide.toString());
+  EXPECT_EQ(2u, array.modify<TypedArray<int64>>().size());
+}
+
+FALCON_TEST(Item, Move)
+{
+  PairItem item("A long enough string");
+  PairItem moved(std::move(item));
+  EXPECT_STREQ("nil", item.toString());
+  EXPECT_EQ(1, StringHandler::refCount(moved.data));
+
+  item = std::move(moved);
+  EXPECT_STREQ("A long enough string", item.toString());
+}
+
+FALCON_TEST(Item, FlatDispatch)
+{
+  EXPECT_EQ(3LL, Item(3.7).toInt());
+  EXPECT_TRUE(Item(0.5).toBool());
+  EXPECT_EQ(1LL, Item(true).toInt());
+  EXPECT_STREQ("false", Item(false).toString());
+  EXPECT_STREQ("nil", Item().toString());
+  EXPECT_FALSE(Item().toBool());
+  EXPECT_STREQ("-42", Item(-42LL).toString());
+}
+
+FALCON_TEST(Item, NumberFormat)
+{
+  EXPECT_STREQ("0.1", Item(0.1).toString());
+  EXPECT_STREQ("100", Item(100.0).toString());
+  EXPECT_STREQ("1e+20", Item(1e20).toString());
+  EXPECT_STREQ("-9223372036854775808", Item(static_cast<int64>(-9223372036854775807LL - 1)).toString());
+}
+
+FALCON_TEST(Item, AppendString)
+{
+  String out = "values:";
+  Item values[] = {Item(1LL), Item(2.5), Item("abc"), Item("A long enough string"), Item(true), Item()};
+  for (const Item& item: values) {
+    out += ' ';
+    item.toString(out);
+  }
+  EXPECT_STREQ("values: 1 2.5 abc A long enough string true nil", out);
+}
+
 }
 
 /* end of singleton.fut.cpp */
@@ -0,0 +1,259 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: lockprofile.fut.cpp
+
+  Test for the contention profiling of the futexes
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/futex.h>
+#include <falcon/lockprofile.h>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace falcon;
+
+class LockProfileTest: public falcon::testing::TestCase
+{
+public:
+   void SetUp() {}
+   void TearDown() {}
+
+   template<typename _Lock>
+   static LockStats statsOf(_Lock& lock) {
+      LockStats stats;
+      lock.profile().fill(stats);
+      return stats;
+   }
+};
+
+TEST_F(LockProfileTest, no_profile)
+{
+   EXPECT_EQ(sizeof(std::atomic<bool>), sizeof(Futex<0, no_lock_profile>));
+   EXPECT_EQ(sizeof(std::atomic<int>), sizeof(BlockingFutex<100, no_lock_profile>));
+
+   BlockingFutex<100, no_lock_profile> lock;
+   LOCK_PROFILE(lock, "nothing");
+   lock.lock();
+   lock.unlock();
+   LockStats stats = statsOf(lock);
+   EXPECT_EQ(0, stats.m_acquisitions);
+   EXPECT_TRUE(stats.m_name == nullptr);
+}
+
+TEST_F(LockProfileTest, buckets)
+{
+   EXPECT_EQ(0, LockStats::bucketOf(0));
+   EXPECT_EQ(0, LockStats::bucketOf(127));
+   EXPECT_EQ(1, LockStats::bucketOf(128));
+   EXPECT_EQ(3, LockStats::bucketOf(1000));
+   EXPECT_EQ(LockStats::BUCKETS - 1, LockStats::bucketOf(uint64_t(10) * 1000 * 1000 * 1000));
+}
+
+TEST_F(LockProfileTest, acquisitions)
+{
+   BlockingFutex<100, lock_profile> lock;
+   LOCK_PROFILE(lock, "acquisitions");
+   for(int i = 0; i < 10; ++i) {
+      std::lock_guard guard(lock);
+   }
+   EXPECT_TRUE(lock.try_lock());
+   EXPECT_FALSE(lock.try_lock());
+   lock.unlock();
+
+   LockStats stats = statsOf(lock);
+   EXPECT_STREQ("acquisitions", stats.m_name);
+   EXPECT_TRUE(std::string(stats.m_file).find("lockprofile.fut.cpp") != std::string::npos);
+   EXPECT_EQ(11, stats.m_acquisitions);
+   EXPECT_EQ(0, stats.m_contended);
+   EXPECT_EQ(0, stats.m_waitNanos);
+}
+
+TEST_F(LockProfileTest, sleeping_wait)
+{
+   BlockingFutex<100, lock_profile> lock;
+   lock.lock();
+   std::thread waiter([&]() {
+      std::lock_guard guard(lock);
+   });
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   lock.unlock();
+   waiter.join();
+
+   LockStats stats = statsOf(lock);
+   EXPECT_EQ(2, stats.m_acquisitions);
+   EXPECT_EQ(1, stats.m_contended);
+   EXPECT_EQ(1, stats.m_sleeps);
+   EXPECT_EQ(100, stats.m_spins);
+   EXPECT_TRUE(stats.m_waitNanos >= 10 * 1000 * 1000);
+   EXPECT_EQ(1, stats.m_waits[LockStats::bucketOf(stats.m_waitNanos)]);
+}
+
+TEST_F(LockProfileTest, spinning)
+{
+   Futex<0, lock_profile> lock;
+   const int threadCount = 4;
+   const int perfCount = 100000;
+   std::vector<std::thread> threads;
+   for(int t = 0; t < threadCount; ++t) {
+      threads.emplace_back([&]() {
+         for(int i = 0; i < perfCount; ++i) {
+            std::lock_guard guard(lock);
+         }
+      });
+   }
+   for(auto& thread: threads) {
+      thread.join();
+   }
+
+   LockStats stats = statsOf(lock);
+   EXPECT_EQ(threadCount * perfCount, stats.m_acquisitions);
+   EXPECT_EQ(0, stats.m_sleeps);
+   uint64_t waits = 0;
+   for(uint64_t count: stats.m_waits) {
+      waits += count;
+   }
+   EXPECT_EQ(stats.m_contended, waits);
+}
+
+TEST_F(LockProfileTest, recursive)
+{
+   BasicRFutex<lock_profile> lock;
+   lock.lock();
+   lock.lock();
+   lock.unlock();
+   lock.unlock();
+   EXPECT_EQ(1, statsOf(lock).m_acquisitions);
+}
+
+TEST_F(LockProfileTest, reader_writer)
+{
+   BasicRWFutex<lock_profile> lock;
+   lock.lock_shared();
+   lock.unlock_shared();
+
+   // a reader waits for the writer, and then the writer for a reader.
+   lock.lock();
+   std::thread reader([&]() {
+      std::shared_lock guard(lock);
+   });
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   lock.unlock();
+   reader.join();
+   EXPECT_EQ(3, statsOf(lock).m_acquisitions);
+   EXPECT_EQ(1, statsOf(lock).m_contended);
+   EXPECT_EQ(1, statsOf(lock).m_sleeps);
+
+   lock.lock_shared();
+   std::thread writer([&]() {
+      std::lock_guard guard(lock);
+   });
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   lock.unlock_shared();
+   writer.join();
+
+   LockStats stats = statsOf(lock);
+   EXPECT_EQ(5, stats.m_acquisitions);
+   EXPECT_EQ(2, stats.m_contended);
+   EXPECT_EQ(2, stats.m_sleeps);
+   EXPECT_TRUE(stats.m_waitNanos >= 20 * 1000 * 1000);
+}
+
+TEST_F(LockProfileTest, sharded)
+{
+   std::ostringstream out;
+   {
+      ShardedFutex<BlockingFutex<100, lock_profile>, 4> sharded;
+      LOCK_PROFILE(sharded, "sharded");
+      for(unsigned int i = 0; i < 4; ++i) {
+         std::lock_guard guard(sharded.shard(i));
+      }
+      std::lock_guard guard(sharded.shard(0));
+      LockStats::writeAll(out);
+   }
+
+   // the shards are one lock in the dump.
+   std::string text = out.str();
+   const std::string sample = "falcon_lock_acquisitions_total{lock=\"sharded\"";
+   size_t pos = text.find(sample);
+   EXPECT_NE(std::string::npos, pos);
+   EXPECT_EQ(std::string::npos, text.find(sample, pos + 1));
+   std::string line = text.substr(pos, text.find('\n', pos) - pos);
+   EXPECT_EQ("} 5", line.substr(line.size() - 3));
+}
+
+TEST_F(LockProfileTest, registry)
+{
+   std::ostringstream out;
+   {
+      BlockingFutex<100, lock_profile> lock;
+      LOCK_PROFILE(lock, "registered");
+      lock.lock();
+      lock.unlock();
+      LockStats::writeAll(out);
+   }
+   std::string text = out.str();
+   EXPECT_NE(std::string::npos, text.find("# TYPE falcon_lock_wait_seconds histogram\n"));
+   EXPECT_NE(std::string::npos, text.find("falcon_lock_acquisitions_total{lock=\"registered\",site=\""));
+   EXPECT_NE(std::string::npos, text.find("lockprofile.fut.cpp:"));
+   EXPECT_NE(std::string::npos, text.find("le=\"+Inf\"} 0\n"));
+
+   // gone with its lock.
+   std::ostringstream after;
+   LockStats::writeAll(after);
+   EXPECT_EQ(std::string::npos, after.str().find("lock=\"registered\""));
+}
+
+TEST_F(LockProfileTest, families_contiguous)
+{
+   std::ostringstream out;
+   {
+      BlockingFutex<100, lock_profile> first;
+      LOCK_PROFILE(first, "first");
+      BlockingFutex<100, lock_profile> second;
+      LOCK_PROFILE(second, "second");
+      first.lock();
+      first.unlock();
+      second.lock();
+      second.unlock();
+      LockStats::writeAll(out);
+   }
+
+   // Each family must have a single TYPE line, followed by all its samples.
+   std::istringstream lines(out.str());
+   std::string line;
+   std::vector<std::string> families;
+   while(std::getline(lines, line)) {
+      if(line.compare(0, 7, "# TYPE ") == 0) {
+         std::string family = line.substr(7, line.find(' ', 7) - 7);
+         for(const std::string& seen: families) {
+            EXPECT_NE(seen, family);
+         }
+         families.push_back(family);
+         continue;
+      }
+      EXPECT_FALSE(families.empty());
+      EXPECT_EQ(0u, line.compare(0, families.back().size(), families.back()));
+   }
+   EXPECT_EQ(5u, families.size());
+
+   std::string text = out.str();
+   EXPECT_NE(std::string::npos, text.find("falcon_lock_acquisitions_total{lock=\"first\""));
+   EXPECT_NE(std::string::npos, text.find("falcon_lock_acquisitions_total{lock=\"second\""));
+}
+
+FALCON_TEST_MAIN
+
+/* end of lockprofile.fut.cpp */
@@ -115,6 +115,7 @@ TEST_F(LoggerTest, TempCategory)
 {
    // We expect TempCat to be before One, and Final Category after One.
 	// Be sure not to break searches.
+   m_catcher->m_expected = 2;
    LOG_CATEGORY("Cat");
    LOG_INFO << LOG_CAT("Temp") << "One";
    LOG_INFO << "Two";
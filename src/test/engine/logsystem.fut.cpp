@@ -16,10 +16,14 @@
 #include <falcon/fut/fut.h>
 #include <falcon/logsystem.h>
 
+#include <atomic>
+#include <chrono>
 #include <future>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 
 
@@ -34,6 +38,17 @@ protected:
 };
 
 
+class CountingListener: public falcon::LogSystem::Listener {
+public:
+	std::atomic<size_t> m_count{0};
+
+protected:
+    virtual void onMessage( const falcon::LogSystem::Message& ) override{
+    	m_count++;
+    }
+};
+
+
 class LogTest: public falcon::testing::TestCase
 {
 public:
@@ -201,6 +216,74 @@ TEST_F(LogTest, RightCategory) {
 }
 
 
+// Sends count messages from each of threadCount threads to a log system of its own.
+static bool logFromThreads(int threadCount, int count)
+{
+	falcon::LogSystem log;
+	auto counter = std::make_shared<CountingListener>();
+	log.addListener(counter);
+
+	std::vector<std::thread> threads;
+	for(int t = 0; t < threadCount; ++t) {
+		threads.emplace_back([&]() {
+			for(int i = 0; i < count; ++i) {
+				log.log("File", 101, falcon::LogSystem::LEVEL::DEBUG, "", "Message");
+			}
+		});
+	}
+	for(auto& thread: threads) {
+		thread.join();
+	}
+
+	size_t expected = size_t(threadCount) * count;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+	while(counter->m_count < expected && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	log.stop();
+
+	falcon::LogSystem::Diags diags;
+	log.getDiags(diags);
+	return counter->m_count == expected && diags.m_msgReceived == expected
+			&& diags.m_maxMsgQueueSize <= falcon::LogSystem::MESSAGE_QUEUE_SIZE;
+}
+
+
+TEST_F(LogTest, ManyThreads) {
+	EXPECT_TRUE(logFromThreads(8, 2000));
+}
+
+
+// Fills the queue of a log system with no thread emptying it.
+static size_t dropped(falcon::LogSystem& log)
+{
+	for(int i = 0; i < falcon::LogSystem::MESSAGE_QUEUE_SIZE + 10; ++i) {
+		log.log("File", 101, falcon::LogSystem::LEVEL::DEBUG, "", "Message");
+	}
+	falcon::LogSystem::Diags diags;
+	log.getDiags(diags);
+	return diags.m_msgsDropped;
+}
+
+
+TEST_F(LogTest, FullNotStarted) {
+	falcon::LogSystem log(false);
+	EXPECT_EQ(10, dropped(log));
+}
+
+
+TEST_F(LogTest, FullStopped) {
+	falcon::LogSystem log;
+	log.stop();
+	EXPECT_EQ(10, dropped(log));
+}
+
+
+TEST_F(LogTest, perf_test_many_threads) {
+	EXPECT_TRUE(logFromThreads(8, 100000));
+}
+
+
 FALCON_TEST_MAIN
 
 
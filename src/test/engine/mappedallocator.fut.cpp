@@ -0,0 +1,133 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: mappedallocator.fut.cpp
+
+  Test for the page allocator backed by a reserved memory range
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/engine/mappedallocator.h>
+#include <falcon/engine/pagedstack.h>
+#include <cstring>
+
+using namespace falcon;
+
+class MappedAllocatorTest: public falcon::testing::TestCase
+{
+public:
+   enum {
+      STACK_PAGE = 4096,
+      STACK_DEPTH = 1000000
+   };
+
+   void SetUp() {}
+   void TearDown() {}
+};
+
+TEST_F(MappedAllocatorTest, arena_smoke)
+{
+   MappedArena arena(1024 * 1024);
+   const size_t page = MappedArena::pageSize();
+   EXPECT_EQ(1024 * 1024, arena.reservedBytes());
+   EXPECT_EQ(0, arena.allocatedBytes());
+
+   char* block = static_cast<char*>(arena.allocate(page + 1));
+   EXPECT_EQ(2 * page, arena.allocatedBytes());
+   std::memset(block, 0xAA, 2 * page);
+   arena.deallocate(block, page + 1);
+   EXPECT_EQ(0, arena.allocatedBytes());
+}
+
+TEST_F(MappedAllocatorTest, arena_reuse)
+{
+   MappedArena arena(1024 * 1024);
+   const size_t page = MappedArena::pageSize();
+
+   void* first = arena.allocate(page);
+   void* second = arena.allocate(page);
+   void* third = arena.allocate(page);
+   arena.deallocate(second, page);
+
+   // the released block is reused, and comes back zeroed.
+   char* again = static_cast<char*>(arena.allocate(page));
+   EXPECT_EQ(second, again);
+   EXPECT_EQ(0, again[0]);
+
+   arena.deallocate(third, page);
+   arena.deallocate(again, page);
+   arena.deallocate(first, page);
+   EXPECT_EQ(first, arena.allocate(page));
+}
+
+TEST_F(MappedAllocatorTest, arena_exhausted)
+{
+   const size_t page = MappedArena::pageSize();
+   MappedArena arena(2 * page);
+
+   char* inside = static_cast<char*>(arena.allocate(2 * page));
+   char* outside = static_cast<char*>(arena.allocate(4 * page));
+   std::memset(outside, 1, 4 * page);
+   EXPECT_EQ(6 * page, arena.allocatedBytes());
+
+   arena.deallocate(outside, 4 * page);
+   arena.deallocate(inside, 2 * page);
+   EXPECT_EQ(0, arena.allocatedBytes());
+}
+
+TEST_F(MappedAllocatorTest, huge_pages)
+{
+   MappedArena arena(MappedArena::HUGE_PAGE_SIZE + 1, true);
+   EXPECT_TRUE(arena.hugePages());
+   EXPECT_EQ(2 * MappedArena::HUGE_PAGE_SIZE, arena.reservedBytes());
+
+   char* block = static_cast<char*>(arena.allocate(MappedArena::HUGE_PAGE_SIZE));
+   EXPECT_EQ(0, reinterpret_cast<uintptr_t>(block) % MappedArena::HUGE_PAGE_SIZE);
+   std::memset(block, 1, MappedArena::HUGE_PAGE_SIZE);
+   arena.deallocate(block, MappedArena::HUGE_PAGE_SIZE);
+}
+
+TEST_F(MappedAllocatorTest, small_requests)
+{
+   auto arena = std::make_shared<MappedArena>(1024 * 1024);
+   MappedAllocator<int64> alloc(arena);
+   int64* small = alloc.allocate(4);
+   EXPECT_EQ(0, arena->allocatedBytes());
+   alloc.deallocate(small, 4);
+
+   MappedAllocator<char> rebound(alloc);
+   EXPECT_TRUE(rebound == alloc);
+   EXPECT_TRUE(rebound != MappedAllocator<char>());
+}
+
+TEST_F(MappedAllocatorTest, paged_stack)
+{
+   using stack_type = PagedStack<int64, MappedAllocator>;
+   auto arena = std::make_shared<MappedArena>(64 * 1024 * 1024);
+   {
+      stack_type stack(STACK_PAGE, 4, stack_type::allocator_type(arena));
+      for(int64 i = 0; i < STACK_DEPTH; ++i) {
+         stack.push(i);
+      }
+      size_t full = arena->allocatedBytes();
+      EXPECT_TRUE(full >= STACK_DEPTH * sizeof(int64));
+      EXPECT_EQ(STACK_DEPTH - 1000, *stack.from_top(1000));
+
+      stack.discard(STACK_DEPTH - 10);
+      stack.shrink_to_fit();
+      EXPECT_EQ(9, stack.top());
+      EXPECT_TRUE(arena->allocatedBytes() < full / 100);
+   }
+   EXPECT_EQ(0, arena->allocatedBytes());
+}
+
+FALCON_TEST_MAIN
+
+/* end of mappedallocator.fut.cpp */
@@ -0,0 +1,206 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: mpscring.fut.cpp
+
+  Test for the multiple producers, single consumer ring
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/mpscring.h>
+#include <falcon/futex.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace falcon;
+
+class MPSCRingTest: public falcon::testing::TestCase
+{
+public:
+   void SetUp() {}
+   void TearDown() {}
+
+   // Values are (producer << 32) | sequence: each producer's ones must come in order.
+   template<typename _Push, typename _Pop>
+   void producers_test(int producers, uint64 count, _Push push, _Pop pop)
+   {
+      std::vector<std::thread> threads;
+      for(int p = 0; p < producers; ++p) {
+         threads.emplace_back([=]() {
+            for(uint64 i = 0; i < count; ++i) {
+               push((uint64(p) << 32) | i);
+            }
+         });
+      }
+
+      std::vector<uint64> next(producers, 0);
+      uint64 received = 0;
+      uint64 disorders = 0;
+      uint64 batch[64];
+      while(received < producers * count) {
+         size_t taken = pop(batch, 64);
+         if(taken == 0) {
+            std::this_thread::yield();
+         }
+         for(size_t i = 0; i < taken; ++i) {
+            uint64 producer = batch[i] >> 32;
+            if((batch[i] & 0xffffffff) != next[producer]++) {
+               ++disorders;
+            }
+         }
+         received += taken;
+      }
+      for(auto& thread: threads) {
+         thread.join();
+      }
+
+      EXPECT_EQ(0, disorders);
+      for(int p = 0; p < producers; ++p) {
+         EXPECT_EQ(count, next[p]);
+      }
+   }
+};
+
+TEST_F(MPSCRingTest, smoke)
+{
+   MPSCRing<int> ring(5);
+   EXPECT_EQ(8u, ring.capacity());
+   EXPECT_TRUE(ring.empty());
+
+   int value = 0;
+   EXPECT_FALSE(ring.pop(value));
+   EXPECT_EQ(1u, ring.push(10));
+   EXPECT_EQ(2u, ring.push(20));
+   EXPECT_FALSE(ring.empty());
+   EXPECT_EQ(2u, ring.size());
+   EXPECT_TRUE(ring.pop(value));
+   EXPECT_EQ(10, value);
+   EXPECT_TRUE(ring.pop(value));
+   EXPECT_EQ(20, value);
+   EXPECT_TRUE(ring.empty());
+}
+
+TEST_F(MPSCRingTest, full)
+{
+   MPSCRing<int> ring(4);
+   for(int i = 0; i < 4; ++i) {
+      EXPECT_EQ(size_t(i + 1), ring.push(i));
+   }
+   EXPECT_EQ(0u, ring.push(4));
+   EXPECT_EQ(4u, ring.size());
+
+   int value = 0;
+   EXPECT_TRUE(ring.pop(value));
+   EXPECT_EQ(0, value);
+   EXPECT_EQ(4u, ring.push(4));
+   EXPECT_EQ(0u, ring.push(5));
+}
+
+TEST_F(MPSCRingTest, wrap_batches)
+{
+   MPSCRing<int> ring(8);
+   int values[8];
+   int next = 0;
+   int expected = 0;
+   for(int round = 0; round < 100; ++round) {
+      for(int i = 0; i < 5; ++i) {
+         EXPECT_NE(0u, ring.push(next++));
+      }
+      size_t taken = ring.pop(values, 3);
+      EXPECT_EQ(3u, taken);
+      taken += ring.pop(values + 3, 8);
+      EXPECT_EQ(5u, taken);
+      for(size_t i = 0; i < taken; ++i) {
+         EXPECT_EQ(expected++, values[i]);
+      }
+   }
+   EXPECT_TRUE(ring.empty());
+}
+
+TEST_F(MPSCRingTest, producers)
+{
+   MPSCRing<uint64> ring(64);
+   producers_test(4, 50000,
+         [&](uint64 value) {
+            while(ring.push(value) == 0) {
+               std::this_thread::yield();
+            }
+         },
+         [&](uint64* values, size_t count) { return ring.pop(values, count); });
+}
+
+TEST_F(MPSCRingTest, doorbell)
+{
+   // the consumer sleeps until rung, and no ring is lost.
+   MPSCRing<int> ring(16);
+   Doorbell doorbell;
+   std::atomic<int> received{0};
+   std::thread consumer([&]() {
+      int value;
+      while(received < 1000) {
+         if(ring.empty()) {
+            doorbell.wait([&]() { return !ring.empty(); });
+         }
+         while(ring.pop(value)) {
+            ++received;
+         }
+      }
+   });
+   for(int i = 0; i < 1000; ++i) {
+      while(ring.push(i) == 0) {
+         std::this_thread::yield();
+      }
+      doorbell.ring();
+      if(i % 100 == 0) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+   }
+   consumer.join();
+   EXPECT_EQ(1000, received);
+}
+
+TEST_F(MPSCRingTest, perf_test_ring_producers)
+{
+   MPSCRing<uint64> ring(4096);
+   producers_test(4, 2000000,
+         [&](uint64 value) {
+            while(ring.push(value) == 0) {
+               std::this_thread::yield();
+            }
+         },
+         [&](uint64* values, size_t count) { return ring.pop(values, count); });
+}
+
+TEST_F(MPSCRingTest, perf_test_mutex_producers)
+{
+   std::mutex mutex;
+   std::deque<uint64> queue;
+   producers_test(4, 2000000,
+         [&](uint64 value) {
+            std::lock_guard<std::mutex> guard(mutex);
+            queue.push_back(value);
+         },
+         [&](uint64* values, size_t count) {
+            std::lock_guard<std::mutex> guard(mutex);
+            size_t taken = 0;
+            while(taken < count && !queue.empty()) {
+               values[taken++] = queue.front();
+               queue.pop_front();
+            }
+            return taken;
+         });
+}
+
+FALCON_TEST_MAIN
+
+/* end of mpscring.fut.cpp */
@@ -17,7 +17,13 @@ Released under Apache 2.0 License.
 #include <falcon/engine/pagedstack.h>
 #include <variant>
 #include <functional>
+#include <list>
 #include <sstream>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <iterator>
+#include <utility>
 
 #include <iostream>
 
@@ -104,9 +110,12 @@ public:
 
       template <class U> struct rebind { typedef TestAllocator<U> other; };
 
-      TestAllocator()noexcept  :m_counters{0} {}
+      TestAllocator()noexcept  :m_counters{0}, m_large_counters{0} {}
       template <typename U>
-      TestAllocator(const TestAllocator<U>& other) noexcept:m_counters{other.m_counters} {}
+      TestAllocator(const TestAllocator<U>& other) noexcept:
+            m_counters{other.m_counters},
+            m_large_counters{other.m_large_counters}
+      {}
 
       TestAllocator(TestAllocator&& other) noexcept:
     	  m_counters(other.m_counters),
@@ -473,10 +482,11 @@ TEST_F(PagedStackTest, sync_iterator_shrink)
       EXPECT_EQ(5, std::get<int>(five));
       EXPECT_EQ(4, std::get<int>(four));
 
-      // The shrink-to-fit request will be fulfilled later.
+      // The discarded page will be freed later.
       m_stack.shrink_to_fit();
       m_stack.getStats(blocks, depth, curBlock, curData);
-      EXPECT_EQ(blocks, 2);
+      EXPECT_EQ(blocks, 1);
+      EXPECT_EQ(1, m_stack.quarantined());
 
       int i = 2;
       for(; si != m_stack.sync_end(); ++si) {
@@ -489,6 +499,32 @@ TEST_F(PagedStackTest, sync_iterator_shrink)
 
    m_stack.getStats(blocks, depth, curBlock, curData);
    EXPECT_EQ(1, blocks);
+   EXPECT_EQ(0, m_stack.quarantined());
+}
+
+TEST_F(PagedStackTest, deferred_reclaim)
+{
+   m_stack.deferred_reclaim(true);
+   for(int i = 0; i < 20; ++i) {
+      m_stack.push(i);
+   }
+   m_stack.discard(18);
+   m_stack.shrink_to_fit();
+   check_stats(1, 1, 2);
+   EXPECT_EQ(5, m_stack.quarantined());
+
+   // growing takes the pages back from the quarantine.
+   m_stack.push(2, 3, 4);
+   check_stats(3, 2, 1);
+   EXPECT_EQ(3, m_stack.quarantined());
+
+   size_t freed = 0;
+   std::thread reclaimer([&]() { freed = m_stack.reclaim(); });
+   reclaimer.join();
+   EXPECT_EQ(3, freed);
+   EXPECT_EQ(0, m_stack.quarantined());
+   EXPECT_EQ(4, std::get<int>(m_stack.top()));
+   EXPECT_EQ(5, m_stack.size());
 }
 
 
@@ -530,6 +566,70 @@ TEST_F(PagedStackTest, from_top)
          m_stack.from_top(6), m_stack.rend());
 }
 
+TEST_F(PagedStackTest, from_top_across_pages)
+{
+   for(int i = 0; i < 18; ++i) {
+      m_stack.push(i);
+   }
+   EXPECT_EQ(18, m_stack.size());
+   EXPECT_EQ(17, std::get<int>(*m_stack.from_top(1)));
+   EXPECT_EQ(14, std::get<int>(*m_stack.from_top(4)));
+   EXPECT_EQ(13, std::get<int>(*m_stack.from_top(5)));
+   EXPECT_EQ(0, std::get<int>(*m_stack.from_top(18)));
+
+   m_stack.discard(7);
+   EXPECT_EQ(11, m_stack.size());
+   EXPECT_EQ(10, std::get<int>(*m_stack.from_top(1)));
+   EXPECT_EQ(3, std::get<int>(*m_stack.from_top(8)));
+}
+
+TEST_F(PagedStackTest, size_after_mixed_operations)
+{
+   EXPECT_EQ(0, m_stack.size());
+   m_stack.push(1, 2, 3, 4, 5, 6, 7, 8, 9);
+   EXPECT_EQ(9, m_stack.size());
+   m_stack.push_emplace(10);
+   EXPECT_EQ(10, m_stack.size());
+   m_stack.pop();
+   datatype a, b;
+   m_stack.pop(a, b);
+   EXPECT_EQ(7, m_stack.size());
+   m_stack.pop_reverse(a, b);
+   EXPECT_EQ(5, m_stack.size());
+   m_stack.discard(m_stack.from_top(2));
+   EXPECT_EQ(3, m_stack.size());
+   EXPECT_EQ(3, std::get<int>(m_stack.top()));
+   m_stack.clear();
+   EXPECT_EQ(0, m_stack.size());
+   EXPECT_TRUE(m_stack.empty());
+   check_stats(4, 1, 0);
+}
+
+TEST_F(PagedStackTest, iterator_arithmetic)
+{
+   for(int i = 0; i < 18; ++i) {
+      m_stack.push(i);
+   }
+
+   auto iter = m_stack.begin();
+   iter += 9;
+   EXPECT_EQ(8, std::get<int>(*iter));
+   iter -= 5;
+   EXPECT_EQ(13, std::get<int>(*iter));
+   iter += 13;
+   EXPECT_EQ(0, std::get<int>(*iter));
+   ++iter;
+   EXPECT_TRUE(iter == m_stack.end());
+
+   auto riter = m_stack.rbegin();
+   riter += 17;
+   EXPECT_EQ(17, std::get<int>(*riter));
+   riter -= 12;
+   EXPECT_EQ(5, std::get<int>(*riter));
+   riter += 13;
+   EXPECT_TRUE(riter == m_stack.rend());
+}
+
 TEST_F(PagedStackTest, peek)
 {
    m_stack.push("bottom", 1, 2, 3, "top");
@@ -674,6 +774,234 @@ TEST_F(PagedStackTest, pop_reverse)
    EXPECT_STREQ("new top", std::get<std::string>(m_stack.top()));
 }
 
+TEST_F(PagedStackTest, push_range)
+{
+   m_stack.push("bottom");
+   std::vector<datatype> values;
+   for(int i = 0; i < 10; ++i) {
+      values.push_back(i);
+   }
+   m_stack.push_range(values.begin(), values.end());
+   EXPECT_EQ(11, m_stack.size());
+   EXPECT_EQ(9, std::get<int>(m_stack.top()));
+   EXPECT_EQ(0, std::get<int>(*m_stack.from_top(10)));
+   check_stats(4, 3, 3);
+
+   std::list<datatype> more{"a", "b"};
+   m_stack.push_range(more.begin(), more.end());
+   EXPECT_STREQ("b", std::get<std::string>(m_stack.top()));
+   EXPECT_EQ(13, m_stack.size());
+}
+
+TEST_F(PagedStackTest, pop_range)
+{
+   m_stack.push("bottom", 0, 1, 2, 3, 4, 5, 6, 7);
+   std::vector<datatype> values;
+   m_stack.pop_range(std::back_inserter(values), 6);
+   EXPECT_EQ(6, values.size());
+   EXPECT_EQ(2, std::get<int>(values.front()));
+   EXPECT_EQ(7, std::get<int>(values.back()));
+   EXPECT_EQ(1, std::get<int>(m_stack.top()));
+   EXPECT_EQ(3, m_stack.size());
+
+   m_stack.pop_range(std::back_inserter(values), 3);
+   EXPECT_TRUE(m_stack.empty());
+   EXPECT_STREQ("bottom", std::get<std::string>(values[6]));
+}
+
+TEST_F(PagedStackTest, range_trivial)
+{
+   falcon::PagedStack<int64_t> stack(4, 2);
+   int64_t values[11];
+   for(int i = 0; i < 11; ++i) {
+      values[i] = i;
+   }
+   stack.push(-1);
+   stack.push_range(values, values + 11);
+   EXPECT_EQ(12, stack.size());
+   EXPECT_EQ(10, stack.top());
+
+   int64_t out[12] = {};
+   int64_t* end = stack.pop_range(out, 12);
+   EXPECT_TRUE(end == out + 12);
+   EXPECT_EQ(-1, out[0]);
+   EXPECT_EQ(0, out[1]);
+   EXPECT_EQ(10, out[11]);
+   EXPECT_TRUE(stack.empty());
+}
+
+TEST_F(PagedStackTest, range_converting)
+{
+   falcon::PagedStack<int64_t> stack(4, 2);
+   for(int64_t i = 0; i < 11; ++i) {
+      stack.push(i * 3);
+   }
+
+   // one more slot, that must be left alone.
+   int32_t narrow[12];
+   narrow[11] = -7;
+   int32_t* nend = stack.pop_range(narrow, 11);
+   EXPECT_TRUE(nend == narrow + 11);
+   EXPECT_EQ(0, narrow[0]);
+   EXPECT_EQ(15, narrow[5]);
+   EXPECT_EQ(30, narrow[10]);
+   EXPECT_EQ(-7, narrow[11]);
+   EXPECT_TRUE(stack.empty());
+
+   for(int64_t i = 0; i < 11; ++i) {
+      stack.push(i * 3);
+   }
+   double wide[11] = {};
+   double* wend = stack.pop_range(wide, 11);
+   EXPECT_TRUE(wend == wide + 11);
+   EXPECT_TRUE(wide[0] == 0.0);
+   EXPECT_TRUE(wide[5] == 15.0);
+   EXPECT_TRUE(wide[10] == 30.0);
+   EXPECT_TRUE(stack.empty());
+}
+
+TEST_F(PagedStackTest, fork)
+{
+   for(int i = 0; i < 10; ++i) {
+      m_stack.push(i);
+   }
+   PagedStack child = m_stack.fork();
+   EXPECT_EQ(10, child.size());
+   EXPECT_EQ(9, std::get<int>(child.top()));
+   EXPECT_EQ(4, std::get<int>(*child.from_top(6)));
+
+   m_stack.push(100);
+   child.push(200);
+
+   std::vector<datatype> parentValues;
+   std::vector<datatype> childValues;
+   m_stack.pop_range(std::back_inserter(parentValues), 11);
+   child.pop_range(std::back_inserter(childValues), 11);
+   for(int i = 0; i < 10; ++i) {
+      EXPECT_EQ(i, std::get<int>(parentValues[i]));
+      EXPECT_EQ(i, std::get<int>(childValues[i]));
+   }
+   EXPECT_EQ(100, std::get<int>(parentValues[10]));
+   EXPECT_EQ(200, std::get<int>(childValues[10]));
+   EXPECT_TRUE(m_stack.empty());
+   EXPECT_TRUE(child.empty());
+
+   // the stacks are still usable after dropping the shared pages.
+   m_stack.push(1, 2, 3, 4, 5);
+   child.push(6);
+   EXPECT_EQ(5, std::get<int>(m_stack.top()));
+   EXPECT_EQ(6, std::get<int>(child.top()));
+}
+
+TEST_F(PagedStackTest, fork_copy_on_write)
+{
+   // two full pages, shared by the forked stack.
+   m_stack.push("s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7");
+   {
+      PagedStack child = m_stack.fork();
+
+      m_stack.top("changed");
+      EXPECT_STREQ("changed", std::get<std::string>(m_stack.top()));
+      EXPECT_STREQ("s7", std::get<std::string>(child.top()));
+
+      m_stack.discard(5);
+      EXPECT_STREQ("s2", std::get<std::string>(m_stack.top()));
+      EXPECT_EQ(8, child.size());
+      EXPECT_STREQ("s7", std::get<std::string>(child.top()));
+      EXPECT_STREQ("s0", std::get<std::string>(*child.from_top(8)));
+
+      child.pop();
+      child.pop();
+      EXPECT_STREQ("s5", std::get<std::string>(child.top()));
+      check_stats(2, 1, 3);
+   }
+   EXPECT_STREQ("s0", std::get<std::string>(*m_stack.from_top(3)));
+   m_stack.push("s3", "s4");
+   EXPECT_STREQ("s4", std::get<std::string>(m_stack.top()));
+}
+
+TEST_F(PagedStackTest, fork_write_through_iterators)
+{
+   // two full pages, shared by the forked stack.
+   m_stack.push("s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7");
+   PagedStack child = m_stack.fork();
+
+   *child.from_top(8) = "child";
+   EXPECT_STREQ("child", std::get<std::string>(*child.from_top(8)));
+   EXPECT_STREQ("s0", std::get<std::string>(*std::as_const(m_stack).from_top(8)));
+
+   // the parent kept the pages, and has them to itself now.
+   *m_stack.begin() = "parent";
+   EXPECT_STREQ("parent", std::get<std::string>(m_stack.top()));
+   EXPECT_STREQ("s7", std::get<std::string>(child.top()));
+
+   for(auto& value: child) {
+      value = "all";
+   }
+   EXPECT_STREQ("s0", std::get<std::string>(*m_stack.from_top(8)));
+   EXPECT_STREQ("all", std::get<std::string>(*std::as_const(child).from_top(8)));
+   EXPECT_STREQ("parent", std::get<std::string>(m_stack.top()));
+}
+
+TEST_F(PagedStackTest, fork_iterators_under_lock)
+{
+   m_stack.push("s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7");
+   PagedStack child = m_stack.fork();
+   {
+      // the mutable iterators must not lock again.
+      PagedStack::lock_guard guard(&child);
+      *child.begin() = "locked";
+   }
+   EXPECT_STREQ("locked", std::get<std::string>(child.top()));
+   EXPECT_STREQ("s7", std::get<std::string>(m_stack.top()));
+}
+
+TEST_F(PagedStackTest, fork_outlives_parent)
+{
+   std::unique_ptr<PagedStack> child;
+   {
+      PagedStack parent(4, 2);
+      for(int i = 0; i < 13; ++i) {
+         parent.push(std::to_string(i));
+      }
+      child = std::make_unique<PagedStack>(parent, PagedStack::fork_tag());
+      auto grandchild = child->fork();
+      parent.discard(13);
+      grandchild.push("g");
+   }
+   EXPECT_EQ(13, child->size());
+   EXPECT_STREQ("12", std::get<std::string>(child->top()));
+   EXPECT_STREQ("0", std::get<std::string>(*child->from_top(13)));
+   child->discard(6);
+   EXPECT_STREQ("6", std::get<std::string>(child->top()));
+}
+
+TEST_F(PagedStackTest, fork_allocations)
+{
+   SharedMem dataAlloc;
+   SharedMem pageAlloc;
+
+   using dstack = falcon::PagedStack<std::string, TestAllocator>;
+   {
+      dstack parent(4, 2, dstack::allocator_type(&pageAlloc, &dataAlloc));
+      for(int i = 0; i < 10; ++i) {
+         parent.push(std::to_string(i));
+      }
+      size_t pages = dataAlloc.m_allocCount;
+      {
+         dstack child(parent, dstack::fork_tag());
+         // the copy of the topmost page, and the directory.
+         EXPECT_EQ(pages + 2, dataAlloc.m_allocCount);
+         child.discard(9);
+         EXPECT_STREQ("0", child.top());
+      }
+      EXPECT_STREQ("9", parent.top());
+   }
+
+   EXPECT_EQ(dataAlloc.m_deallocCount, dataAlloc.m_allocCount);
+   EXPECT_EQ(pageAlloc.m_deallocCount, pageAlloc.m_allocCount);
+}
+
 TEST_F(PagedStackTest, allocator_smoke)
 {
    SharedMem dataAlloc;
@@ -684,9 +1012,10 @@ TEST_F(PagedStackTest, allocator_smoke)
       auto testalloc = dstack(4,2,
             dstack::allocator_type(&pageAlloc, &dataAlloc));
 
+      // two pages of 4 elements, and a directory of 2 pages.
       EXPECT_EQ(2, dataAlloc.m_allocCount);
       EXPECT_EQ(8, dataAlloc.m_allocSize);
-      EXPECT_EQ(2, pageAlloc.m_allocCount);
+      EXPECT_EQ(1, pageAlloc.m_allocCount);
       EXPECT_EQ(2, pageAlloc.m_allocSize);
    }
 
@@ -711,10 +1040,12 @@ TEST_F(PagedStackTest, allocator)
             "nine", "ten", "eleven", "twelve" /* page 3 */
       );
 
-      EXPECT_EQ(4, dataAlloc.m_allocCount);
-      EXPECT_EQ(16, dataAlloc.m_allocSize);
-      EXPECT_EQ(4, pageAlloc.m_allocCount);
-      EXPECT_EQ(4, pageAlloc.m_allocSize);
+      // four pages of 4 elements; the directory grown to 4 pages
+      // is large enough to be counted with the data.
+      EXPECT_EQ(5, dataAlloc.m_allocCount);
+      EXPECT_EQ(20, dataAlloc.m_allocSize);
+      EXPECT_EQ(1, pageAlloc.m_allocCount);
+      EXPECT_EQ(2, pageAlloc.m_allocSize);
 
       std::string twelve, eleven, ten, nine, eight;
       testalloc.pop(twelve, eleven, ten, nine, eight);
@@ -727,10 +1058,10 @@ TEST_F(PagedStackTest, allocator)
       // we expect no further allocation to take place...
       testalloc.push(twelve, eleven, ten, nine, eight, "thirtheen");
 
-      EXPECT_EQ(4, dataAlloc.m_allocCount);
-      EXPECT_EQ(16, dataAlloc.m_allocSize);
-      EXPECT_EQ(4, pageAlloc.m_allocCount);
-      EXPECT_EQ(4, pageAlloc.m_allocSize);
+      EXPECT_EQ(5, dataAlloc.m_allocCount);
+      EXPECT_EQ(20, dataAlloc.m_allocSize);
+      EXPECT_EQ(1, pageAlloc.m_allocCount);
+      EXPECT_EQ(2, pageAlloc.m_allocSize);
    }
 
    EXPECT_EQ(dataAlloc.m_deallocCount, dataAlloc.m_allocCount);
@@ -739,6 +1070,74 @@ TEST_F(PagedStackTest, allocator)
    EXPECT_EQ(pageAlloc.m_deallocSize, pageAlloc.m_allocSize);
 }
 
+TEST_F(PagedStackTest, spsc_snapshot)
+{
+   falcon::PagedStack<int64_t, std::allocator, falcon::spsc_mutex> stack(4, 2);
+   for(int64_t i = 0; i < 100; ++i) {
+      stack.push(i);
+   }
+
+   std::vector<int64_t> copy;
+   stack.snapshot(copy);
+   EXPECT_EQ(100, copy.size());
+   EXPECT_EQ(0, copy[0]);
+   EXPECT_EQ(99, copy[99]);
+
+   stack.discard(10);
+   stack.shrink_to_fit();
+   EXPECT_EQ(90, stack.observe([](int64_t){}));
+   stack.snapshot(copy);
+   EXPECT_EQ(90, copy.size());
+   EXPECT_EQ(89, copy.back());
+}
+
+TEST_F(PagedStackTest, spsc_concurrent_observer)
+{
+   using stack_type = falcon::PagedStack<int64_t, std::allocator, falcon::spsc_mutex>;
+   stack_type stack(4, 2);
+   std::atomic<bool> done{false};
+   std::atomic<int> errors{0};
+   std::atomic<int> samples{0};
+
+   // the owner keeps each element equal to its position, except for the
+   // top, that is set to -1 for a moment before popping it.
+   std::thread owner([&]() {
+      for(int round = 0; round < 2000; ++round) {
+         size_t depth = (round * 37) % 300;
+         while(stack.size() < depth) {
+            stack.push(static_cast<int64_t>(stack.size()));
+         }
+         while(stack.size() > depth / 2) {
+            stack.top(-1);
+            stack.pop();
+         }
+         if(round % 100 == 0) {
+            stack.shrink_to_fit();
+         }
+      }
+      done = true;
+   });
+
+   std::thread observer([&]() {
+      std::vector<int64_t> copy;
+      while(!done) {
+         stack.snapshot(copy);
+         for(size_t pos = 0; pos < copy.size(); ++pos) {
+            bool top = pos + 1 == copy.size();
+            if(copy[pos] != static_cast<int64_t>(pos) && !(top && copy[pos] == -1)) {
+               ++errors;
+            }
+         }
+         ++samples;
+      }
+   });
+
+   owner.join();
+   observer.join();
+   EXPECT_EQ(0, errors.load());
+   EXPECT_TRUE(samples.load() > 0);
+}
+
 FALCON_TEST_MAIN
 
 /* end of pagedstack.fut.cpp */
@@ -0,0 +1,319 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: pagedstackperf.fut.cpp
+
+  Microbenchmarks of PagedStack against a list of vectors
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/engine/pagedstack.h>
+#include <falcon/engine/mappedallocator.h>
+#include <falcon/types.h>
+#include <list>
+#include <vector>
+
+using namespace falcon;
+
+/**
+ * The storage PagedStack used before the page directory: a list of
+ * vectors, walked to reach the pages below the top one.
+ */
+template<typename _T>
+class ListStack
+{
+public:
+   ListStack(size_t pageSize, size_t prealloc): m_pageSize(pageSize), m_allocSize(prealloc) {
+      grow();
+      m_cur = m_base.begin();
+   }
+
+   void push(const _T& value) {
+      if(m_cur->size() == m_pageSize) {
+         if(++m_cur == m_base.end()) {
+            --m_cur;
+            grow();
+            ++m_cur;
+         }
+      }
+      m_cur->push_back(value);
+   }
+
+   const _T& top() const { return m_cur->back(); }
+
+   void pop() {
+      m_cur->pop_back();
+      if(m_cur->empty() && m_cur != m_base.begin()) {
+         --m_cur;
+      }
+   }
+
+   const _T& from_top(size_t depth) const {
+      auto page = m_cur;
+      while(depth > page->size()) {
+         depth -= page->size();
+         --page;
+      }
+      return (*page)[page->size() - depth];
+   }
+
+   size_t size() const {
+      size_t count = 0;
+      for(auto page = m_base.begin(); page != m_cur; ++page) {
+         count += page->size();
+      }
+      return count + m_cur->size();
+   }
+
+private:
+   size_t m_pageSize;
+   size_t m_allocSize;
+   std::list<std::vector<_T>> m_base;
+   typename std::list<std::vector<_T>>::iterator m_cur;
+
+   void grow() {
+      for(size_t i = 0; i < m_allocSize; ++i) {
+         m_base.emplace_back();
+         m_base.back().reserve(m_pageSize);
+      }
+   }
+};
+
+
+class PagedStackPerfTest: public falcon::testing::TestCase
+{
+public:
+   enum {
+      PAGE_SIZE = 256,
+      PERF_COUNT = 4000000,
+      PERF_DEPTH = 16384,
+      PEEK_COUNT = 200000,
+      FRAME_SIZE = 24,
+      SPAWN_COUNT = 20000
+   };
+
+   // Pages of the stacks on a MappedArena: smaller ones would go to the heap.
+   static constexpr size_t MAPPED_PAGE_SIZE = MappedArena::HUGE_PAGE_SIZE / sizeof(int64);
+
+   void SetUp() {}
+   void TearDown() {}
+
+   template<typename _Stack>
+   void push_pop_test(_Stack& stack)
+   {
+      int64 sum = 0;
+      for(int i = 0; i < PERF_COUNT / PERF_DEPTH; ++i) {
+         for(int j = 0; j < PERF_DEPTH; ++j) {
+            stack.push(static_cast<int64>(j));
+         }
+         for(int j = 0; j < PERF_DEPTH; ++j) {
+            sum += stack.top();
+            stack.pop();
+         }
+      }
+      EXPECT_EQ(static_cast<int64>(PERF_COUNT / PERF_DEPTH) * PERF_DEPTH * (PERF_DEPTH - 1) / 2, sum);
+   }
+
+   /** Pushes and pops whole call frames; bulk is true to move them as ranges. */
+   template<typename _Stack>
+   void frame_test(_Stack& stack, bool bulk)
+   {
+      int64 frame[FRAME_SIZE];
+      for(int j = 0; j < FRAME_SIZE; ++j) {
+         frame[j] = j;
+      }
+      int64 sum = 0;
+      const int depth = PERF_DEPTH / FRAME_SIZE;
+      for(int i = 0; i < PERF_COUNT / PERF_DEPTH; ++i) {
+         for(int j = 0; j < depth; ++j) {
+            if(bulk) {
+               stack.push_range(frame, frame + FRAME_SIZE);
+            }
+            else {
+               for(int k = 0; k < FRAME_SIZE; ++k) {
+                  stack.push(frame[k]);
+               }
+            }
+         }
+         for(int j = 0; j < depth; ++j) {
+            if(bulk) {
+               stack.pop_range(frame, FRAME_SIZE);
+            }
+            else {
+               for(int k = FRAME_SIZE; k-- > 0;) {
+                  frame[k] = stack.top();
+                  stack.pop();
+               }
+            }
+            sum += frame[FRAME_SIZE - 1];
+         }
+      }
+      EXPECT_EQ(static_cast<int64>(PERF_COUNT / PERF_DEPTH) * depth * (FRAME_SIZE - 1), sum);
+   }
+
+   /**
+    * Starts a generator on a deep stack many times: the generator stack
+    * receives a frame, runs a little, and goes away.
+    */
+   template<typename _Spawn>
+   void spawn_test(_Spawn spawn)
+   {
+      PagedStack<int64> caller(PAGE_SIZE, 4);
+      std::vector<int64> values;
+      for(int j = 0; j < PERF_DEPTH; ++j) {
+         caller.push(static_cast<int64>(j));
+         values.push_back(j);
+      }
+      int64 sum = 0;
+      for(int i = 0; i < SPAWN_COUNT; ++i) {
+         spawn(caller, values, [&sum](PagedStack<int64>& generator) {
+            for(int k = 0; k < FRAME_SIZE; ++k) {
+               generator.push(static_cast<int64>(k));
+            }
+            sum += generator.top() + *generator.from_top(FRAME_SIZE + 1);
+            generator.discard(FRAME_SIZE + 1);
+         });
+      }
+      EXPECT_EQ(static_cast<int64>(SPAWN_COUNT) * (FRAME_SIZE - 1 + PERF_DEPTH - 1), sum);
+   }
+
+   /**
+    * Calls that return across the end of the directory; trim is true to give
+    * the spare pages back after each return, as an interpreter keeping its
+    * memory low would do without a growth policy.
+    */
+   template<typename _Stack>
+   void boundary_test(_Stack& stack, bool trim)
+   {
+      for(int j = 0; j < PAGE_SIZE * 4; ++j) {
+         stack.push(static_cast<int64>(j));
+      }
+      int64 sum = 0;
+      for(int i = 0; i < PERF_COUNT / FRAME_SIZE; ++i) {
+         for(int k = 0; k < FRAME_SIZE; ++k) {
+            stack.push(static_cast<int64>(k));
+         }
+         sum += stack.top();
+         stack.discard(FRAME_SIZE);
+         if(trim) {
+            stack.shrink_to_fit();
+         }
+      }
+      EXPECT_EQ(static_cast<int64>(PERF_COUNT / FRAME_SIZE) * (FRAME_SIZE - 1), sum);
+   }
+
+   /** Reads at every depth of a deep stack, and asks for its size. */
+   template<typename _Stack, typename _Peek>
+   void peek_test(_Stack& stack, _Peek peek)
+   {
+      for(int j = 0; j < PERF_DEPTH; ++j) {
+         stack.push(static_cast<int64>(j));
+      }
+      int64 sum = 0;
+      for(int i = 0; i < PEEK_COUNT; ++i) {
+         size_t depth = 1 + (i * 7919) % PERF_DEPTH;
+         sum += peek(stack, depth) + static_cast<int64>(stack.size());
+      }
+      EXPECT_NE(0, sum);
+   }
+};
+
+TEST_F(PagedStackPerfTest, perf_test_list_push_pop)
+{
+   ListStack<int64> stack(PAGE_SIZE, 4);
+   push_pop_test(stack);
+}
+
+TEST_F(PagedStackPerfTest, perf_test_paged_push_pop)
+{
+   PagedStack<int64> stack(PAGE_SIZE, 4);
+   push_pop_test(stack);
+}
+
+TEST_F(PagedStackPerfTest, perf_test_paged_push_pop_counters)
+{
+   PagedStack<int64, std::allocator, dummy_mutex, stack_counters> stack(PAGE_SIZE, 4);
+   push_pop_test(stack);
+}
+
+TEST_F(PagedStackPerfTest, perf_test_mapped_push_pop)
+{
+   using stack_type = PagedStack<int64, MappedAllocator>;
+   auto arena = std::make_shared<MappedArena>(MappedArena::DEFAULT_RESERVE, true);
+   stack_type stack(MAPPED_PAGE_SIZE, 4, stack_type::allocator_type(arena));
+   push_pop_test(stack);
+   EXPECT_TRUE(arena->allocatedBytes() > 0);
+}
+
+TEST_F(PagedStackPerfTest, perf_test_paged_frames)
+{
+   PagedStack<int64> stack(PAGE_SIZE, 4);
+   frame_test(stack, false);
+}
+
+TEST_F(PagedStackPerfTest, perf_test_paged_frames_range)
+{
+   PagedStack<int64> stack(PAGE_SIZE, 4);
+   frame_test(stack, true);
+}
+
+TEST_F(PagedStackPerfTest, perf_test_paged_spawn_copy)
+{
+   spawn_test([](PagedStack<int64>&, const std::vector<int64>& values, auto run) {
+      PagedStack<int64> generator(PAGE_SIZE, 4);
+      generator.push_range(values.data(), values.data() + values.size());
+      run(generator);
+   });
+}
+
+TEST_F(PagedStackPerfTest, perf_test_paged_spawn_fork)
+{
+   spawn_test([](PagedStack<int64>& caller, const std::vector<int64>&, auto run) {
+      PagedStack<int64> generator = caller.fork();
+      run(generator);
+   });
+}
+
+TEST_F(PagedStackPerfTest, perf_test_paged_boundary_shrink)
+{
+   PagedStack<int64> stack(PAGE_SIZE, 4);
+   boundary_test(stack, true);
+}
+
+TEST_F(PagedStackPerfTest, perf_test_paged_boundary_geometric)
+{
+   PagedStack<int64, std::allocator, dummy_mutex, no_stack_stats, geometric_growth> stack(PAGE_SIZE, 4);
+   boundary_test(stack, false);
+}
+
+TEST_F(PagedStackPerfTest, perf_test_list_peek)
+{
+   ListStack<int64> stack(PAGE_SIZE, 4);
+   peek_test(stack, [](const ListStack<int64>& s, size_t depth) { return s.from_top(depth); });
+}
+
+TEST_F(PagedStackPerfTest, perf_test_paged_peek)
+{
+   PagedStack<int64> stack(PAGE_SIZE, 4);
+   peek_test(stack, [](const PagedStack<int64>& s, size_t depth) { return *s.from_top(depth); });
+}
+
+TEST_F(PagedStackPerfTest, perf_test_mapped_peek)
+{
+   using stack_type = PagedStack<int64, MappedAllocator>;
+   auto arena = std::make_shared<MappedArena>(MappedArena::DEFAULT_RESERVE, true);
+   stack_type stack(MAPPED_PAGE_SIZE, 4, stack_type::allocator_type(arena));
+   peek_test(stack, [](const stack_type& s, size_t depth) { return *s.from_top(depth); });
+   EXPECT_TRUE(arena->allocatedBytes() > 0);
+}
+
+FALCON_TEST_MAIN
+
+/* end of pagedstackperf.fut.cpp */
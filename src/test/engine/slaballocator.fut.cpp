@@ -0,0 +1,146 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: slaballocator.fut.cpp
+
+  Test for the slab allocator of the deep item payloads
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/engine/slaballocator.h>
+#include <falcon/engine/item.h>
+#include <thread>
+#include <vector>
+
+using namespace falcon;
+
+class SlabAllocatorTest: public falcon::testing::TestCase
+{
+public:
+   enum {
+      PERF_COUNT = 1000000,
+      PERF_DEPTH = 1024
+   };
+
+   struct Payload {
+      int64 m_value;
+      char m_padding[40];
+   };
+
+   void SetUp() {}
+   void TearDown() {}
+
+   template<template<typename> typename _Allocator>
+   void churn_test(int count, int depth)
+   {
+      using allocator = _Allocator<Payload>;
+      allocator alloc;
+      std::vector<Payload*> live;
+      live.reserve(depth);
+      int64 sum = 0;
+      for(int i = 0; i < count / depth; ++i) {
+         for(int j = 0; j < depth; ++j) {
+            Payload* p = alloc.allocate(1);
+            p->m_value = j;
+            live.push_back(p);
+         }
+         for(Payload* p: live) {
+            sum += p->m_value;
+            alloc.deallocate(p, 1);
+         }
+         live.clear();
+      }
+      EXPECT_EQ(static_cast<int64>(count / depth) * depth * (depth - 1) / 2, sum);
+   }
+};
+
+TEST_F(SlabAllocatorTest, smoke)
+{
+   using allocator = SlabAllocator<Payload>;
+   size_t base = allocator::stats().m_liveObjects;
+
+   allocator alloc;
+   Payload* one = alloc.allocate(1);
+   Payload* two = alloc.allocate(1);
+   EXPECT_TRUE(one != two);
+   EXPECT_EQ(base + 2, allocator::stats().m_liveObjects);
+   EXPECT_EQ((base + 2) * sizeof(Payload), allocator::stats().m_liveBytes);
+   EXPECT_TRUE(allocator::stats().m_slabs > 0);
+
+   alloc.deallocate(one, 1);
+   alloc.deallocate(two, 1);
+   EXPECT_EQ(base, allocator::stats().m_liveObjects);
+
+   // Blocks are recycled
+   Payload* again = alloc.allocate(1);
+   EXPECT_TRUE(again == two);
+   alloc.deallocate(again, 1);
+}
+
+TEST_F(SlabAllocatorTest, items)
+{
+   using allocator = StringHandler::allocator_type;
+   size_t base = allocator::stats().m_liveObjects;
+   {
+      Item item("A string too long to be short");
+      Item copy(item);
+      EXPECT_EQ(base + 1, allocator::stats().m_liveObjects);
+
+      copy.modify<String>() += "!";
+      EXPECT_EQ(base + 2, allocator::stats().m_liveObjects);
+      EXPECT_STREQ("A string too long to be short!", copy.toString());
+   }
+   EXPECT_EQ(base, allocator::stats().m_liveObjects);
+}
+
+TEST_F(SlabAllocatorTest, cross_thread)
+{
+   using allocator = SlabAllocator<Payload>;
+   size_t base = allocator::stats().m_liveObjects;
+
+   const int count = 10000;
+   std::vector<Payload*> blocks(count);
+   std::thread producer([&](){
+      allocator alloc;
+      for(int i = 0; i < count; ++i) {
+         blocks[i] = alloc.allocate(1);
+         blocks[i]->m_value = i;
+      }
+   });
+   producer.join();
+   EXPECT_EQ(base + count, allocator::stats().m_liveObjects);
+
+   int64 sum = 0;
+   std::thread consumer([&](){
+      allocator alloc;
+      for(Payload* p: blocks) {
+         sum += p->m_value;
+         alloc.deallocate(p, 1);
+      }
+   });
+   consumer.join();
+
+   EXPECT_EQ(static_cast<int64>(count) * (count - 1) / 2, sum);
+   EXPECT_EQ(base, allocator::stats().m_liveObjects);
+}
+
+TEST_F(SlabAllocatorTest, perf_test_std_churn)
+{
+   churn_test<std::allocator>(PERF_COUNT, PERF_DEPTH);
+}
+
+TEST_F(SlabAllocatorTest, perf_test_slab_churn)
+{
+   churn_test<SlabAllocator>(PERF_COUNT, PERF_DEPTH);
+}
+
+FALCON_TEST_MAIN
+
+/* end of slaballocator.fut.cpp */
@@ -0,0 +1,132 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: stackgrowth.fut.cpp
+
+  Test for the growth policies of PagedStack
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/engine/pagedstack.h>
+#include <falcon/engine/stackgrowth.h>
+
+using namespace falcon;
+
+class StackGrowthTest: public falcon::testing::TestCase
+{
+public:
+   template<typename _Growth>
+   using stack_type = PagedStack<int64, std::allocator, dummy_mutex, stack_counters, _Growth>;
+
+   void SetUp() {}
+   void TearDown() {}
+};
+
+TEST_F(StackGrowthTest, fixed)
+{
+   fixed_growth policy;
+   EXPECT_EQ(4, policy.grow(100, 4));
+   EXPECT_EQ(100, policy.trim(1, 100, 4));
+
+   stack_type<fixed_growth> stack(4, 2);
+   for(int64 i = 0; i < 100; ++i) {
+      stack.push(i);
+   }
+   stack.discard(96);
+   StackStats stats = stack.stats();
+   EXPECT_EQ(26, stats.m_pages);
+   EXPECT_EQ(13, stats.m_grows);
+   EXPECT_EQ(0, stats.m_shrinks);
+}
+
+TEST_F(StackGrowthTest, geometric)
+{
+   geometric_growth policy;
+   EXPECT_EQ(4, policy.grow(2, 4));
+   EXPECT_EQ(8, policy.grow(8, 4));
+   // between a quarter and all of the pages used, nothing changes.
+   EXPECT_EQ(16, policy.trim(4, 16, 2));
+   EXPECT_EQ(6, policy.trim(3, 16, 2));
+   EXPECT_EQ(8, policy.trim(1, 8, 8));
+
+   stack_type<geometric_growth> stack(4, 2);
+   for(int64 i = 0; i < 100; ++i) {
+      stack.push(i);
+   }
+   StackStats stats = stack.stats();
+   EXPECT_EQ(32, stats.m_pages);
+   EXPECT_EQ(5, stats.m_grows);
+
+   stack.discard(96);
+   stats = stack.stats();
+   EXPECT_EQ(2, stats.m_pages);
+   EXPECT_EQ(1, stats.m_shrinks);
+   EXPECT_EQ(30, stats.m_shrunkPages);
+   EXPECT_EQ(3, stack.top());
+}
+
+TEST_F(StackGrowthTest, geometric_boundary)
+{
+   stack_type<geometric_growth> stack(4, 2);
+   for(int64 i = 0; i < 8; ++i) {
+      stack.push(i);
+   }
+   // going up and down across the end of the directory.
+   for(int i = 0; i < 10000; ++i) {
+      stack.push(8);
+      stack.pop();
+   }
+   StackStats stats = stack.stats();
+   EXPECT_EQ(4, stats.m_pages);
+   EXPECT_EQ(4, stats.m_allocatedPages);
+   EXPECT_EQ(0, stats.m_shrinks);
+}
+
+TEST_F(StackGrowthTest, adaptive)
+{
+   stack_type<adaptive_growth> stack(4, 2);
+   for(int64 i = 0; i < 160; ++i) {
+      stack.push(i);
+   }
+   EXPECT_EQ(40, stack.stats().m_pages);
+   EXPECT_EQ(20, stack.stats().m_grows);
+
+   for(int i = 0; i < 160; ++i) {
+      stack.pop();
+   }
+   // the first window ends remembering the 40 pages, and keeps them.
+   for(int i = 160; i < adaptive_growth::WINDOW; ++i) {
+      stack.push(1);
+      stack.pop();
+   }
+   EXPECT_EQ(40, stack.stats().m_pages);
+
+   // growing again goes straight to the mark.
+   stack.shrink_to_fit();
+   EXPECT_EQ(1, stack.stats().m_pages);
+   for(int64 i = 0; i < 160; ++i) {
+      stack.push(i);
+   }
+   EXPECT_EQ(40, stack.stats().m_pages);
+   EXPECT_EQ(21, stack.stats().m_grows);
+
+   // a quiet window lets the pages go.
+   stack.clear();
+   for(int i = 0; i < 2 * adaptive_growth::WINDOW; ++i) {
+      stack.push(1);
+      stack.pop();
+   }
+   EXPECT_EQ(2, stack.stats().m_pages);
+   EXPECT_TRUE(stack.empty());
+}
+
+FALCON_TEST_MAIN
+
+/* end of stackgrowth.fut.cpp */
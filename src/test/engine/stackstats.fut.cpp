@@ -0,0 +1,185 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: stackstats.fut.cpp
+
+  Test for the instrumentation of PagedStack
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/engine/pagedstack.h>
+#include <falcon/engine/stackstats.h>
+#include <mutex>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+using namespace falcon;
+
+class StackStatsTest: public falcon::testing::TestCase
+{
+public:
+   using stack_type = PagedStack<int64, std::allocator, std::mutex, stack_counters>;
+
+   void SetUp() {}
+   void TearDown() {}
+};
+
+TEST_F(StackStatsTest, no_stats)
+{
+   PagedStack<int64> stack(4, 2);
+   for(int64 i = 0; i < 10; ++i) {
+      stack.push(i);
+   }
+   StackStats stats = stack.stats();
+   EXPECT_EQ(4, stats.m_pageSize);
+   EXPECT_EQ(2, stats.m_prealloc);
+   EXPECT_EQ(4, stats.m_pages);
+   EXPECT_EQ(10, stats.m_depth);
+   EXPECT_EQ(0, stats.m_highWater);
+   EXPECT_EQ(0, stats.m_ops[StackStats::PUSH]);
+}
+
+TEST_F(StackStatsTest, counters)
+{
+   stack_type stack(4, 2);
+   for(int64 i = 0; i < 10; ++i) {
+      stack.push(i);
+   }
+   int64 a, b;
+   stack.pop(a, b);
+   stack.pop();
+   stack.discard(2);
+   stack.peek(a);
+   EXPECT_EQ(4, stack.top());
+   stack.top(40);
+
+   StackStats stats = stack.stats();
+   EXPECT_EQ(5, stats.m_depth);
+   EXPECT_EQ(10, stats.m_highWater);
+   EXPECT_EQ(4, stats.m_peakPages);
+   EXPECT_EQ(2, stats.m_grows);
+   EXPECT_EQ(4, stats.m_allocatedPages);
+   EXPECT_EQ(0, stats.m_reusedPages);
+   EXPECT_EQ(10, stats.m_ops[StackStats::PUSH]);
+   EXPECT_EQ(2, stats.m_ops[StackStats::POP]);
+   EXPECT_EQ(1, stats.m_ops[StackStats::DISCARD]);
+   EXPECT_EQ(2, stats.m_ops[StackStats::PEEK]);
+   EXPECT_EQ(1, stats.m_ops[StackStats::SET_TOP]);
+}
+
+TEST_F(StackStatsTest, pages)
+{
+   stack_type stack(4, 2);
+   stack.deferred_reclaim(true);
+   int64 values[16] = {};
+   stack.push_range(values, values + 16);
+   stack.pop_range(values, 14);
+   stack.shrink_to_fit();
+
+   StackStats stats = stack.stats();
+   EXPECT_EQ(1, stats.m_shrinks);
+   EXPECT_EQ(3, stats.m_shrunkPages);
+   EXPECT_EQ(1, stats.m_pages);
+   EXPECT_EQ(4, stats.m_peakPages);
+
+   // growing again takes the pages back from the quarantine.
+   stack.push_range(values, values + 10);
+   stats = stack.stats();
+   EXPECT_EQ(2, stats.m_reusedPages);
+   EXPECT_EQ(4, stats.m_allocatedPages);
+   EXPECT_EQ(2, stats.m_ops[StackStats::PUSH_RANGE]);
+   EXPECT_EQ(1, stats.m_ops[StackStats::POP_RANGE]);
+   EXPECT_EQ(1, stats.m_ops[StackStats::SHRINK]);
+
+   {
+      stack_type child = stack.fork();
+      child.pop();
+      EXPECT_EQ(1, child.stats().m_copiedPages);
+      EXPECT_EQ(12, child.stats().m_highWater);
+   }
+   EXPECT_EQ(1, stack.stats().m_ops[StackStats::FORK]);
+}
+
+TEST_F(StackStatsTest, fork_top_frame)
+{
+   stack_type stack(4, 2);
+   for(int64 i = 0; i < 64; ++i) {
+      stack.push(i);
+   }
+   stack_type child = stack.fork();
+
+   // A generator works on its top frame: only the page under it is copied.
+   child.push(100, 101, 102);
+   *child.from_top(5) = 200;
+   child.end();
+   child.rend();
+   EXPECT_EQ(1, child.stats().m_copiedPages);
+   EXPECT_EQ(0, stack.stats().m_copiedPages);
+   EXPECT_EQ(62, *std::as_const(stack).from_top(2));
+
+   // begin() can reach any element, and copies all the pages still shared.
+   *child.begin() = 300;
+   EXPECT_EQ(16, child.stats().m_copiedPages);
+}
+
+TEST_F(StackStatsTest, write)
+{
+   stack_type stack(4, 2);
+   stack.push(1, 2, 3);
+   stack.pop();
+
+   std::ostringstream out;
+   stack.stats().write(out, "vm");
+   std::string text = out.str();
+   EXPECT_NE(std::string::npos, text.find("# TYPE falcon_stack_high_water gauge\n"));
+   EXPECT_NE(std::string::npos, text.find("falcon_stack_high_water{stack=\"vm\"} 3\n"));
+   EXPECT_NE(std::string::npos, text.find("falcon_stack_page_size{stack=\"vm\"} 4\n"));
+   EXPECT_NE(std::string::npos, text.find("falcon_stack_ops_total{stack=\"vm\",op=\"push\"} 1\n"));
+   EXPECT_NE(std::string::npos, text.find("falcon_stack_ops_total{stack=\"vm\",op=\"pop\"} 1\n"));
+}
+
+TEST_F(StackStatsTest, writeAll)
+{
+   stack_type first(4, 2);
+   first.push(1, 2, 3);
+   stack_type second(8, 1);
+   second.push(1);
+
+   std::ostringstream out;
+   StackStats::writeAll(out, {{"first", first.stats()}, {"second", second.stats()}});
+   std::string text = out.str();
+
+   // Each family has a single TYPE line, followed by all its samples.
+   std::istringstream lines(text);
+   std::string line;
+   std::vector<std::string> families;
+   while(std::getline(lines, line)) {
+      if(line.compare(0, 7, "# TYPE ") == 0) {
+         std::string family = line.substr(7, line.find(' ', 7) - 7);
+         for(const std::string& seen: families) {
+            EXPECT_NE(seen, family);
+         }
+         families.push_back(family);
+         continue;
+      }
+      EXPECT_FALSE(families.empty());
+      EXPECT_EQ(families.back() + "{", line.substr(0, families.back().size() + 1));
+   }
+   EXPECT_EQ(14u, families.size());
+
+   EXPECT_NE(std::string::npos, text.find("falcon_stack_high_water{stack=\"first\"} 3\n"
+         "falcon_stack_high_water{stack=\"second\"} 1\n"));
+   EXPECT_NE(std::string::npos, text.find("falcon_stack_ops_total{stack=\"second\",op=\"push\"} 1\n"));
+}
+
+FALCON_TEST_MAIN
+
+/* end of stackstats.fut.cpp */
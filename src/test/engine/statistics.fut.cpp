@@ -0,0 +1,201 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: statistics.fut.cpp
+
+  Test for the per-thread counters and gauges
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/statistics.h>
+#include <falcon/engine/pagedstack.h>
+#include <falcon/engine/stackstats.h>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace falcon;
+
+class StatisticsTest: public falcon::testing::TestCase
+{
+public:
+   void SetUp() {}
+   void TearDown() {}
+
+   template<typename _Counter>
+   void threads_test(_Counter& counter, int threadCount, int perfCount)
+   {
+      std::vector<std::thread> threads;
+      for(int t = 0; t < threadCount; ++t) {
+         threads.emplace_back([&]() {
+            for(int i = 0; i < perfCount; ++i) {
+               add(counter);
+            }
+         });
+      }
+      for(auto& thread: threads) {
+         thread.join();
+      }
+   }
+
+   static void add(Counter& counter) { counter.inc(); }
+   static void add(std::atomic<uint64>& counter) { counter.fetch_add(1, std::memory_order_relaxed); }
+};
+
+TEST_F(StatisticsTest, counter)
+{
+   Counter counter("test_counter_total", "A counter");
+   EXPECT_EQ(0, counter.value());
+   counter.inc();
+   counter.add(10);
+   EXPECT_EQ(11, counter.value());
+   EXPECT_STREQ("test_counter_total", counter.name().c_str());
+
+   int64 value = 0;
+   EXPECT_TRUE(Statistics::find("test_counter_total", value));
+   EXPECT_EQ(11, value);
+   EXPECT_FALSE(Statistics::find("test_none_total", value));
+}
+
+TEST_F(StatisticsTest, threads)
+{
+   Counter counter("test_threads_total", "Added by many threads");
+   counter.add(5);
+   // the threads are gone when it's read: their slots were kept.
+   threads_test(counter, 8, 10000);
+   EXPECT_EQ(80005, counter.value());
+
+   // read while the threads are alive.
+   std::atomic<bool> stop{false};
+   std::atomic<int> ready{0};
+   std::vector<std::thread> threads;
+   for(int t = 0; t < 4; ++t) {
+      threads.emplace_back([&]() {
+         counter.add(1000);
+         ++ready;
+         while(!stop) {
+            std::this_thread::yield();
+         }
+      });
+   }
+   while(ready < 4) {
+      std::this_thread::yield();
+   }
+   EXPECT_EQ(84005, counter.value());
+   stop = true;
+   for(auto& thread: threads) {
+      thread.join();
+   }
+   EXPECT_EQ(84005, counter.value());
+}
+
+TEST_F(StatisticsTest, reused_slots)
+{
+   {
+      Counter first("test_first_total", "Gone soon");
+      first.add(100);
+   }
+   Counter second("test_second_total", "In the slot of the first");
+   EXPECT_EQ(0, second.value());
+}
+
+TEST_F(StatisticsTest, too_many)
+{
+   std::vector<std::unique_ptr<Counter>> counters;
+   bool thrown = false;
+   try {
+      for(int i = 0; i <= ThreadCounters::MAX_COUNTERS; ++i) {
+         counters.emplace_back(new Counter("test_many_total", "One of many"));
+      }
+   }
+   catch(const std::length_error&) {
+      thrown = true;
+   }
+   EXPECT_TRUE(thrown);
+   counters.clear();
+   Counter again("test_again_total", "Room again");
+   again.inc();
+   EXPECT_EQ(1, again.value());
+}
+
+TEST_F(StatisticsTest, gauge)
+{
+   Gauge gauge("test_gauge", "A gauge");
+   gauge.set(10);
+   gauge.add(-3);
+   EXPECT_EQ(7, gauge.value());
+
+   int64 depth = 42;
+   Gauge probed("test_probed", "A probed gauge", [&]() { return depth; });
+   EXPECT_EQ(42, probed.value());
+   depth = 12;
+   int64 value = 0;
+   EXPECT_TRUE(Statistics::find("test_probed", value));
+   EXPECT_EQ(12, value);
+}
+
+TEST_F(StatisticsTest, write)
+{
+   Counter pushes("test_ops_total", "Operations", "op=\"push\"");
+   Counter pops("test_ops_total", "Operations", "op=\"pop\"");
+   Counter morePushes("test_ops_total", "Operations", "op=\"push\"");
+   Gauge gauge("test_level", "A level");
+   pushes.add(2);
+   morePushes.add(3);
+   pops.inc();
+   gauge.set(-4);
+
+   std::ostringstream out;
+   Statistics::write(out);
+   std::string text = out.str();
+   EXPECT_NE(std::string::npos, text.find(
+         "# HELP test_ops_total Operations\n"
+         "# TYPE test_ops_total counter\n"
+         "test_ops_total{op=\"pop\"} 1\n"
+         "test_ops_total{op=\"push\"} 5\n"));
+   EXPECT_NE(std::string::npos, text.find("# TYPE test_level gauge\ntest_level -4\n"));
+}
+
+TEST_F(StatisticsTest, stack_statistics)
+{
+   int64 before = 0;
+   Statistics::find("falcon_stacks_ops_total", before, "op=\"push\"");
+
+   PagedStack<int64, std::allocator, dummy_mutex, stack_statistics> stack(4, 2);
+   for(int64 i = 0; i < 10; ++i) {
+      stack.push(i);
+   }
+   stack.pop();
+
+   int64 value = 0;
+   EXPECT_TRUE(Statistics::find("falcon_stacks_ops_total", value, "op=\"push\""));
+   EXPECT_EQ(before + 10, value);
+   EXPECT_TRUE(Statistics::find("falcon_stacks_allocated_pages_total", value));
+   EXPECT_TRUE(value >= 4);
+}
+
+TEST_F(StatisticsTest, perf_test_counter_threads)
+{
+   Counter counter("test_perf_total", "Added by many threads");
+   threads_test(counter, 4, 20000000);
+   EXPECT_EQ(80000000, counter.value());
+}
+
+TEST_F(StatisticsTest, perf_test_atomic_threads)
+{
+   std::atomic<uint64> counter{0};
+   threads_test(counter, 4, 20000000);
+   EXPECT_EQ(80000000, counter.load());
+}
+
+FALCON_TEST_MAIN
+
+/* end of statistics.fut.cpp */
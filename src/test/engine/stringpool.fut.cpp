@@ -0,0 +1,102 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: stringpool.fut.cpp
+
+  Test for the interned string pool
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/engine/stringpool.h>
+#include <falcon/engine/item.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace falcon;
+
+class StringPoolTest: public falcon::testing::TestCase
+{
+public:
+   StringPool m_pool;
+
+   void SetUp() {}
+   void TearDown() {}
+};
+
+TEST_F(StringPoolTest, smoke)
+{
+   EXPECT_EQ(0, m_pool.size());
+   Atom* atom = m_pool.intern("Hello world");
+   EXPECT_STREQ("Hello world", atom->value());
+   EXPECT_EQ(StringPool::hash("Hello world", 11), atom->hash());
+   EXPECT_EQ(1, m_pool.size());
+   m_pool.release(atom);
+   EXPECT_EQ(0, m_pool.size());
+}
+
+TEST_F(StringPoolTest, dedup)
+{
+   Atom* one = m_pool.intern("key");
+   Atom* two = m_pool.intern(std::string("key"));
+   Atom* other = m_pool.intern("other key");
+
+   EXPECT_TRUE(one == two);
+   EXPECT_TRUE(one != other);
+   EXPECT_EQ(2, one->refCount());
+   EXPECT_EQ(2, m_pool.size());
+
+   m_pool.release(one);
+   EXPECT_EQ(2, m_pool.size());
+   m_pool.release(two);
+   EXPECT_EQ(1, m_pool.size());
+   m_pool.release(other);
+   EXPECT_EQ(0, m_pool.size());
+}
+
+TEST_F(StringPoolTest, threads)
+{
+   const int count = 10000;
+   auto check = [&](){
+      for(int i = 0; i < count; ++i) {
+         Atom* atom = m_pool.intern(std::to_string(i % 100));
+         Atom* again = m_pool.intern(std::to_string(i % 100));
+         m_pool.release(atom);
+         m_pool.release(again);
+      }
+   };
+
+   std::vector<std::thread> threads;
+   for (int i = 0; i < 8; ++i) {
+      threads.emplace_back(check);
+   }
+   for (auto& thread: threads) {
+      thread.join();
+   }
+
+   EXPECT_EQ(0, m_pool.size());
+}
+
+TEST_F(StringPoolTest, item)
+{
+   size_t base = StringPool::global().size();
+   {
+      Item item(StringPool::global().intern("interned symbol"));
+      EXPECT_STREQ("interned symbol", item.toString());
+      EXPECT_STREQ("interned symbol", item.get<String>());
+      EXPECT_TRUE(item.toBool());
+      EXPECT_EQ(base + 1, StringPool::global().size());
+   }
+   EXPECT_EQ(base, StringPool::global().size());
+}
+
+FALCON_TEST_MAIN
+
+/* end of stringpool.fut.cpp */
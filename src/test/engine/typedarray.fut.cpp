@@ -0,0 +1,145 @@
+/*****************************************************************************
+  FALCON2 - The Falcon Programming Language
+  FILE: typedarray.fut.cpp
+
+  Test for the homogeneous typed arrays
+  -------------------------------------------------------------------
+  Author: Giancarlo Niccolai
+  Begin :
+  Touch :
+
+  -------------------------------------------------------------------
+  (C) Copyright 2019 The Falcon Programming Language
+  Released under Apache 2.0 License.
+******************************************************************************/
+
+#include <falcon/fut/fut.h>
+#include <falcon/engine/typedarray.h>
+#include <falcon/engine/item.h>
+#include <vector>
+
+using namespace falcon;
+
+class TypedArrayTest: public falcon::testing::TestCase
+{
+public:
+   enum {
+      PERF_SIZE = 10 * 1024 * 1024
+   };
+
+   void SetUp() {}
+   void TearDown() {}
+};
+
+TEST_F(TypedArrayTest, smoke)
+{
+   TypedArray<int64> array = TypedArray<int64>::buffer(10, 0);
+   EXPECT_EQ(10, array.size());
+   EXPECT_EQ(0, reinterpret_cast<uintptr_t>(array.data()) % TypedArray<int64>::ALIGNMENT);
+   EXPECT_EQ(0, array.sum());
+
+   array.push_back(5);
+   EXPECT_EQ(11, array.size());
+   EXPECT_EQ(5, array[10]);
+   EXPECT_EQ(0, reinterpret_cast<uintptr_t>(array.data()) % TypedArray<int64>::ALIGNMENT);
+
+   TypedArray<byte> bytes{1, 2, 3};
+   String out;
+   bytes.toString(out);
+   EXPECT_STREQ("[1, 2, 3]", out);
+}
+
+TEST_F(TypedArrayTest, kernels)
+{
+   TypedArray<numeric> array(100);
+   array.fill(1.5);
+   EXPECT_EQ(150.0, array.sum());
+
+   array.map([](numeric value) {return value * 2;});
+   EXPECT_EQ(3.0, array[99]);
+   EXPECT_EQ(3.0, array.reduce(0.0, [](numeric a, numeric b) {return std::max(a, b);}));
+
+   TypedArray<int64> ints(37);
+   for (size_t i = 0; i < ints.size(); ++i) {
+      ints[i] = static_cast<int64>(i);
+   }
+   EXPECT_EQ(36 * 37 / 2, ints.sum());
+
+   TypedArray<int64> other(20, 10);
+   TypedArray<byte> less = ints.compare(other, [](int64 a, int64 b) {return a < b;});
+   EXPECT_EQ(20, less.size());
+   EXPECT_EQ(10, less.sum());
+   EXPECT_EQ(1, less[9]);
+   EXPECT_EQ(0, less[10]);
+
+   // more matches than a byte can count.
+   TypedArray<int64> many(1000, 1);
+   TypedArray<int64> limit(1000, 2);
+   TypedArray<byte> matches = many.compare(limit, [](int64 a, int64 b) {return a < b;});
+   EXPECT_EQ(1000, matches.sum());
+   EXPECT_EQ(1000 * 255, TypedArray<byte>(1000, 255).sum());
+}
+
+TEST_F(TypedArrayTest, slice)
+{
+   TypedArray<int64> array{1, 2, 3, 4, 5};
+   EXPECT_TRUE(array.slice(1, 3) == TypedArray<int64>({2, 3}));
+   EXPECT_TRUE(array.slice(3, 100) == TypedArray<int64>({4, 5}));
+   EXPECT_TRUE(array.slice(4, 2).empty());
+}
+
+TEST_F(TypedArrayTest, item)
+{
+   Item item(TypedArray<numeric>{0.5, 1.5});
+   EXPECT_STREQ("[0.5, 1.5]", item.toString());
+   EXPECT_EQ(2, item.toInt());
+   EXPECT_TRUE(item.toBool());
+   EXPECT_FALSE(Item(TypedArray<byte>()).toBool());
+
+   // Arrays are shared by reference.
+   Item copy(item);
+   copy.modify<TypedArray<numeric>>().push_back(2.5);
+   EXPECT_STREQ("[0.5, 1.5, 2.5]", item.toString());
+
+   TypedArray<numeric> values = item.get<TypedArray<numeric>>();
+   Item element = values.itemAt<Item>(2);
+   EXPECT_STREQ("2.5", element.toString());
+}
+
+TEST_F(TypedArrayTest, handler)
+{
+   PairItem pair(TypedArray<int64>{1});
+   EXPECT_TRUE(pair.handler == &HandlerFactory::intArrayHandler);
+   EXPECT_STREQ("IntArray", pair.handler->typeName());
+
+   BoxedItem boxed(TypedArray<byte>{1});
+   EXPECT_TRUE(boxed.handler() == &HandlerFactory::byteArrayHandler);
+   EXPECT_STREQ("ByteArray", boxed.handler()->typeName());
+}
+
+TEST_F(TypedArrayTest, perf_test_item_sum)
+{
+   std::vector<Item> items;
+   items.reserve(PERF_SIZE);
+   for (int i = 0; i < PERF_SIZE; ++i) {
+      items.emplace_back(static_cast<int64>(i & 0xFF));
+   }
+   int64 total = 0;
+   for (const Item& item: items) {
+      total += item.toInt();
+   }
+   EXPECT_EQ(static_cast<int64>(PERF_SIZE / 256) * 255 * 128, total);
+}
+
+TEST_F(TypedArrayTest, perf_test_typed_sum)
+{
+   TypedArray<int64> array(PERF_SIZE);
+   for (int i = 0; i < PERF_SIZE; ++i) {
+      array[i] = i & 0xFF;
+   }
+   EXPECT_EQ(static_cast<int64>(PERF_SIZE / 256) * 255 * 128, array.sum());
+}
+
+FALCON_TEST_MAIN
+
+/* end of typedarray.fut.cpp */